@@ -11,4 +11,23 @@ WINBOOL SetOLFilePath(LPCTSTR path);
 DWORD GetCheckInterval();
 WINBOOL SetCheckInterval(DWORD dwValueMs);
 
+DWORD GetFullCheckInterval();
+WINBOOL SetFullCheckInterval(DWORD dwValueMs);
+
+DWORD GetSnapshotThreads();
+WINBOOL SetSnapshotThreads(DWORD dwThreads);
+
+DWORD GetVerifyThreads();
+WINBOOL SetVerifyThreads(DWORD dwThreads);
+
+DWORD GetCheckSlice();
+WINBOOL SetCheckSlice(DWORD dwValueMs);
+
+void GetCheckThrottle(DWORD* pcbPerSec, DWORD* pnFilesPerSec, WINBOOL* pIsAdaptive);
+WINBOOL SetCheckThrottle(DWORD cbPerSec, DWORD nFilesPerSec, WINBOOL isAdaptive);
+
+LPTSTR GetCheckCursor();
+WINBOOL SetCheckCursor(LPCTSTR mszCursor);
+WINBOOL ClearCheckCursor();
+
 #endif //INTEGRA_CFG_H
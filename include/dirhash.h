@@ -0,0 +1,84 @@
+#ifndef INTEGRA_DIRHASH_H
+#define INTEGRA_DIRHASH_H
+
+/**
+ * Directory digests (Merkle): directory HashNode is summed up by one digest over its children,
+ * in name order, so a single comparison tells whether a whole subtree is unchanged.
+ *
+ *      hash   =  H( name1 | 0 | type1 | hash1 | ... | nameN | 0 | typeN | hashN )
+ *      meta   =  H( name1 | 0 | type1 | meta1 | ... )
+ *
+ *  where  H       -  object's hash algorithm,
+ *         type    -  'f' for file, 'd' for folder,
+ *         hash    -  HashNode's hash: file digest, or directory hash (recursively),
+ *         meta    -  file size, modification and change times, volume and file index
+ *                    (8, 8, 8, 4, 8 bytes, little-endian), or directory meta (recursively)
+ *
+ * hash and meta of snapshot are kept in directory HashNode. Actual meta is read
+ * from directory listings only (Hash_DirRead, no file is opened), so actual state of a subtree is cheap to sum
+ * up and compare. Listings of a whole subtree are read in one walk and cached by path.
+ */
+
+#include <windows.h>
+#include "cjson.h"
+#include "hash.h"
+#include "utils.h"
+
+typedef struct {
+    LPTSTR szPath;
+    HASH_DIGEST meta;
+} DIR_META;
+
+typedef BOOL (*DIR_WALK_STOP_FN)(LPVOID pArg);
+
+/*
+ *  Actual meta of directories, by full path (see GetDirMeta)
+ */
+typedef struct {
+    HASH_ALG alg;
+    DIR_META* pDirs;            // sorted by path
+    size_t nDirs, nAlloc;
+    DIR_WALK_STOP_FN pfnStop;   // walk gives up once it returns TRUE (see WalkDirMeta). NULL: never
+    LPVOID pStopArg;
+} DIR_META_CACHE;
+
+/*
+ *  Difference of two snapshots of one object (see CountTreeChanges)
+ */
+typedef struct {
+    DWORD nModified;
+    DWORD nAdded;
+    DWORD nRemoved;
+} TREE_CHANGES;
+
+/*
+ *  Entry of directory diff: actual listing against HashNode (see DiffDirectory)
+ */
+typedef enum {
+    DIR_DIFF_ADDED,             // in listing only
+    DIR_DIFF_REMOVED,           // in HashNode only
+    DIR_DIFF_TYPE_CHANGED,      // file in one, folder in the other
+    DIR_DIFF_MODIFIED,          // file of other size
+    DIR_DIFF_SAME_META,         // file of same size, times and id as recorded
+    DIR_DIFF_MATCHED            // anything else found in both: contents are to be checked
+} DIR_DIFF_KIND;
+
+typedef struct {
+    DIR_DIFF_KIND kind;
+    LPCTSTR szName;
+    BOOL isDirectory;           // actual type, or recorded one if removed
+    cJSON* jsonNode;            // slave of HashNode, NULL if added
+    const HASH_NODE_INFO* pInfo;    // actual, from listing. NULL if removed
+} DIR_DIFF;
+
+typedef void (*DIR_DIFF_FN)(const DIR_DIFF* pDiff, LPVOID pArg);
+
+void InitDirMetaCache(DIR_META_CACHE* pCache, HASH_ALG alg);
+void FreeDirMetaCache(DIR_META_CACHE* pCache);
+const DIR_META* GetDirMeta(DIR_META_CACHE* pCache, HANDLE hDir, LPCTSTR szPath);
+WINBOOL GetSlavesDigest(cJSON* jsonSlaves, HASH_ALG alg, HASH_DIGEST* pDigest);
+WINBOOL GetSlavesMeta(cJSON* jsonSlaves, HASH_ALG alg, HASH_DIGEST* pDigest);
+void CountTreeChanges(cJSON* jsonOld, cJSON* jsonNew, TREE_CHANGES* pChanges);
+WINBOOL DiffDirectory(HANDLE hDir, cJSON* jsonSlaves, DIR_DIFF_FN pfnDiff, LPVOID pArg);
+
+#endif //INTEGRA_DIRHASH_H
@@ -3,6 +3,19 @@
 
 #include <windows.h>
 
+/*
+ *  Reports kept in order, written to Event Log at once (see ReportLogFlush).
+ *  Items are messages or nested logs: a nested log takes its place when it is made
+ *  and is filled by whoever verifies that part (any thread), so written order of reports
+ *  does not depend on which part finished first. Each log is written by one thread only
+ */
+typedef struct REPORT_LOG REPORT_LOG;
+
 void SvcReportEvent(WORD wType, LPCTSTR szEventMsg);
 
+REPORT_LOG* ReportLogCreate();
+void ReportLogAdd(REPORT_LOG* pLog, WORD wType, LPCTSTR szEventMsg);
+REPORT_LOG* ReportLogNest(REPORT_LOG* pLog);
+void ReportLogFlush(REPORT_LOG* pLog);
+
 #endif //INTEGRA_EVENT_H
@@ -3,16 +3,67 @@
 
 #include <windows.h>
 #include "cjson.h"
+#include "hash.h"
+#include "filehash.h"
+#include "utils.h"
+#include "dirhash.h"
+#include "event.h"
+#include "taskpool.h"
 
 // Default: 30 minutes
 #ifndef DEFAULT_CHECK_INTERVAL_MS
 #define DEFAULT_CHECK_INTERVAL_MS (30 * 60 * 1000)
 #endif
 
-void ServiceLoop(HANDLE stopEvent);
+// Objects checked by metadata are still hashed whole this often. Default: 24 hours
+#ifndef DEFAULT_FULL_CHECK_INTERVAL_MS
+#define DEFAULT_FULL_CHECK_INTERVAL_MS (24 * 60 * 60 * 1000)
+#endif
+
+/*
+ *  Object under verification: its options and state shared by all its nodes,
+ *  on every thread that verifies some of them
+ */
+typedef struct {
+    OBJECT_OPTIONS options;     // check is full on full checks
+    DIR_META_CACHE dirMeta;     // actual meta of folders, read on demand
+    CRITICAL_SECTION csDirMeta;
+    REPORT_LOG* pLog;           // reports of object, in list order (see VerifyObjectList)
+    struct VERIFY_RUN* pRun;
+    int iObject;
+    volatile LONG nRefs;        // object itself and its sub-folders not verified yet
+    size_t cchRoot;             // length of path of object's root in reports. 0 until tree is reached
+    cJSON* jsonActual;          // actual state of mismatched items, for accept (see NoteActualState)
+    CRITICAL_SECTION csActual;
+    LPCTSTR szName;             // name of object, once it is walked: closing report waits for all its folders
+} VERIFY_CONTEXT;
+
+/*
+ *  Position of one object of list in a check in progress, known by its name, type and path
+ */
+typedef struct {
+    LPTSTR szName;
+    DWORD dwType;
+    LPTSTR szPath;
+    WINBOOL isDone;
+    LPTSTR szEntry;             // first item not verified yet, path relative to object. NULL: from its start
+} VERIFY_POSITION;
+
+/*
+ *  Position of a check in progress, kept in Parameters across slices and restarts (see VerifyObjectListSlice)
+ */
+typedef struct {
+    WINBOOL isFullCheck;
+    DWORD nObjects;             // in list order once matched with list (see VerifyObjectListSlice)
+    VERIFY_POSITION* rgPositions;
+} VERIFY_CURSOR;
+
+void ServiceLoop(HANDLE stopEvent, BOOL isFullCheck);
 
-void VerifyObject(cJSON* jsonObject);
-void VerifyNodeFile(cJSON* jsonNode, HANDLE hBase);
-void VerifyNodeReg(cJSON* jsonNode, HKEY hBase);
+void VerifyObjectList(cJSON* jsonObjectList, BOOL isFullCheck);
+void VerifyObject(cJSON* jsonObject, BOOL isFullCheck);
+WINBOOL VerifyObjectListSlice(cJSON* jsonObjectList, VERIFY_CURSOR* pCursor, HANDLE hStop, ULONGLONG ullDeadline);
+void VerifyNodeFile(cJSON* jsonNode, HANDLE hBase, VERIFY_CONTEXT* pCtx, REPORT_LOG* pLog, HASH_WORKER* pWorker);
+void VerifyNodeReg(cJSON* jsonNode, HKEY hBase, HASH_ALG alg, REPORT_LOG* pLog);
 
 #endif //INTEGRA_INTEGRA_H
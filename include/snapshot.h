@@ -3,9 +3,13 @@
 
 #include <windows.h>
 #include "cjson.h"
+#include "hash.h"
+#include "filehash.h"
+#include "utils.h"
 
-cJSON* SnapshotObject(DWORD dwType, LPCTSTR szObjectName, LPCTSTR szPath);
-cJSON* SnapshotNodeReg(HKEY hBase, LPCTSTR szName, BOOL isKey);
-cJSON* SnapshotNodeFile(HANDLE hBase, LPCTSTR szName);
+cJSON* SnapshotObject(DWORD dwType, LPCTSTR szObjectName, LPCTSTR szPath, const OBJECT_OPTIONS* pOptions, cJSON* jsonPrevRoot);
+cJSON* SnapshotNodeReg(HKEY hBase, LPCTSTR szName, BOOL isKey, const OBJECT_OPTIONS* pOptions);
+cJSON* SnapshotNodeFile(HANDLE hBase, LPCTSTR szName, int nDepth, const OBJECT_OPTIONS* pOptions, cJSON* jsonPrev);
+WINBOOL SnapshotSubPath(cJSON* jsonObject, LPCTSTR szSubPath, const OBJECT_OPTIONS* pOptions, cJSON* jsonPrev);
 
 #endif //INTEGRA_SNAPSHOT_H
@@ -3,18 +3,104 @@
 
 #include <windows.h>
 #include "cjson.h"
+#include "hash.h"
+#include "filehash.h"
+#include "fswalk.h"
+#include "cdc.h"
 
 #define OBJECT_FILE 0
 #define OBJECT_REGISTRY 1
 
 #define INTEGRA_CHECK_ONCE INVALID_HANDLE_VALUE
 
+// Actual state found by verification is kept next to Object List, in file of its path and this suffix
+#ifndef ACTUAL_STATE_SUFFIX
+#define ACTUAL_STATE_SUFFIX ".actual"
+#endif
+
+// How files of object are checked ("check" in HashTree)
+typedef enum {
+    CHECK_FULL = 0,         // hash every file, every time
+    CHECK_METADATA,         // hash only files whose metadata changed (and on full checks)
+    CHECK_SAMPLED,          // huge files: compare sample digest, hash whole only on full checks
+    CHECK_MODE_COUNT
+} CHECK_MODE;
+
+#define DEFAULT_CHECK_MODE CHECK_FULL
+
+// How large files of object are split for hashing ("chunking" in HashTree)
+typedef enum {
+    CHUNKING_FIXED = 0,     // tree digest over fixed-size chunks (see treehash.h)
+    CHUNKING_CDC,           // content-defined chunks, digest of each kept in node (see cdc.h)
+    CHUNKING_MODE_COUNT
+} CHUNKING_MODE;
+
+#define DEFAULT_CHUNKING CHUNKING_FIXED
+
+// What folder entries verification accepts ("entries" in HashTree)
+typedef enum {
+    ENTRIES_ALLOW_NEW = 0,  // only entries of snapshot are checked, new ones are ignored
+    ENTRIES_EXACT,          // entries of each folder must be the same as in snapshot
+    ENTRIES_MODE_COUNT
+} ENTRIES_MODE;
+
+#define DEFAULT_ENTRIES_MODE ENTRIES_ALLOW_NEW
+
+/*
+ *  Options HashTree of object is made with
+ */
+typedef struct {
+    HASH_ALG alg;
+    HASH_SCAN scan;             // files only
+    HASH_ENCODING enc;
+    CHECK_MODE check;           // files only
+    CHUNKING_MODE chunking;     // files only
+    ENTRIES_MODE entries;       // files only
+} OBJECT_OPTIONS;
+
+/*
+ *  File metadata recorded in file HashNodes
+ */
+typedef struct {
+    ULONGLONG cbSize;
+    ULONGLONG ftWrite;      // modification time
+    ULONGLONG ftChange;     // change time: also moves on attribute, ACL and rename changes
+    DWORD dwVolume;         // file identity: volume serial and file index
+    ULONGLONG qwIndex;
+} FILE_META;
+
 cJSON* ReadJSON(LPCTSTR path);
 HKEY ParseRootHKEY(LPCTSTR szPath);
+WINBOOL GetObjectHashAlg(cJSON* jsonObject, HASH_ALG* pAlg);
+WINBOOL GetObjectScanMode(cJSON* jsonObject, HASH_SCAN* pScan);
+WINBOOL GetObjectEncoding(cJSON* jsonObject, HASH_ENCODING* pEnc);
+WINBOOL GetObjectCheckMode(cJSON* jsonObject, CHECK_MODE* pCheck);
+LPCTSTR CheckModeName(CHECK_MODE check);
+WINBOOL FindCheckMode(LPCTSTR szName, CHECK_MODE* pCheck);
+WINBOOL GetObjectChunking(cJSON* jsonObject, CHUNKING_MODE* pChunking);
+LPCTSTR ChunkingName(CHUNKING_MODE chunking);
+WINBOOL FindChunking(LPCTSTR szName, CHUNKING_MODE* pChunking);
+WINBOOL GetObjectEntriesMode(cJSON* jsonObject, ENTRIES_MODE* pEntries);
+LPCTSTR EntriesModeName(ENTRIES_MODE entries);
+WINBOOL FindEntriesMode(LPCTSTR szName, ENTRIES_MODE* pEntries);
+void SetDefaultOptions(OBJECT_OPTIONS* pOptions);
+
+WINBOOL GetFileMeta(HANDLE hFile, FILE_META* pMeta);
+void CopyFileMeta(const HASH_NODE_INFO* pInfo, FILE_META* pMeta);
+WINBOOL InitHandlePath(HASH_PATH_BUF* pPath, HANDLE hFile);
+void AddFileMetaToNode(cJSON* jsonNode, const FILE_META* pMeta);
+WINBOOL GetNodeFileMeta(cJSON* jsonNode, FILE_META* pMeta);
+WINBOOL IsSameFileMeta(const FILE_META* a, const FILE_META* b);
+void AddChunksToNode(cJSON* jsonNode, const HASH_CDC_CHUNK* pChunks, size_t nChunks, HASH_ALG alg, HASH_ENCODING enc);
+WINBOOL GetNodeChunks(cJSON* jsonNode, HASH_ALG alg, HASH_CDC_CHUNK** ppChunks, size_t* pnChunks);
 
-int AddObjectToOL(LPCTSTR szName, DWORD dwType, LPCTSTR szPath);
+int AddObjectToOL(LPCTSTR szName, DWORD dwType, LPCTSTR szPath, const OBJECT_OPTIONS* pOptions);
 int RemoveObjectFromOL(LPCTSTR szName);
-int UpdateObjectInOL(LPCTSTR szName);
+int UpdateObjectInOL(LPCTSTR szName, LPCTSTR szSubPath);
+int AcceptObjectInOL(LPCTSTR szName, LPCTSTR szSubPath);
+int CompareSubPaths(LPCTSTR szPathA, LPCTSTR szPathB);
+WINBOOL IsAtOrUnder(LPCTSTR szEntryPath, LPCTSTR szSub);
+void StoreActualState(cJSON** rgjsonObjects, cJSON** rgjsonEntries, int nObjects, const LPCTSTR* rgszFrom, const LPCTSTR* rgszTo);
 int PrintObjectsInOL();
 int FindIndexByNameInOL(cJSON* jsonObjectList, LPCTSTR szName);
 
@@ -0,0 +1,195 @@
+#include <string.h>
+#include "blake3.h"
+
+
+#define CHUNK_START     (1 << 0)
+#define CHUNK_END       (1 << 1)
+#define PARENT          (1 << 2)
+#define ROOT            (1 << 3)
+
+static const uint32_t IV[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+static const uint8_t MSG_SCHEDULE[7][16] = {
+    { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15},
+    { 2,  6,  3, 10,  7,  0,  4, 13,  1, 11, 12,  5,  9, 14, 15,  8},
+    { 3,  4, 10, 12, 13,  2,  7, 14,  6,  5,  9,  0, 11, 15,  8,  1},
+    {10,  7, 12,  9, 14,  3, 13, 15,  4,  0, 11,  2,  5,  8,  1,  6},
+    {12, 13,  9, 11, 15, 10, 14,  8,  7,  2,  5,  3,  0,  1,  6,  4},
+    { 9, 14, 11,  5,  8, 12, 15,  1, 13,  3,  0, 10,  2,  6,  4,  7},
+    {11, 15,  5,  0,  1,  9,  8,  6, 14, 10,  2, 12,  3,  4,  7, 13},
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define G(a, b, c, d, mx, my) \
+    v[a] = v[a] + v[b] + (mx); v[d] = ROTR(v[d] ^ v[a], 16); \
+    v[c] = v[c] + v[d];        v[b] = ROTR(v[b] ^ v[c], 12); \
+    v[a] = v[a] + v[b] + (my); v[d] = ROTR(v[d] ^ v[a], 8);  \
+    v[c] = v[c] + v[d];        v[b] = ROTR(v[b] ^ v[c], 7)
+
+
+static uint32_t LoadLE32(const uint8_t* p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+static void Compress(const uint32_t cv[8], const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t cbBlock,
+                     uint64_t counter, uint8_t flags, uint32_t out[16]) {
+    /**
+     * @brief BLAKE3 compression function. Writes full 16-word state; first 8 words are the new CV
+     */
+    uint32_t m[16], v[16];
+
+    for (int i = 0; i < 16; i++)
+        m[i] = LoadLE32(block + 4*i);
+
+    memcpy(v, cv, 8 * sizeof(uint32_t));
+    memcpy(v + 8, IV, 4 * sizeof(uint32_t));
+    v[12] = (uint32_t) counter;
+    v[13] = (uint32_t) (counter >> 32);
+    v[14] = cbBlock;
+    v[15] = flags;
+
+    for (int r = 0; r < 7; r++) {
+        const uint8_t* s = MSG_SCHEDULE[r];
+        G(0, 4,  8, 12, m[s[ 0]], m[s[ 1]]);
+        G(1, 5,  9, 13, m[s[ 2]], m[s[ 3]]);
+        G(2, 6, 10, 14, m[s[ 4]], m[s[ 5]]);
+        G(3, 7, 11, 15, m[s[ 6]], m[s[ 7]]);
+        G(0, 5, 10, 15, m[s[ 8]], m[s[ 9]]);
+        G(1, 6, 11, 12, m[s[10]], m[s[11]]);
+        G(2, 7,  8, 13, m[s[12]], m[s[13]]);
+        G(3, 4,  9, 14, m[s[14]], m[s[15]]);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        out[i] = v[i] ^ v[i + 8];
+        out[i + 8] = v[i + 8] ^ cv[i];
+    }
+}
+
+
+static void ParentCV(const uint32_t left[8], const uint32_t right[8], uint8_t flags, uint32_t out[8]) {
+    uint8_t block[BLAKE3_BLOCK_LEN];
+    uint32_t full[16];
+
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 4; j++) {
+            block[4*i + j] = (uint8_t) (left[i] >> (8*j));
+            block[32 + 4*i + j] = (uint8_t) (right[i] >> (8*j));
+        }
+    }
+    Compress(IV, block, BLAKE3_BLOCK_LEN, 0, PARENT | flags, full);
+    memcpy(out, full, 8 * sizeof(uint32_t));
+}
+
+
+static uint8_t ChunkFlags(const BLAKE3_CTX* ctx) {
+    return ctx->nBlocksCompressed ? 0 : CHUNK_START;
+}
+
+
+static void PushChunkCV(BLAKE3_CTX* ctx, uint32_t cv[8]) {
+    /**
+     * @brief Merge completed chunk into CV stack: one merge per trailing zero bit of chunk count
+     */
+    uint64_t nChunks = ctx->iChunk + 1;
+
+    while (!(nChunks & 1)) {
+        ParentCV(ctx->cvStack[--ctx->cvStackLen], cv, 0, cv);
+        nChunks >>= 1;
+    }
+    memcpy(ctx->cvStack[ctx->cvStackLen++], cv, 8 * sizeof(uint32_t));
+}
+
+
+void BLAKE3_Init(BLAKE3_CTX* ctx) {
+    memcpy(ctx->cv, IV, sizeof(IV));
+    ctx->iChunk = 0;
+    ctx->cbBuffered = 0;
+    ctx->nBlocksCompressed = 0;
+    ctx->cvStackLen = 0;
+}
+
+
+void BLAKE3_Update(BLAKE3_CTX* ctx, const void* pData, size_t cbData) {
+    /**
+     * @brief Feed bytes to context
+     *
+     * @details Last block of a chunk stays buffered until more input arrives,
+     *  since it must be compressed with CHUNK_END (and maybe ROOT) flag.
+     */
+    const uint8_t* p = pData;
+    uint32_t out[16];
+
+    while (cbData) {
+        // Buffered block is full and more data follows: compress it
+        if (ctx->cbBuffered == BLAKE3_BLOCK_LEN) {
+            uint8_t flags = ChunkFlags(ctx);
+
+            if (ctx->nBlocksCompressed == BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN - 1) {
+                // Last block of chunk: finish chunk and start next one
+                Compress(ctx->cv, ctx->buffer, BLAKE3_BLOCK_LEN, ctx->iChunk, flags | CHUNK_END, out);
+                PushChunkCV(ctx, out);
+                ctx->iChunk++;
+                memcpy(ctx->cv, IV, sizeof(IV));
+                ctx->nBlocksCompressed = 0;
+            }
+            else {
+                Compress(ctx->cv, ctx->buffer, BLAKE3_BLOCK_LEN, ctx->iChunk, flags, out);
+                memcpy(ctx->cv, out, 8 * sizeof(uint32_t));
+                ctx->nBlocksCompressed++;
+            }
+            ctx->cbBuffered = 0;
+        }
+
+        size_t cbTake = BLAKE3_BLOCK_LEN - ctx->cbBuffered;
+        if (cbTake > cbData) cbTake = cbData;
+        memcpy(ctx->buffer + ctx->cbBuffered, p, cbTake);
+        ctx->cbBuffered += (uint8_t) cbTake;
+        p += cbTake;
+        cbData -= cbTake;
+    }
+}
+
+
+void BLAKE3_Final(BLAKE3_CTX* ctx, uint8_t digest[BLAKE3_DIGEST_LEN]) {
+    /**
+     * @brief Finish last chunk and fold CV stack down to root
+     */
+    uint8_t block[BLAKE3_BLOCK_LEN];
+    uint32_t cv[8], out[16];
+    uint8_t flags = ChunkFlags(ctx) | CHUNK_END;
+    int i = ctx->cvStackLen;
+
+    memcpy(block, ctx->buffer, ctx->cbBuffered);
+    memset(block + ctx->cbBuffered, 0, BLAKE3_BLOCK_LEN - ctx->cbBuffered);
+
+    if (!i)
+        // Single chunk: its last block is the root
+        Compress(ctx->cv, block, ctx->cbBuffered, ctx->iChunk, flags | ROOT, out);
+    else {
+        Compress(ctx->cv, block, ctx->cbBuffered, ctx->iChunk, flags, out);
+        memcpy(cv, out, sizeof(cv));
+        while (--i > 0)
+            ParentCV(ctx->cvStack[i], cv, 0, cv);
+        ParentCV(ctx->cvStack[0], cv, ROOT, out);
+    }
+
+    for (i = 0; i < 8; i++) {
+        digest[4*i + 0] = (uint8_t) out[i];
+        digest[4*i + 1] = (uint8_t) (out[i] >> 8);
+        digest[4*i + 2] = (uint8_t) (out[i] >> 16);
+        digest[4*i + 3] = (uint8_t) (out[i] >> 24);
+    }
+}
+
+
+void BLAKE3_Digest(const void* pData, size_t cbData, uint8_t digest[BLAKE3_DIGEST_LEN]) {
+    BLAKE3_CTX ctx;
+    BLAKE3_Init(&ctx);
+    BLAKE3_Update(&ctx, pData, cbData);
+    BLAKE3_Final(&ctx, digest);
+}
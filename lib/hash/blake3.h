@@ -0,0 +1,33 @@
+#ifndef INTEGRA_BLAKE3_H
+#define INTEGRA_BLAKE3_H
+
+/**
+ * BLAKE3 (hash mode, 256-bit output). Portable reference-style implementation:
+ * 1 KiB chunks, chaining values merged on a stack as chunks complete.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLAKE3_DIGEST_LEN   32
+#define BLAKE3_BLOCK_LEN    64
+#define BLAKE3_CHUNK_LEN    1024
+#define BLAKE3_MAX_DEPTH    54      // 2^64 bytes / 1 KiB chunks
+
+typedef struct {
+    uint32_t cv[8];                 // chaining value of current chunk
+    uint64_t iChunk;                // index of current chunk
+    uint8_t buffer[BLAKE3_BLOCK_LEN];
+    uint8_t cbBuffered;
+    uint8_t nBlocksCompressed;      // within current chunk
+    uint8_t cvStackLen;
+    uint32_t cvStack[BLAKE3_MAX_DEPTH + 1][8];
+} BLAKE3_CTX;
+
+void BLAKE3_Init(BLAKE3_CTX* ctx);
+void BLAKE3_Update(BLAKE3_CTX* ctx, const void* pData, size_t cbData);
+void BLAKE3_Final(BLAKE3_CTX* ctx, uint8_t digest[BLAKE3_DIGEST_LEN]);
+
+void BLAKE3_Digest(const void* pData, size_t cbData, uint8_t digest[BLAKE3_DIGEST_LEN]);
+
+#endif //INTEGRA_BLAKE3_H
@@ -0,0 +1,347 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cdc.h"
+#include "xxh3.h"
+#ifndef _WIN32
+#include <errno.h>
+#endif
+
+// Cut when masked bits of rolling hash are all zero. Top bits: they depend on all of last 64 bytes
+#define CDC_MASK_STRICT     (~0ULL << (64 - 23))
+#define CDC_MASK_LOOSE      (~0ULL << (64 - 19))
+
+
+// Gear table: fixed forever, as boundaries depend on it (splitmix64, seed "integra")
+static const uint64_t rgGear[256] = {
+    0xc7ab18c98c602d29ULL, 0x8ed6d3dc7812661eULL, 0xc0f1ba32dc4fa9caULL, 0xccc8be4bd931954aULL,
+    0x539ab5a7529dcd77ULL, 0x15172dcfe6c8697aULL, 0xae3984e586e01849ULL, 0x22a1ee8b07521035ULL,
+    0x61ff991e5421c4b6ULL, 0x6207970418f7b442ULL, 0x76cd982bc4ef2912ULL, 0xdc8b90047e20d25aULL,
+    0xeab36d884aadf619ULL, 0x38bf9d7baf7b3a06ULL, 0x8d90bc6394a9cbcaULL, 0x848017a9c6e9e99cULL,
+    0x06232b67ddd078f0ULL, 0xc4eeaca038fea563ULL, 0x57d9d59cb4a6bb77ULL, 0x1d007523f6017027ULL,
+    0x444a33305d42d4b8ULL, 0x2f3fbaedcd968e02ULL, 0x61ffd0c5fbfdd591ULL, 0xe7d66eaf17d506a2ULL,
+    0x21e941715ef573bbULL, 0x7e02c1fb568a4fa0ULL, 0xeabbac928cc41588ULL, 0xdf50db34d1b247b1ULL,
+    0x6c8ac2e5463d31a0ULL, 0xa62626469fc3c7beULL, 0xd26e44414aa06e3cULL, 0xb9ab166a3cc6f793ULL,
+    0x2ebabe28680581feULL, 0xe92ab7261dad863aULL, 0x4030f827d1f0d540ULL, 0xf9e394408c597d33ULL,
+    0x6165a3236c6491f9ULL, 0x0fa0b9bdc9d02057ULL, 0xa2292de1fe766888ULL, 0x895f7ef60f869112ULL,
+    0x8247deed6ff0699aULL, 0x295fd785102fe3c7ULL, 0x76e0d7ebd0fe9ef4ULL, 0xf25e367a27345590ULL,
+    0x3eef467490d70c0bULL, 0xff9bf516ef9698e0ULL, 0xedfd4dedaa616db3ULL, 0xfb6b5253b08054f6ULL,
+    0x51fd7facf80269f4ULL, 0xb5174b7345caeddaULL, 0x6be1cedcde9ed2b4ULL, 0xeaa85b6233cedc6bULL,
+    0x90268aff14c7b069ULL, 0x4b4ae581106b5e00ULL, 0xfa4668d48c583f2fULL, 0x7b3fcd3582779a18ULL,
+    0x67d2ea228f4afd71ULL, 0xfb746c557c7b2b3cULL, 0x8ef56ab81f5a131fULL, 0xb2395c9c4ab5eaddULL,
+    0xa156e2a0eed8b03bULL, 0x042be7c745b50860ULL, 0x4000f456538545c4ULL, 0x71fffa4ebc4869c0ULL,
+    0xdf6dbcd7ecfe6e80ULL, 0x76eb2892f4b08aaeULL, 0x1c6064020d4d9becULL, 0xec30147a18130dfcULL,
+    0x893a3acb93c06ba4ULL, 0xf6bb4041293c8f45ULL, 0xed74e703c124f814ULL, 0x3564428ea63f624cULL,
+    0x21b9534764deb0a2ULL, 0x3d8706d63b1bb49eULL, 0x1c2e529af2c0fd2dULL, 0xbf5b8541a82ab76fULL,
+    0xd21d73af093d51ebULL, 0x81980ab95c4f595fULL, 0xd91da80ec21baf10ULL, 0xd551a9d1898c25adULL,
+    0x9460573ac8a1f4a3ULL, 0xb8c8c27584e258a2ULL, 0xdae25ac257e90324ULL, 0x3d9114f1b3d249cdULL,
+    0x65c608c3428e2608ULL, 0x731d936f053fbdb1ULL, 0xc0988035b8921d9aULL, 0x19da1eb4e22b3fc7ULL,
+    0x4154999d976667d6ULL, 0xaed71ce4724e4269ULL, 0x74f0ee8fa2748c39ULL, 0x764e92a60ea6d3f0ULL,
+    0xd0422c48569af7eaULL, 0x380d7704878118a6ULL, 0x4d77f46625cccb00ULL, 0x460ca5501c35e51eULL,
+    0x9faa353dcbb49d9dULL, 0x60aa176e501e1336ULL, 0x69c34505656fbd54ULL, 0x3a7b7383370cea10ULL,
+    0x94f3e58aa8132a00ULL, 0xa855c5fa63a5347fULL, 0x126ada08bbf6ce28ULL, 0x92436847d0791381ULL,
+    0xdba9440a6cb0dd9fULL, 0xd7f19a590e8fa522ULL, 0x27abc074911cce97ULL, 0x2e8326beebaa0e80ULL,
+    0x08aab4d1df8a6764ULL, 0x45ba36c1f525be87ULL, 0xea8a20422cf28aebULL, 0xd9b6eec8ca09405bULL,
+    0xd3713147fe7eec90ULL, 0x60c23b9a9f8e9512ULL, 0xc259762bc8fc8d80ULL, 0x59fe3c3fb103c4c9ULL,
+    0xb04454507012e8c8ULL, 0x4ed715574044a3eaULL, 0x6259134107ee45c8ULL, 0xc7240986b10e1871ULL,
+    0xfcacd72ae5cc7b38ULL, 0xf31dafce9fdd4c75ULL, 0x2382f0ed4bc94d40ULL, 0x2c5cef0afca1655fULL,
+    0x95201555d3a3672dULL, 0x47cd2a47155dfedfULL, 0x1679207b9fdc5220ULL, 0x3475473c9ba90e80ULL,
+    0xb5f14ff90b1ab931ULL, 0x3e0efce13733f194ULL, 0x996f4b3cf1651081ULL, 0xdd4d20d9e7be4de2ULL,
+    0xd2802b69541149f9ULL, 0x71d04071858426e3ULL, 0x391f78cdce1c09a5ULL, 0xf1a6b6e605166093ULL,
+    0x0b7926728dc9bac5ULL, 0xc38c21a90735fcd5ULL, 0x75363803543158dbULL, 0x4d452745edd0a013ULL,
+    0xccb85bef49390001ULL, 0x0b9c320f61683aa5ULL, 0xde8739fcf56391f3ULL, 0x0248fa2eb5a2ef34ULL,
+    0x52ca26c619d45fc4ULL, 0xb6c33772d7e78fecULL, 0x454c8aae01681f26ULL, 0x09ef4669063cda0cULL,
+    0x766460fe71516a26ULL, 0x2f401bb60923efe7ULL, 0xdfcc5af236ee1c62ULL, 0x41219b871c195627ULL,
+    0x9688e87b25d92273ULL, 0xfd97104a0e0ea898ULL, 0x42a63692fa050f65ULL, 0xc05447fe2f8657b1ULL,
+    0xf8873e8b607defc1ULL, 0x0191c637fa996637ULL, 0x92af9ff18d7e1ad4ULL, 0x38706a76c47ba2d4ULL,
+    0xf089c5d23f992880ULL, 0x5fdee70ddded9692ULL, 0x09d377f12e2182c4ULL, 0x3a8231a9e125b045ULL,
+    0x2ca006a164646648ULL, 0xdf91dd98b7cdcb2bULL, 0xa3d61e44e8a54907ULL, 0x247ea4af738f26b5ULL,
+    0x3a09026f7bc9d9f7ULL, 0xbd6f1ddce779334bULL, 0x74b6216962c71813ULL, 0x341bf3344561f2c1ULL,
+    0x080099f1946bdc1bULL, 0x0fe380da20b6980fULL, 0x3879db03944e87a1ULL, 0xfbd7116bf37ae096ULL,
+    0x1e2296cf163b1d70ULL, 0x7857baf76ce95d18ULL, 0x93879be572009ebfULL, 0x00aa3ce0b5464deaULL,
+    0x6b0f8517d64087f0ULL, 0x5e4b52f16fb3a7d1ULL, 0xe72a31021d554bbbULL, 0x8067bd0b29fe4679ULL,
+    0xa905d4154989a29cULL, 0xfb7f5981e823e9adULL, 0xb859c5bc42eb52d8ULL, 0x99586efcb28a38f0ULL,
+    0xb33057d4be0c7135ULL, 0x4b0a086096d32cbeULL, 0x2202ea5eb5e2061aULL, 0x828e06e63c6e6e8bULL,
+    0xdb03c0092548d8d9ULL, 0x737a0b3e995d4157ULL, 0x4fefd14ab3a66d86ULL, 0x703bfa61c86f1348ULL,
+    0x11e5cfdbb61ee249ULL, 0x96439c744919fecbULL, 0x7351bc61e0ad93f5ULL, 0x254411b3394d72bcULL,
+    0x5da7a785272aaff7ULL, 0xf883983e19b0e99fULL, 0xc33b3290aa88488cULL, 0x0ebd3688c2bdf546ULL,
+    0xb24fee3019c0b051ULL, 0xa683ac6652f8ef7bULL, 0xcc1af1e8356701e4ULL, 0xbb8d7d94ae9b0e6aULL,
+    0x9c6330556944e5a5ULL, 0x816dcdf5a97ebdd8ULL, 0x836cb714ebeb84f5ULL, 0x6c2a9cf94cb1e7a4ULL,
+    0x33920130ba00d85cULL, 0xbbef3f20982ef4c9ULL, 0x703c3042bce74cadULL, 0xdbbe851782ca3a10ULL,
+    0x0f858222a080083cULL, 0x1a058e2fbf119e33ULL, 0x2d4304398938ccd9ULL, 0x4099d9ee4d38cf04ULL,
+    0x6dd78fb84ee4ef88ULL, 0x2c8fbb8bad79fadbULL, 0x8bcad9ad5088983bULL, 0xc9003db6e9eb677eULL,
+    0xfad31b09979ba7d4ULL, 0xd63b9c5a177da205ULL, 0xc6f40fd9733bdcdbULL, 0xcaa4b4ca2aaf89a7ULL,
+    0xf99def60eedd568fULL, 0xf1b6accb994e3b7eULL, 0x23f1c8be34fc89a7ULL, 0x144c36a8401da2baULL,
+    0x335f6fbac1ba202cULL, 0xf73dc797c54bacb2ULL, 0x3747d37c31b647c7ULL, 0x1682aa08d646fbf1ULL,
+    0xaf7babce9c4e8892ULL, 0x6d489192514e8609ULL, 0x55064ecd88bea829ULL, 0x39e4644293d015cdULL,
+    0x4543c18d14b5d35cULL, 0x10748f1f80756b68ULL, 0x9bd6017b87b25d85ULL, 0x5d3492d4410b40c5ULL,
+    0x84759f7cb29d9683ULL, 0xd11d717600cb5d3bULL, 0x074431bdd838c53fULL, 0x9db3c17e4c3f8c23ULL,
+    0xef2cf5a5cbbb8246ULL, 0xa7acbe03e06de7d2ULL, 0xc0ebcd3a4d5d855bULL, 0x41156e61cf6480fcULL,
+    0x840a153c5feaf77eULL, 0xf41f42d6a03b7425ULL, 0x157c7749832b3d11ULL, 0x910899bd08f2fa3dULL,
+};
+
+
+void Hash_CdcInit(HASH_CDC* pCdc) {
+    pCdc->h = 0;
+    pCdc->cbChunk = 0;
+}
+
+
+size_t Hash_CdcScan(HASH_CDC* pCdc, const uint8_t* pbData, size_t cbData, int* pIsCut) {
+    /**
+     * @brief Look for next chunk boundary in data. Returns bytes that belong to current chunk:
+     * up to boundary if one was found (*pIsCut set, state reset for next chunk), all of data otherwise
+     */
+    uint64_t h = pCdc->h;
+    size_t cbChunk = pCdc->cbChunk;
+    size_t i = 0;
+
+    *pIsCut = 0;
+
+    // Nothing can cut before minimum; rolling hash only needs last 64 bytes before it
+    if (cbChunk + 64 < HASH_CDC_MIN_LEN) {
+        size_t cbSkip = HASH_CDC_MIN_LEN - 64 - cbChunk;
+        if (cbSkip > cbData) cbSkip = cbData;
+        i = cbSkip;
+        cbChunk += cbSkip;
+    }
+
+    for (; i < cbData; i++) {
+        h = (h << 1) + rgGear[pbData[i]];
+        cbChunk++;
+        if (cbChunk < HASH_CDC_MIN_LEN) continue;
+        if (cbChunk >= HASH_CDC_MAX_LEN ||
+            !(h & (cbChunk < HASH_CDC_AVG_LEN ? CDC_MASK_STRICT : CDC_MASK_LOOSE))) {
+            *pIsCut = 1;
+            Hash_CdcInit(pCdc);
+            return i + 1;
+        }
+    }
+
+    pCdc->h = h;
+    pCdc->cbChunk = cbChunk;
+    return cbData;
+}
+
+
+uint64_t Hash_CdcFingerprint(const void* pData, size_t cbData) {
+    uint8_t rgbDigest[XXH3_DIGEST_LEN];
+    uint64_t qw = 0;
+
+    Hash_Digest(HASH_XXH3_128, pData, cbData, rgbDigest);
+    for (int i = 7; i >= 0; i--)
+        qw = qw << 8 | rgbDigest[i];
+    return qw;
+}
+
+
+/*
+ *  State of one CDC pass over a file (see Hash_FileCdc)
+ */
+typedef struct {
+    HASH_ALG alg;
+    HASH_CDC cdc;
+    uint8_t* pbChunk;                   // current chunk, up to HASH_CDC_MAX_LEN
+    size_t cbChunk;
+    uint64_t cbOffset;                  // of current chunk in file
+    const HASH_CDC_CHUNK** ppKnown;     // known chunks, by fingerprint and size
+    size_t nKnown;
+    HASH_CDC_CHUNK* pChunks;
+    size_t nChunks, nAlloc, nReused;
+    int isOutOfMemory;
+} CDC_PASS;
+
+
+static int CompareKnown(const void* a, const void* b) {
+    const HASH_CDC_CHUNK* x = *(const HASH_CDC_CHUNK* const*) a;
+    const HASH_CDC_CHUNK* y = *(const HASH_CDC_CHUNK* const*) b;
+    if (x->qwFingerprint != y->qwFingerprint) return x->qwFingerprint < y->qwFingerprint ? -1 : 1;
+    if (x->cbSize != y->cbSize) return x->cbSize < y->cbSize ? -1 : 1;
+    return 0;
+}
+
+
+static void FinishChunk(CDC_PASS* pPass) {
+    /**
+     * @brief Append current chunk to list: digest carried forward if known, computed otherwise
+     */
+    HASH_CDC_CHUNK chunk = {0}, *pKey = &chunk;
+    const HASH_CDC_CHUNK** ppFound = NULL;
+
+    if (pPass->nChunks == pPass->nAlloc) {
+        size_t nAlloc = pPass->nAlloc ? pPass->nAlloc * 2 : 64;
+        HASH_CDC_CHUNK* pChunks = realloc(pPass->pChunks, nAlloc * sizeof(HASH_CDC_CHUNK));
+        if (!pChunks) {
+            pPass->isOutOfMemory = 1;
+            return;
+        }
+        pPass->pChunks = pChunks;
+        pPass->nAlloc = nAlloc;
+    }
+
+    chunk.cbOffset = pPass->cbOffset;
+    chunk.cbSize = pPass->cbChunk;
+    chunk.qwFingerprint = Hash_CdcFingerprint(pPass->pbChunk, pPass->cbChunk);
+
+    if (pPass->nKnown)
+        ppFound = bsearch(&pKey, pPass->ppKnown, pPass->nKnown, sizeof(*pPass->ppKnown), CompareKnown);
+    if (ppFound) {
+        chunk.digest = (*ppFound)->digest;
+        pPass->nReused++;
+    }
+    else Hash_Digest(pPass->alg, pPass->pbChunk, pPass->cbChunk, chunk.digest.b);
+
+    pPass->pChunks[pPass->nChunks++] = chunk;
+    pPass->cbOffset += pPass->cbChunk;
+    pPass->cbChunk = 0;
+}
+
+
+static void ChunkPiece(void* pArg, const uint8_t* pbData, size_t cbData) {
+    CDC_PASS* pPass = pArg;
+    int isCut;
+
+    while (cbData && !pPass->isOutOfMemory) {
+        size_t cbTaken = Hash_CdcScan(&pPass->cdc, pbData, cbData, &isCut);
+        memcpy(pPass->pbChunk + pPass->cbChunk, pbData, cbTaken);
+        pPass->cbChunk += cbTaken;
+        if (isCut) FinishChunk(pPass);
+        pbData += cbTaken;
+        cbData -= cbTaken;
+    }
+}
+
+
+HASH_STATUS Hash_FileCdc(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hFile,
+                         const HASH_CDC_CHUNK* pKnown, size_t nKnown,
+                         HASH_CDC_CHUNK** ppChunks, size_t* pnChunks, size_t* pnReused) {
+    /**
+     * @brief Split file (from current position) into content-defined chunks and hash each one
+     *
+     * @details Chunks found in pKnown (same fingerprint and size, e.g. from last snapshot) get
+     *  their known digest instead of being hashed; count is written to pnReused. Pass no known
+     *  chunks to hash every chunk (verification). Chunk list is allocated, caller frees it.
+     *  Empty file gives one empty chunk
+     */
+    CDC_PASS pass = {0};
+    HASH_STATUS status;
+
+    pass.alg = alg;
+    Hash_CdcInit(&pass.cdc);
+    pass.pbChunk = malloc(HASH_CDC_MAX_LEN);
+    if (nKnown) pass.ppKnown = malloc(nKnown * sizeof(*pass.ppKnown));
+
+    if (!pass.pbChunk || (nKnown && !pass.ppKnown) || !Hash_GetProvider(alg)) {
+        free(pass.pbChunk);
+        free(pass.ppKnown);
+#ifdef _WIN32
+        return Hash_GetProvider(alg) ? ERROR_NOT_ENOUGH_MEMORY : ERROR_INVALID_PARAMETER;
+#else
+        return Hash_GetProvider(alg) ? ENOMEM : EINVAL;
+#endif
+    }
+
+    for (size_t i = 0; i < nKnown; i++)
+        pass.ppKnown[i] = &pKnown[i];
+    qsort(pass.ppKnown, nKnown, sizeof(*pass.ppKnown), CompareKnown);
+    pass.nKnown = nKnown;
+
+    status = Hash_FileStream(scan, hFile, ChunkPiece, &pass);
+    if (status == HASH_STATUS_OK && (pass.cbChunk || !pass.nChunks)) FinishChunk(&pass);
+    if (status == HASH_STATUS_OK && pass.isOutOfMemory) {
+#ifdef _WIN32
+        status = ERROR_NOT_ENOUGH_MEMORY;
+#else
+        status = ENOMEM;
+#endif
+    }
+
+    free(pass.pbChunk);
+    free(pass.ppKnown);
+    if (status != HASH_STATUS_OK) {
+        free(pass.pChunks);
+        return status;
+    }
+
+    *ppChunks = pass.pChunks;
+    *pnChunks = pass.nChunks;
+    if (pnReused) *pnReused = pass.nReused;
+    return HASH_STATUS_OK;
+}
+
+
+int Hash_CdcRoot(HASH_ALG alg, const HASH_CDC_CHUNK* pChunks, size_t nChunks, uint8_t* pDigest) {
+    /**
+     * @brief Combine chunk digests into file digest (see cdc.h). Chunks must cover file in order
+     */
+    HASH_CTX ctx;
+    uint8_t rgbSize[8];
+    uint64_t cbTotal = nChunks ? pChunks[nChunks - 1].cbOffset + pChunks[nChunks - 1].cbSize : 0;
+    size_t cbDigest = Hash_DigestLen(alg);
+
+    if (!Hash_Init(&ctx, alg)) return 0;
+    for (size_t i = 0; i < nChunks; i++)
+        Hash_Update(&ctx, pChunks[i].digest.b, cbDigest);
+    for (int i = 0; i < 8; i++)
+        rgbSize[i] = (uint8_t) (cbTotal >> (8 * i));
+    Hash_Update(&ctx, rgbSize, sizeof(rgbSize));
+    Hash_Final(&ctx, pDigest);
+    return 1;
+}
+
+
+static int CompareDigest(const void* a, const void* b) {
+    // Whole HASH_DIGEST: bytes past digest length are zero in both
+    const HASH_CDC_CHUNK* x = *(const HASH_CDC_CHUNK* const*) a;
+    const HASH_CDC_CHUNK* y = *(const HASH_CDC_CHUNK* const*) b;
+    int res = memcmp(x->digest.b, y->digest.b, sizeof(x->digest.b));
+    if (res) return res;
+    return (x->cbSize > y->cbSize) - (x->cbSize < y->cbSize);
+}
+
+
+size_t Hash_CdcDiff(const HASH_CDC_CHUNK* pExpected, size_t nExpected,
+                    const HASH_CDC_CHUNK* pActual, size_t nActual,
+                    HASH_CDC_RANGE* pRanges, size_t nMaxRanges) {
+    /**
+     * @brief Find byte ranges of actual file not present in expected chunks (changed or inserted data)
+     *
+     * @details A chunk counts as unchanged if a chunk of same digest and size was expected anywhere,
+     *  so data moved by an insert is not reported. Adjacent changed chunks make one range.
+     *  Returns count of ranges; first nMaxRanges are written. 0 with differing roots means
+     *  data was only removed or reordered. Digests must be zero-padded (see HASH_DIGEST)
+     */
+    const HASH_CDC_CHUNK** ppSorted = malloc((nExpected ? nExpected : 1) * sizeof(*ppSorted));
+    size_t nRanges = 0;
+    int isInRange = 0;
+
+    if (ppSorted) {
+        for (size_t i = 0; i < nExpected; i++)
+            ppSorted[i] = &pExpected[i];
+        qsort(ppSorted, nExpected, sizeof(*ppSorted), CompareDigest);
+    }
+
+    for (size_t i = 0; i < nActual; i++) {
+        const HASH_CDC_CHUNK* pKey = &pActual[i];
+        // Without index (out of memory), every chunk counts as changed
+        int isKnown = ppSorted && nExpected &&
+                      bsearch(&pKey, ppSorted, nExpected, sizeof(*ppSorted), CompareDigest);
+
+        if (isKnown) {
+            isInRange = 0;
+            continue;
+        }
+        if (isInRange) {
+            if (nRanges <= nMaxRanges) pRanges[nRanges - 1].cbSize += pActual[i].cbSize;
+            continue;
+        }
+        if (nRanges < nMaxRanges) {
+            pRanges[nRanges].cbOffset = pActual[i].cbOffset;
+            pRanges[nRanges].cbSize = pActual[i].cbSize;
+        }
+        nRanges++;
+        isInRange = 1;
+    }
+
+    free(ppSorted);
+    return nRanges;
+}
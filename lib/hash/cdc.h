@@ -0,0 +1,65 @@
+#ifndef INTEGRA_CDC_H
+#define INTEGRA_CDC_H
+
+/**
+ * Content-defined chunking (CDC) for large files: chunk boundaries are set by content, with
+ * a gear rolling hash over the last 64 bytes, instead of by offset. An insert or delete only
+ * changes the chunks it touches: chunks after it keep their boundaries and digests, shifted.
+ *
+ * File digest in CDC mode:
+ *
+ *      root = H( H(chunk0) | H(chunk1) | ... | H(chunkN-1) | cbTotal )
+ *
+ *  where  H        -  object's hash algorithm,
+ *         cbTotal  -  file size, 8-byte little-endian,
+ *          |       -  concat operation
+ *
+ * Boundaries: none before HASH_CDC_MIN_LEN, few (23-bit mask) up to HASH_CDC_AVG_LEN,
+ * more (19-bit mask) after it, always one at HASH_CDC_MAX_LEN. Chunks average about 2.5 MB.
+ *
+ * Each chunk also gets a fingerprint: fast, non-cryptographic (low 64 bits of XXH3-128). It only
+ * lets a new snapshot recognize chunks it already knows and carry their digests forward without
+ * hashing them again. Verification never trusts fingerprints: every chunk is hashed with H.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hash.h"
+#include "filehash.h"
+
+// Boundaries are part of stored digests: changing these changes every CDC digest
+#define HASH_CDC_MIN_LEN    (512 * 1024)
+#define HASH_CDC_AVG_LEN    (2 * 1024 * 1024)
+#define HASH_CDC_MAX_LEN    (8 * 1024 * 1024)
+
+typedef struct {
+    uint64_t h;                 // rolling hash
+    size_t cbChunk;             // bytes in current chunk so far
+} HASH_CDC;
+
+typedef struct {
+    uint64_t cbOffset;
+    uint64_t cbSize;
+    uint64_t qwFingerprint;
+    HASH_DIGEST digest;
+} HASH_CDC_CHUNK;
+
+// Byte range [cbOffset, cbOffset + cbSize) of file
+typedef struct {
+    uint64_t cbOffset;
+    uint64_t cbSize;
+} HASH_CDC_RANGE;
+
+void Hash_CdcInit(HASH_CDC* pCdc);
+size_t Hash_CdcScan(HASH_CDC* pCdc, const uint8_t* pbData, size_t cbData, int* pIsCut);
+uint64_t Hash_CdcFingerprint(const void* pData, size_t cbData);
+
+HASH_STATUS Hash_FileCdc(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hFile,
+                         const HASH_CDC_CHUNK* pKnown, size_t nKnown,
+                         HASH_CDC_CHUNK** ppChunks, size_t* pnChunks, size_t* pnReused);
+int Hash_CdcRoot(HASH_ALG alg, const HASH_CDC_CHUNK* pChunks, size_t nChunks, uint8_t* pDigest);
+size_t Hash_CdcDiff(const HASH_CDC_CHUNK* pExpected, size_t nExpected,
+                    const HASH_CDC_CHUNK* pActual, size_t nActual,
+                    HASH_CDC_RANGE* pRanges, size_t nMaxRanges);
+
+#endif //INTEGRA_CDC_H
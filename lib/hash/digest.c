@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <tchar.h>
+#include <malloc.h>
+#include "digest.h"
+#include "throttle.h"
+
+
+DWORD Hash_FileDigest(HASH_ALG alg, HASH_SCAN scan, HANDLE hFile, HASH_DIGEST* pDigest) {
+    /**
+     * @brief Compute digest from file contents by handle (see Hash_FileRaw)
+     */
+    memset(pDigest, 0, sizeof(*pDigest));
+    return Hash_FileRaw(alg, scan, hFile, pDigest->b);
+}
+
+
+DWORD Hash_FileDigestSample(HASH_ALG alg, HASH_SCAN scan, HANDLE hFile, HASH_DIGEST* pDigest) {
+    /**
+     * @brief Compute sample digest of huge file: head, middle and tail only (see Hash_FileRawSample)
+     */
+    LARGE_INTEGER liSize;
+
+    if (!GetFileSizeEx(hFile, &liSize)) return GetLastError();
+    memset(pDigest, 0, sizeof(*pDigest));
+    return Hash_FileRawSample(alg, scan, hFile, liSize.QuadPart, pDigest->b);
+}
+
+
+DWORD Hash_FileDigestCdc(HASH_ALG alg, HASH_SCAN scan, HANDLE hFile, const HASH_CDC_CHUNK* pKnown, size_t nKnown,
+                         HASH_CDC_CHUNK** ppChunks, size_t* pnChunks, size_t* pnReused, HASH_DIGEST* pDigest) {
+    /**
+     * @brief Compute CDC digest of file (see cdc.h) along with its chunk list (see Hash_FileCdc)
+     *
+     * @details Chunk list is returned in ppChunks, caller frees it
+     */
+    DWORD dwResult = Hash_FileCdc(alg, scan, hFile, pKnown, nKnown, ppChunks, pnChunks, pnReused);
+    if (dwResult != ERROR_SUCCESS) return dwResult;
+
+    memset(pDigest, 0, sizeof(*pDigest));
+    Hash_CdcRoot(alg, *ppChunks, *pnChunks, pDigest->b);
+    return ERROR_SUCCESS;
+}
+
+
+/*
+ *  Shared state of threads computing one tree digest (see Hash_FileDigestTree)
+ */
+typedef struct {
+    HASH_ALG alg;
+    HASH_SCAN scan;
+    HANDLE hFile;
+    ULONGLONG cbTotal;
+    ULONGLONG cbChunk;
+    LONG nLeaves;
+    volatile LONG iNextLeaf;
+    volatile LONG dwStatus;
+    LPBYTE pbLeaves;            // nLeaves digests, in chunk order
+} TREE_HASH_JOB;
+
+
+static DWORD WINAPI TreeHashWorker(LPVOID lpParam) {
+    /**
+     * @brief Take chunks off the job until none left, write their digests to pbLeaves
+     *
+     * @details Each worker reopens the file to get its own file object, so reads can run
+     *  in parallel. If that fails, caller's handle is used: reads are then serialized by
+     *  the system, but hashing still runs in parallel.
+     */
+    TREE_HASH_JOB* pJob = lpParam;
+    size_t cbDigest = Hash_DigestLen(pJob->alg);
+    HASH_CTX ctx;
+    LONG iLeaf;
+
+    HANDLE hFile = ReOpenFile(pJob->hFile, GENERIC_READ, FILE_SHARE_READ, Hash_ScanFileFlags(pJob->scan));
+    if (hFile == INVALID_HANDLE_VALUE) hFile = pJob->hFile;
+
+    LPBYTE pbBuf = Hash_IoBuffer();
+    if (!pbBuf) {
+        InterlockedCompareExchange(&pJob->dwStatus, ERROR_NOT_ENOUGH_MEMORY, ERROR_SUCCESS);
+        if (hFile != pJob->hFile) CloseHandle(hFile);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    while (pJob->dwStatus == ERROR_SUCCESS && (iLeaf = InterlockedIncrement(&pJob->iNextLeaf) - 1) < pJob->nLeaves) {
+        ULONGLONG cbOffset = iLeaf * pJob->cbChunk;
+        ULONGLONG cbEnd = min(cbOffset + pJob->cbChunk, pJob->cbTotal);
+
+        Hash_Init(&ctx, pJob->alg);
+        while (cbOffset < cbEnd) {
+            // Positional read: offset in OVERLAPPED, works on synchronous handles
+            OVERLAPPED ov = {0};
+            DWORD cbRead = 0;
+            BOOL bResult;
+            ov.Offset = (DWORD) cbOffset;
+            ov.OffsetHigh = (DWORD) (cbOffset >> 32);
+
+            // Whole sectors for unbuffered handles; anything past chunk end is not hashed
+            DWORD cbWant = (DWORD) min(cbEnd - cbOffset, HASH_TREE_READ_LEN);
+            cbWant = (cbWant + HASH_IO_ALIGN - 1) & ~(DWORD) (HASH_IO_ALIGN - 1);
+
+            uint64_t nsStart = Hash_ThrottleClock();
+            bResult = ReadFile(hFile, pbBuf, cbWant, &cbRead, &ov);
+            if (!bResult || !cbRead) {
+                // Truncated while reading counts as failure
+                InterlockedCompareExchange(&pJob->dwStatus, bResult ? ERROR_HANDLE_EOF : GetLastError(), ERROR_SUCCESS);
+                break;
+            }
+            Hash_ThrottleRead(cbRead, Hash_ThrottleClock() - nsStart);
+            cbRead = (DWORD) min(cbRead, cbEnd - cbOffset);
+            Hash_Update(&ctx, pbBuf, cbRead);
+            cbOffset += cbRead;
+        }
+        Hash_Final(&ctx, pJob->pbLeaves + iLeaf * cbDigest);
+    }
+
+    if (hFile != pJob->hFile) CloseHandle(hFile);
+    return ERROR_SUCCESS;
+}
+
+
+static DWORD WINAPI TreeHashThread(LPVOID lpParam) {
+    TreeHashWorker(lpParam);
+    Hash_IoBufferRelease();
+    return ERROR_SUCCESS;
+}
+
+
+DWORD Hash_FileDigestTree(HASH_ALG alg, HASH_SCAN scan, HANDLE hFile, ULONGLONG cbChunk, HASH_DIGEST* pDigest) {
+    /**
+     * @brief Compute tree digest of file (see treehash.h), hashing chunks on several threads
+     *
+     * @details File size is taken once, at start. Thread count is bounded by CPU count,
+     *  chunk count and HASH_TREE_MAX_THREADS; calling thread is one of the workers.
+     *  Gives the same root as Hash_TreeDigest() over file contents.
+     */
+    TREE_HASH_JOB job;
+    HANDLE rghThreads[HASH_TREE_MAX_THREADS];
+    LARGE_INTEGER liSize;
+    SYSTEM_INFO si;
+    DWORD nThreads, nStarted = 0;
+    ULONGLONG nLeaves;
+    size_t cbDigest = Hash_DigestLen(alg);
+
+    if (!cbDigest || !cbChunk) return ERROR_INVALID_PARAMETER;
+    if (!GetFileSizeEx(hFile, &liSize)) return GetLastError();
+
+    nLeaves = Hash_TreeLeafCount(liSize.QuadPart, cbChunk);
+    if (nLeaves > MAXLONG) return ERROR_INVALID_PARAMETER;
+
+    job.alg = alg;
+    job.scan = scan;
+    job.hFile = hFile;
+    job.cbTotal = liSize.QuadPart;
+    job.cbChunk = cbChunk;
+    job.nLeaves = (LONG) nLeaves;
+    job.iNextLeaf = 0;
+    job.dwStatus = ERROR_SUCCESS;
+    job.pbLeaves = malloc(nLeaves * cbDigest);
+    if (!job.pbLeaves) return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Empty file: single empty leaf
+    if (!job.cbTotal) Hash_Digest(alg, NULL, 0, job.pbLeaves);
+    else {
+        GetSystemInfo(&si);
+        nThreads = min(si.dwNumberOfProcessors, HASH_TREE_MAX_THREADS);
+        nThreads = (DWORD) min(nThreads, nLeaves);
+
+        for (DWORD i = 1; i < nThreads; i++) {
+            rghThreads[nStarted] = CreateThread(NULL, 0, TreeHashThread, &job, 0, NULL);
+            if (rghThreads[nStarted]) nStarted++;
+        }
+        TreeHashWorker(&job);
+
+        if (nStarted) WaitForMultipleObjects(nStarted, rghThreads, TRUE, INFINITE);
+        for (DWORD i = 0; i < nStarted; i++)
+            CloseHandle(rghThreads[i]);
+    }
+
+    if (job.dwStatus == ERROR_SUCCESS) {
+        memset(pDigest, 0, sizeof(*pDigest));
+        Hash_TreeRoot(alg, job.pbLeaves, nLeaves, cbChunk, job.cbTotal, pDigest->b);
+    }
+
+    free(job.pbLeaves);
+    return job.dwStatus;
+}
+
+
+DWORD Hash_FileDigestBatch(HASH_ALG alg, HASH_SCAN scan, const HANDLE* phFiles, DWORD nFiles, HASH_DIGEST* pDigests, LPDWORD pdwStatus) {
+    /**
+     * @brief Compute digests of several files at once. Files are read concurrently, small ones hashed in one batch
+     *
+     * @details All files go through Hash_FilePipeline(), so their reads are in flight together
+     *  instead of one after another. Files up to HASH_SMALL_FILE_LIMIT are read whole into one
+     *  arena and then passed to Hash_Batch() (SIMD lanes for MD5). Larger files (or files that
+     *  grew since their size was taken) are hashed by the pipeline as they are read.
+     *  Arena slots are sector-aligned, as unbuffered reads (nocache scan) require.
+     *
+     *  Status for each file is written to pdwStatus. Returns ERROR_SUCCESS unless arena
+     *  could not be allocated, in which case every file is hashed by the pipeline.
+     */
+    HASH_PIPE_JOB rgPipeJobs[HASH_BATCH_SIZE];
+    HASH_JOB rgJobs[HASH_BATCH_SIZE];
+    LARGE_INTEGER liSize;
+    DWORD nJobs = 0;
+    SIZE_T cbArena = 0;
+    LPBYTE pbArena, pbNext;
+    DWORD dwResult = ERROR_SUCCESS;
+    size_t cbDigest = Hash_DigestLen(alg);
+
+    if (nFiles > HASH_BATCH_SIZE || !cbDigest) return ERROR_INVALID_PARAMETER;
+
+    // Sizes first, to allocate arena once. At least one extra byte per file detects growth
+    for (DWORD i = 0; i < nFiles; i++) {
+        rgPipeJobs[i].szPath = NULL;
+        rgPipeJobs[i].hFile = phFiles[i];
+        rgPipeJobs[i].pbData = NULL;
+        rgPipeJobs[i].cbData = 0;
+        rgPipeJobs[i].pDigest = pDigests[i].b;
+        memset(&pDigests[i], 0, sizeof(pDigests[i]));
+        if (GetFileSizeEx(phFiles[i], &liSize) && liSize.QuadPart <= HASH_SMALL_FILE_LIMIT) {
+            rgPipeJobs[i].cbData = ((size_t) liSize.QuadPart + HASH_IO_ALIGN) & ~(size_t) (HASH_IO_ALIGN - 1);
+            cbArena += rgPipeJobs[i].cbData;
+        }
+    }
+
+    pbArena = pbNext = _aligned_malloc(cbArena ? cbArena : 1, HASH_IO_ALIGN);
+    if (pbArena) {
+        for (DWORD i = 0; i < nFiles; i++) {
+            if (!rgPipeJobs[i].cbData) continue;
+            rgPipeJobs[i].pbData = pbNext;
+            pbNext += rgPipeJobs[i].cbData;
+        }
+    }
+    else dwResult = ERROR_NOT_ENOUGH_MEMORY;
+
+    Hash_FilePipeline(alg, scan, NULL, rgPipeJobs, nFiles);
+
+    for (DWORD i = 0; i < nFiles; i++) {
+        pdwStatus[i] = rgPipeJobs[i].status;
+        if (pdwStatus[i] != ERROR_SUCCESS || rgPipeJobs[i].isHashed) continue;
+
+        // Read whole into arena: hash with its neighbours
+        rgJobs[nJobs].pData = rgPipeJobs[i].pbData;
+        rgJobs[nJobs].cbData = rgPipeJobs[i].cbData;
+        rgJobs[nJobs].pDigest = pDigests[i].b;
+        nJobs++;
+    }
+
+    Hash_Batch(alg, rgJobs, nJobs);
+
+    _aligned_free(pbArena);
+    return dwResult;
+}
+
+
+DWORD Hash_MemDigest(HASH_ALG alg, LPBYTE pbBuf, DWORD dwLen, HASH_DIGEST* pDigest) {
+    /**
+     * @brief Compute digest from memory buffer
+     */
+    memset(pDigest, 0, sizeof(*pDigest));
+    return Hash_MemRaw(alg, pbBuf, dwLen, pDigest->b);
+}
+
+
+DWORD Hash_MemRaw(HASH_ALG alg, LPBYTE pbBuf, DWORD dwLen, LPBYTE pbHashBuf) {
+    /**
+     * @brief Compute raw digest and store in pbHashBuf
+     *
+     * @details Safe to invoke with pbBuf == pbHashBuf
+     */
+    return Hash_Digest(alg, pbBuf, dwLen, pbHashBuf) ? ERROR_SUCCESS : ERROR_INVALID_PARAMETER;
+}
+
+
+static void XorNameHashes(HASH_ALG alg, TCHAR (*pszNames)[MAX_PATH], DWORD nNames, LPBYTE pbXorHash) {
+    /**
+     * @brief XOR digest of each name into pbXorHash. Names are hashed in one batch
+     */
+    HASH_JOB rgJobs[HASH_BATCH_SIZE];
+    BYTE rgbHashes[HASH_BATCH_SIZE][HASH_MAX_DIGEST_LEN];
+    size_t cbDigest = Hash_DigestLen(alg);
+
+    for (DWORD i = 0; i < nNames; i++) {
+        rgJobs[i].pData = pszNames[i];
+        rgJobs[i].cbData = _tcslen(pszNames[i]);
+        rgJobs[i].pDigest = rgbHashes[i];
+    }
+    Hash_Batch(alg, rgJobs, nNames);
+
+    for (DWORD i = 0; i < nNames; i++)
+        for (size_t k = 0; k < cbDigest; k++)
+            pbXorHash[k] ^= rgbHashes[i][k];
+}
+
+
+DWORD Hash_RegKeyDigest(HASH_ALG alg, HKEY hkBaseKey, HASH_DIGEST* pDigest) {
+    /**
+     * @brief Get digest from registry key's contents
+     *
+     * @details
+     *
+     *  Hash for key is computed as:
+     *      H( H(valueName1)^...^H(valueNameN) ^ H[H(keyName1)^...^H(keyNameM)] )
+     *
+     *  where  H                        -  object's hash algorithm
+     *         valueName1...valueNameN  -  values in key
+     *         keyName1...keyNameM      -  sub-keys contained in key
+     *          ^                       -  XOR operation
+     */
+
+    DWORD dwIndex, dwSize, nNames;
+    TCHAR (*pszNames)[MAX_PATH];
+    size_t cbDigest = Hash_DigestLen(alg);
+
+    BYTE pbXorHash[HASH_MAX_DIGEST_LEN] = {0};
+
+    if (!cbDigest) return ERROR_INVALID_PARAMETER;
+
+    // Names are collected and hashed HASH_BATCH_SIZE at a time
+    pszNames = malloc(HASH_BATCH_SIZE * sizeof(*pszNames));
+    if (!pszNames) return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Iterate over sub-keys
+    dwIndex = nNames = 0;
+    while (ERROR_SUCCESS == RegEnumKey(hkBaseKey, dwIndex, pszNames[nNames], MAX_PATH)) {
+        // H(keyName1)^...^H(keyNameM)
+        if (++nNames == HASH_BATCH_SIZE) {
+            XorNameHashes(alg, pszNames, nNames, pbXorHash);
+            nNames = 0;
+        }
+        dwIndex++;
+    }
+    XorNameHashes(alg, pszNames, nNames, pbXorHash);
+
+    // H( H(keyName1)^...^H(keyNameM) )
+    Hash_MemRaw(alg, pbXorHash, cbDigest, pbXorHash);
+
+    // Iterate over values
+    dwSize = MAX_PATH;
+    dwIndex = nNames = 0;
+    while (ERROR_SUCCESS == RegEnumValue(hkBaseKey, dwIndex, pszNames[nNames], &dwSize, NULL, NULL, NULL, NULL)) {
+        // ... ^ H(valueName1)^...^H(valueNameN)
+        if (++nNames == HASH_BATCH_SIZE) {
+            XorNameHashes(alg, pszNames, nNames, pbXorHash);
+            nNames = 0;
+        }
+        dwIndex++;
+    }
+    XorNameHashes(alg, pszNames, nNames, pbXorHash);
+    free(pszNames);
+
+    // H( H(valueName1)^...^H(valueNameN) ^ H[H(keyName1)^...^H(keyNameM)])
+    return Hash_MemDigest(alg, pbXorHash, cbDigest, pDigest);
+}
+
+
+DWORD Hash_RegValueDigest(HASH_ALG alg, HKEY hkBaseKey, LPCTSTR szName, HASH_DIGEST* pDigest) {
+    /**
+     * @brief Compute digest from registry value's type and actual value
+     *
+     * @details
+     *
+     *  Hash for value is computed as:
+     *    H( dwType | rbValue )
+     *
+     *  where  dwType   is  4-byte DWORD (usually little-endian),
+     *         rbValue  is  byte buffer for value,
+     *          |       is  concat operation
+     */
+    int res;
+    DWORD dwSize, dwType;
+
+    res = RegQueryValueEx(hkBaseKey, szName, NULL, &dwType, NULL, &dwSize);
+    if (res != ERROR_SUCCESS && res != ERROR_INSUFFICIENT_BUFFER) return res;
+
+    BYTE* pbRegBuf = malloc(dwSize * sizeof(BYTE) + sizeof(DWORD));
+    if (!pbRegBuf) return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Write Type (DWORD)
+    memcpy(pbRegBuf, &dwType, sizeof(DWORD));
+
+    // Get value from reg
+    res = RegQueryValueEx(hkBaseKey, szName, NULL, NULL, pbRegBuf + sizeof(DWORD), &dwSize);
+    if (res != ERROR_SUCCESS) { free(pbRegBuf); return res; }
+
+    // H( dwType | rbValue )
+    res = Hash_MemDigest(alg, pbRegBuf, dwSize + sizeof(DWORD), pDigest);
+    free(pbRegBuf);
+    return res;
+}
@@ -0,0 +1,36 @@
+#ifndef INTEGRA_DIGEST_H
+#define INTEGRA_DIGEST_H
+
+#include <windows.h>
+#include "hash.h"
+#include "treehash.h"
+#include "filehash.h"
+#include "filepipe.h"
+#include "cdc.h"
+
+// Files hashed together by Hash_FileDigestBatch(), names together by Hash_RegKeyDigest()
+#define HASH_BATCH_SIZE         64
+// Larger files are streamed instead of read whole into one batch
+#define HASH_SMALL_FILE_LIMIT   (64 * 1024)
+
+// Tree digest: at most this many threads per file, each reading this much at a time
+#ifndef HASH_TREE_MAX_THREADS
+#define HASH_TREE_MAX_THREADS   16
+#endif
+#define HASH_TREE_READ_LEN      HASH_IO_BUF_LEN
+
+// Digests are returned raw (see HASH_DIGEST); Hash_Encode() gives their text form
+DWORD Hash_FileDigest(HASH_ALG alg, HASH_SCAN scan, HANDLE hFile, HASH_DIGEST* pDigest);
+DWORD Hash_FileDigestTree(HASH_ALG alg, HASH_SCAN scan, HANDLE hFile, ULONGLONG cbChunk, HASH_DIGEST* pDigest);
+DWORD Hash_FileDigestSample(HASH_ALG alg, HASH_SCAN scan, HANDLE hFile, HASH_DIGEST* pDigest);
+DWORD Hash_FileDigestCdc(HASH_ALG alg, HASH_SCAN scan, HANDLE hFile, const HASH_CDC_CHUNK* pKnown, size_t nKnown,
+                         HASH_CDC_CHUNK** ppChunks, size_t* pnChunks, size_t* pnReused, HASH_DIGEST* pDigest);
+DWORD Hash_FileDigestBatch(HASH_ALG alg, HASH_SCAN scan, const HANDLE* phFiles, DWORD nFiles, HASH_DIGEST* pDigests, LPDWORD pdwStatus);
+
+DWORD Hash_RegKeyDigest(HASH_ALG alg, HKEY hkBaseKey, HASH_DIGEST* pDigest);
+DWORD Hash_RegValueDigest(HASH_ALG alg, HKEY hkBaseKey, LPCTSTR szName, HASH_DIGEST* pDigest);
+
+DWORD Hash_MemDigest(HASH_ALG alg, LPBYTE pbBuf, DWORD dwLen, HASH_DIGEST* pDigest);
+DWORD Hash_MemRaw(HASH_ALG alg, LPBYTE pbBuf, DWORD dwLen, LPBYTE pbHashBuf);
+
+#endif //INTEGRA_DIGEST_H
@@ -0,0 +1,347 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdlib.h>
+#include <ctype.h>
+#include "filehash.h"
+#include "throttle.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+// Reused by every file hashed on this thread
+static _Thread_local uint8_t* pbIoBuffer = NULL;
+
+// Object List names, by HASH_SCAN
+static const char* const rgszScanNames[HASH_SCAN_COUNT] = {"cached", "nocache"};
+
+
+const char* Hash_ScanName(HASH_SCAN scan) {
+    return ((unsigned) scan < HASH_SCAN_COUNT) ? rgszScanNames[scan] : NULL;
+}
+
+
+int Hash_FindScan(const char* szName, HASH_SCAN* pScan) {
+    /**
+     * @brief Look up scan mode by its Object List name (case-insensitive). 0 if unknown
+     */
+    for (int i = 0; i < HASH_SCAN_COUNT; i++) {
+        const char* a = rgszScanNames[i];
+        const char* b = szName;
+        while (*a && *a == tolower((unsigned char) *b)) { a++; b++; }
+        if (!*a && !*b) {
+            *pScan = (HASH_SCAN) i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+#ifdef _WIN32
+DWORD Hash_ScanFileFlags(HASH_SCAN scan) {
+    /**
+     * @brief CreateFile() / ReOpenFile() flags for files read in this scan mode
+     */
+    return (scan == HASH_SCAN_NOCACHE) ? FILE_FLAG_NO_BUFFERING : FILE_FLAG_SEQUENTIAL_SCAN;
+}
+#endif
+
+
+uint8_t* Hash_IoBuffer() {
+    /**
+     * @brief Get this thread's read buffer (HASH_IO_BUF_LEN bytes, HASH_IO_ALIGN-aligned).
+     * NULL if out of memory
+     *
+     * @details Short-lived threads should call Hash_IoBufferRelease() before they exit
+     */
+    if (!pbIoBuffer) {
+#ifdef _WIN32
+        pbIoBuffer = _aligned_malloc(HASH_IO_BUF_LEN, HASH_IO_ALIGN);
+#else
+        void* p;
+        if (0 == posix_memalign(&p, HASH_IO_ALIGN, HASH_IO_BUF_LEN)) pbIoBuffer = p;
+#endif
+    }
+    return pbIoBuffer;
+}
+
+
+void Hash_IoBufferRelease() {
+#ifdef _WIN32
+    _aligned_free(pbIoBuffer);
+#else
+    free(pbIoBuffer);
+#endif
+    pbIoBuffer = NULL;
+}
+
+
+HASH_STATUS Hash_FileStream(HASH_SCAN scan, HASH_FILE hFile, HASH_STREAM_FN pfnData, void* pArg) {
+    /**
+     * @brief Read file from its current position up to EOF, passing each piece to pfnData
+     *
+     * @details On Windows, a short read is taken as end of file: unbuffered handles cannot
+     *  read on from an unaligned position. On POSIX, nocache scan drops each piece from
+     *  page cache once it is consumed
+     */
+    uint8_t* pbBuf = Hash_IoBuffer();
+
+#ifdef _WIN32
+    DWORD cbRead = 0;
+    uint64_t nsStart = Hash_ThrottleClock();
+
+    (void) scan;
+    if (!pbBuf) return ERROR_NOT_ENOUGH_MEMORY;
+
+    while (ReadFile(hFile, pbBuf, HASH_IO_BUF_LEN, &cbRead, NULL)) {
+        Hash_ThrottleRead(cbRead, Hash_ThrottleClock() - nsStart);
+        pfnData(pArg, pbBuf, cbRead);
+        if (cbRead < HASH_IO_BUF_LEN) return ERROR_SUCCESS;
+        nsStart = Hash_ThrottleClock();
+    }
+    return GetLastError();
+#else
+    ssize_t cbRead;
+    off_t cbPos = (scan == HASH_SCAN_NOCACHE) ? lseek(hFile, 0, SEEK_CUR) : -1;
+    uint64_t nsStart = Hash_ThrottleClock();
+
+    if (!pbBuf) return ENOMEM;
+
+    while ((cbRead = read(hFile, pbBuf, HASH_IO_BUF_LEN)) != 0) {
+        if (cbRead < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        Hash_ThrottleRead((size_t) cbRead, Hash_ThrottleClock() - nsStart);
+        pfnData(pArg, pbBuf, (size_t) cbRead);
+        if (cbPos >= 0) {
+            posix_fadvise(hFile, cbPos, cbRead, POSIX_FADV_DONTNEED);
+            cbPos += cbRead;
+        }
+        nsStart = Hash_ThrottleClock();
+    }
+    return 0;
+#endif
+}
+
+
+static void HashPiece(void* pArg, const uint8_t* pbData, size_t cbData) {
+    Hash_Update(pArg, pbData, cbData);
+}
+
+
+HASH_STATUS Hash_FileContinue(HASH_CTX* ctx, HASH_SCAN scan, HASH_FILE hFile, uint8_t* pDigest) {
+    /**
+     * @brief Feed file from its current position up to EOF to context, write digest
+     */
+    HASH_STATUS status = Hash_FileStream(scan, hFile, HashPiece, ctx);
+    if (status == HASH_STATUS_OK) Hash_Final(ctx, pDigest);
+    return status;
+}
+
+
+HASH_STATUS Hash_FileRawRead(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hFile, uint8_t* pDigest) {
+    /**
+     * @brief Digest of file from current position, read through this thread's large buffer
+     */
+    HASH_CTX ctx;
+
+#ifdef _WIN32
+    if (!Hash_Init(&ctx, alg)) return ERROR_INVALID_PARAMETER;
+#else
+    if (!Hash_Init(&ctx, alg)) return EINVAL;
+    // Larger kernel read-ahead; ignored where unsupported
+    posix_fadvise(hFile, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return Hash_FileContinue(&ctx, scan, hFile, pDigest);
+}
+
+
+static void HashView(HASH_CTX* ctx, const uint8_t* pView, size_t cbView) {
+    /**
+     * @brief Hash mapped view a read buffer at a time: pages fault in as they are hashed, within budget
+     */
+    for (size_t cbDone = 0; cbDone < cbView; cbDone += HASH_IO_BUF_LEN) {
+        size_t cbPiece = (cbView - cbDone < HASH_IO_BUF_LEN) ? cbView - cbDone : HASH_IO_BUF_LEN;
+        Hash_ThrottleRead(cbPiece, 0);
+        Hash_Update(ctx, pView + cbDone, cbPiece);
+    }
+}
+
+
+HASH_STATUS Hash_FileRawMapped(HASH_ALG alg, HASH_FILE hFile, uint8_t* pDigest) {
+    /**
+     * @brief Digest of whole file, hashed from mapped views. Falls back to reads if file cannot be mapped
+     */
+    HASH_CTX ctx;
+    uint64_t cbTotal, cbOffset;
+
+#ifdef _WIN32
+    LARGE_INTEGER liSize;
+    HANDLE hMapping;
+
+    if (!Hash_Init(&ctx, alg)) return ERROR_INVALID_PARAMETER;
+    if (GetFileType(hFile) != FILE_TYPE_DISK || !GetFileSizeEx(hFile, &liSize) || !liSize.QuadPart)
+        return Hash_FileRawRead(alg, HASH_SCAN_CACHED, hFile, pDigest);
+    cbTotal = liSize.QuadPart;
+
+    hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!hMapping) return Hash_FileRawRead(alg, HASH_SCAN_CACHED, hFile, pDigest);
+
+    for (cbOffset = 0; cbOffset < cbTotal; cbOffset += HASH_MAP_VIEW_LEN) {
+        SIZE_T cbView = (SIZE_T) min(cbTotal - cbOffset, HASH_MAP_VIEW_LEN);
+        LPVOID pView = MapViewOfFile(hMapping, FILE_MAP_READ, (DWORD) (cbOffset >> 32), (DWORD) cbOffset, cbView);
+        if (!pView) {
+            DWORD dwError = GetLastError();
+            CloseHandle(hMapping);
+            return dwError;
+        }
+        HashView(&ctx, pView, cbView);
+        UnmapViewOfFile(pView);
+    }
+
+    CloseHandle(hMapping);
+    Hash_Final(&ctx, pDigest);
+    return ERROR_SUCCESS;
+#else
+    struct stat st;
+
+    if (!Hash_Init(&ctx, alg)) return EINVAL;
+    if (fstat(hFile, &st) != 0 || !S_ISREG(st.st_mode) || !st.st_size)
+        return Hash_FileRawRead(alg, HASH_SCAN_CACHED, hFile, pDigest);
+    cbTotal = (uint64_t) st.st_size;
+
+    for (cbOffset = 0; cbOffset < cbTotal; cbOffset += HASH_MAP_VIEW_LEN) {
+        size_t cbView = (size_t) (cbTotal - cbOffset < HASH_MAP_VIEW_LEN ? cbTotal - cbOffset : HASH_MAP_VIEW_LEN);
+        void* pView = mmap(NULL, cbView, PROT_READ, MAP_PRIVATE, hFile, (off_t) cbOffset);
+        if (pView == MAP_FAILED) {
+            // Nothing hashed yet: reads may still work (e.g. file system without mmap)
+            if (!cbOffset) return Hash_FileRawRead(alg, HASH_SCAN_CACHED, hFile, pDigest);
+            return errno;
+        }
+        posix_madvise(pView, cbView, POSIX_MADV_SEQUENTIAL);
+        HashView(&ctx, pView, cbView);
+        munmap(pView, cbView);
+    }
+
+    Hash_Final(&ctx, pDigest);
+    return 0;
+#endif
+}
+
+
+HASH_STATUS Hash_FileRaw(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hFile, uint8_t* pDigest) {
+    /**
+     * @brief Digest of file contents: mapped if built with HASH_FILE_MAP, file is large enough
+     * and scan goes through cache, read otherwise
+     */
+#ifdef HASH_FILE_MAP
+#ifdef _WIN32
+    LARGE_INTEGER liSize;
+    if (scan == HASH_SCAN_CACHED && GetFileSizeEx(hFile, &liSize) && liSize.QuadPart >= HASH_MAP_MIN_LEN)
+        return Hash_FileRawMapped(alg, hFile, pDigest);
+#else
+    struct stat st;
+    if (scan == HASH_SCAN_CACHED && fstat(hFile, &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= HASH_MAP_MIN_LEN)
+        return Hash_FileRawMapped(alg, hFile, pDigest);
+#endif
+#endif
+    return Hash_FileRawRead(alg, scan, hFile, pDigest);
+}
+
+
+static HASH_STATUS ReadAt(HASH_SCAN scan, HASH_FILE hFile, uint8_t* pbBuf, size_t cbWant, uint64_t cbOffset) {
+    /**
+     * @brief Read exactly cbWant bytes at cbOffset. Read size is rounded up to whole sectors,
+     * so buffer must hold that much
+     */
+    size_t cbAligned = (cbWant + HASH_IO_ALIGN - 1) & ~(size_t) (HASH_IO_ALIGN - 1);
+    size_t cbGot = 0;
+
+#ifdef _WIN32
+    (void) scan;
+    while (cbGot < cbWant) {
+        // Positional read: offset in OVERLAPPED, works on synchronous handles
+        OVERLAPPED ov = {0};
+        DWORD cbRead = 0;
+        ov.Offset = (DWORD) (cbOffset + cbGot);
+        ov.OffsetHigh = (DWORD) ((cbOffset + cbGot) >> 32);
+
+        uint64_t nsStart = Hash_ThrottleClock();
+        if (!ReadFile(hFile, pbBuf + cbGot, (DWORD) (cbAligned - cbGot), &cbRead, &ov)) return GetLastError();
+        if (!cbRead) return ERROR_HANDLE_EOF;   // truncated since size was taken
+        Hash_ThrottleRead(cbRead, Hash_ThrottleClock() - nsStart);
+        cbGot += cbRead;
+    }
+    return ERROR_SUCCESS;
+#else
+    while (cbGot < cbWant) {
+        uint64_t nsStart = Hash_ThrottleClock();
+        ssize_t cbRead = pread(hFile, pbBuf + cbGot, cbAligned - cbGot, (off_t) (cbOffset + cbGot));
+        if (cbRead < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        if (!cbRead) return EIO;                // truncated since size was taken
+        Hash_ThrottleRead((size_t) cbRead, Hash_ThrottleClock() - nsStart);
+        cbGot += (size_t) cbRead;
+    }
+    if (scan == HASH_SCAN_NOCACHE) posix_fadvise(hFile, (off_t) cbOffset, (off_t) cbGot, POSIX_FADV_DONTNEED);
+    return 0;
+#endif
+}
+
+
+HASH_STATUS Hash_FileRawSample(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hFile, uint64_t cbTotal, uint8_t* pDigest) {
+    /**
+     * @brief Sample digest of file of cbTotal bytes (see filehash.h). At least HASH_SAMPLE_THRESHOLD
+     *
+     * @details Reads are positional. On Windows they move file pointer, so it is put back at start
+     *  for a full pass to follow
+     */
+    uint64_t rgcbOffsets[3];
+    uint8_t rgbSize[8];
+    uint8_t* pbBuf = Hash_IoBuffer();
+    HASH_STATUS status = HASH_STATUS_OK;
+    HASH_CTX ctx;
+
+#ifdef _WIN32
+    if (!pbBuf) return ERROR_NOT_ENOUGH_MEMORY;
+    if (cbTotal < HASH_SAMPLE_THRESHOLD || !Hash_Init(&ctx, alg)) return ERROR_INVALID_PARAMETER;
+#else
+    if (!pbBuf) return ENOMEM;
+    if (cbTotal < HASH_SAMPLE_THRESHOLD || !Hash_Init(&ctx, alg)) return EINVAL;
+#endif
+
+    rgcbOffsets[0] = 0;
+    rgcbOffsets[1] = (cbTotal / 2 - HASH_SAMPLE_LEN / 2) & ~(uint64_t) (HASH_IO_ALIGN - 1);
+    rgcbOffsets[2] = (cbTotal - HASH_SAMPLE_LEN) & ~(uint64_t) (HASH_IO_ALIGN - 1);
+
+    for (int i = 0; i < 3 && status == HASH_STATUS_OK; i++) {
+        size_t cbSample = (i < 2) ? HASH_SAMPLE_LEN : (size_t) (cbTotal - rgcbOffsets[2]);
+        status = ReadAt(scan, hFile, pbBuf, cbSample, rgcbOffsets[i]);
+        if (status == HASH_STATUS_OK) Hash_Update(&ctx, pbBuf, cbSample);
+    }
+
+#ifdef _WIN32
+    LARGE_INTEGER liZero = {0};
+    SetFilePointerEx(hFile, liZero, NULL, FILE_BEGIN);
+#endif
+    if (status != HASH_STATUS_OK) return status;
+
+    for (int i = 0; i < 8; i++)
+        rgbSize[i] = (uint8_t) (cbTotal >> (8 * i));
+    Hash_Update(&ctx, rgbSize, sizeof(rgbSize));
+    Hash_Final(&ctx, pDigest);
+    return HASH_STATUS_OK;
+}
@@ -0,0 +1,88 @@
+#ifndef INTEGRA_FILEHASH_H
+#define INTEGRA_FILEHASH_H
+
+/**
+ * File hashing at device bandwidth: large aligned reads or mapped views instead of
+ * small ReadFile() / read() calls. Windows and POSIX implementations, same results.
+ *
+ * Read path (default): one HASH_IO_BUF_LEN buffer per thread, page-aligned and reused
+ * for every file that thread hashes.
+ *
+ * Mapped path: file is mapped HASH_MAP_VIEW_LEN at a time and hashed straight from
+ * page cache. Used by Hash_FileRaw() only when built with HASH_FILE_MAP, since an I/O
+ * error (or truncation, on POSIX) while reading a view faults the process instead of
+ * failing the call. Files that cannot be mapped (empty, not regular) are read.
+ *
+ * Scan mode, chosen per object, decides what a scan leaves in page cache:
+ *   cached   -  read through cache, with sequential read-ahead hint
+ *   nocache  -  leave cache as it was, so scanning large trees does not evict other
+ *               programs' data. Windows: unbuffered reads (FILE_FLAG_NO_BUFFERING), so every
+ *               read is sector-aligned (HASH_IO_ALIGN) and a short read means end of file.
+ *               POSIX: pages are dropped (POSIX_FADV_DONTNEED) right after they are read.
+ *               Never mapped
+ *
+ * Sample digest: cheap pre-check for huge files, over HASH_SAMPLE_LEN bytes from head,
+ * middle and tail of file, so a routine check reads a few MB instead of the whole file:
+ *
+ *      H( head | middle | tail | cbTotal )
+ *
+ *  where  middle, tail  -  start at HASH_IO_ALIGN boundary, tail runs to end of file
+ *         cbTotal       -  file size, 8-byte little-endian
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hash.h"
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE HASH_FILE;
+typedef DWORD HASH_STATUS;          // ERROR_SUCCESS or GetLastError()
+#else
+typedef int HASH_FILE;
+typedef int HASH_STATUS;            // 0 or errno
+#endif
+
+#define HASH_STATUS_OK      0
+
+typedef enum {
+    HASH_SCAN_CACHED = 0,
+    HASH_SCAN_NOCACHE,
+    HASH_SCAN_COUNT
+} HASH_SCAN;
+
+#define HASH_DEFAULT_SCAN   HASH_SCAN_CACHED
+
+#define HASH_IO_ALIGN       4096
+#define HASH_IO_BUF_LEN     (1024 * 1024)
+
+// Mapped path: view size (multiple of allocation granularity) and smallest file worth mapping
+#define HASH_MAP_VIEW_LEN   (64 * 1024 * 1024)
+#define HASH_MAP_MIN_LEN    (1024 * 1024)
+
+// Sample digest: bytes per sample (tail, rounded to sector, must fit HASH_IO_BUF_LEN), and smallest file sampled
+#define HASH_SAMPLE_LEN     (512 * 1024)
+#ifndef HASH_SAMPLE_THRESHOLD
+#define HASH_SAMPLE_THRESHOLD   (64 * 1024 * 1024)
+#endif
+
+HASH_STATUS Hash_FileRaw(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hFile, uint8_t* pDigest);
+HASH_STATUS Hash_FileRawRead(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hFile, uint8_t* pDigest);
+HASH_STATUS Hash_FileRawMapped(HASH_ALG alg, HASH_FILE hFile, uint8_t* pDigest);
+HASH_STATUS Hash_FileContinue(HASH_CTX* ctx, HASH_SCAN scan, HASH_FILE hFile, uint8_t* pDigest);
+
+// Receives file contents piece by piece, in order
+typedef void (*HASH_STREAM_FN)(void* pArg, const uint8_t* pbData, size_t cbData);
+HASH_STATUS Hash_FileStream(HASH_SCAN scan, HASH_FILE hFile, HASH_STREAM_FN pfnData, void* pArg);
+HASH_STATUS Hash_FileRawSample(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hFile, uint64_t cbTotal, uint8_t* pDigest);
+
+const char* Hash_ScanName(HASH_SCAN scan);
+int Hash_FindScan(const char* szName, HASH_SCAN* pScan);
+#ifdef _WIN32
+DWORD Hash_ScanFileFlags(HASH_SCAN scan);
+#endif
+
+uint8_t* Hash_IoBuffer();
+void Hash_IoBufferRelease();
+
+#endif //INTEGRA_FILEHASH_H
@@ -0,0 +1,673 @@
+#ifndef _WIN32
+#define _GNU_SOURCE             // syscall(), MAP_POPULATE
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "filepipe.h"
+#include "throttle.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef HASH_PIPE_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#ifdef _WIN32
+#define PIPE_ERROR_PARAM    ERROR_INVALID_PARAMETER
+#else
+#define PIPE_ERROR_PARAM    EINVAL
+#endif
+
+
+/*
+ *  Thread pool backend
+ */
+
+typedef struct {
+    HASH_ALG alg;
+    HASH_SCAN scan;
+    HASH_FILE hDir;
+    HASH_PIPE_JOB* pJobs;
+    size_t nJobs;
+    atomic_size_t iNext;        // next job to take
+} PIPE_POOL;
+
+
+static HASH_STATUS ReadCapture(HASH_FILE hFile, uint8_t* pbBuf, size_t cbBuf, size_t* pcbRead) {
+    /**
+     * @brief Read until buffer is full or file ends
+     *
+     * @details On Windows, a short read is end of file (see Hash_FileContinue)
+     */
+    size_t cbTotal = 0;
+
+#ifdef _WIN32
+    DWORD cbRead;
+    while (cbTotal < cbBuf) {
+        DWORD cbWant = (cbBuf - cbTotal > MAXDWORD) ? MAXDWORD : (DWORD) (cbBuf - cbTotal);
+        uint64_t nsStart = Hash_ThrottleClock();
+        if (!ReadFile(hFile, pbBuf + cbTotal, cbWant, &cbRead, NULL)) return GetLastError();
+        Hash_ThrottleRead(cbRead, Hash_ThrottleClock() - nsStart);
+        cbTotal += cbRead;
+        if (cbRead < cbWant) break;
+    }
+#else
+    while (cbTotal < cbBuf) {
+        uint64_t nsStart = Hash_ThrottleClock();
+        ssize_t cbRead = read(hFile, pbBuf + cbTotal, cbBuf - cbTotal);
+        if (cbRead < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        if (!cbRead) break;
+        Hash_ThrottleRead((size_t) cbRead, Hash_ThrottleClock() - nsStart);
+        cbTotal += (size_t) cbRead;
+    }
+#endif
+
+    *pcbRead = cbTotal;
+    return HASH_STATUS_OK;
+}
+
+
+static void PipeRunJob(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hDir, HASH_PIPE_JOB* pJob) {
+    /**
+     * @brief Open, read and hash one file with blocking calls. Close it if opened here
+     */
+    HASH_FILE hFile = pJob->hFile;
+    size_t cbCap = pJob->cbData;
+    HASH_CTX ctx;
+
+    pJob->isHashed = 0;
+    pJob->cbData = 0;
+
+    if (hFile == HASH_FILE_NONE) {
+        Hash_ThrottleOpen();
+#ifdef _WIN32
+        (void) hDir;
+        hFile = CreateFile(pJob->szPath, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, Hash_ScanFileFlags(scan), NULL);
+        if (hFile == INVALID_HANDLE_VALUE) {
+            pJob->status = GetLastError();
+            return;
+        }
+#else
+        hFile = openat(hDir, pJob->szPath, O_RDONLY | O_CLOEXEC);
+        if (hFile < 0) {
+            pJob->status = errno;
+            return;
+        }
+#endif
+    }
+
+    if (pJob->pbData) {
+        pJob->status = ReadCapture(hFile, pJob->pbData, cbCap, &pJob->cbData);
+
+        // Filled capture buffer: file may go on, hash all of it
+        if (pJob->status == HASH_STATUS_OK && pJob->cbData == cbCap) {
+            Hash_Init(&ctx, alg);
+            Hash_Update(&ctx, pJob->pbData, cbCap);
+            pJob->status = Hash_FileContinue(&ctx, scan, hFile, pJob->pDigest);
+            pJob->isHashed = 1;
+        }
+    }
+    else {
+        pJob->status = Hash_FileRaw(alg, scan, hFile, pJob->pDigest);
+        pJob->isHashed = 1;
+    }
+
+#ifndef _WIN32
+    // Captured part was not dropped as it was read
+    if (scan == HASH_SCAN_NOCACHE) posix_fadvise(hFile, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+
+    if (hFile != pJob->hFile) {
+#ifdef _WIN32
+        CloseHandle(hFile);
+#else
+        close(hFile);
+#endif
+    }
+}
+
+
+static void PipePoolRun(PIPE_POOL* pPool) {
+    size_t i;
+    while ((i = atomic_fetch_add(&pPool->iNext, 1)) < pPool->nJobs)
+        PipeRunJob(pPool->alg, pPool->scan, pPool->hDir, &pPool->pJobs[i]);
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI PipeWorker(LPVOID lpParam) {
+    PipePoolRun(lpParam);
+    Hash_IoBufferRelease();
+    return 0;
+}
+#else
+static void* PipeWorker(void* pParam) {
+    PipePoolRun(pParam);
+    Hash_IoBufferRelease();
+    return NULL;
+}
+#endif
+
+
+HASH_STATUS Hash_FilePipelineThreads(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hDir, HASH_PIPE_JOB* pJobs, size_t nJobs) {
+    /**
+     * @brief Hash files on up to HASH_PIPE_THREADS threads, one blocking file at a time per thread
+     *
+     * @details Calling thread is one of workers. If a thread cannot be started, the others
+     *  take its share. Status of each file is written to its job
+     */
+    PIPE_POOL pool;
+    size_t nThreads = (nJobs < HASH_PIPE_THREADS) ? nJobs : HASH_PIPE_THREADS;
+    size_t nStarted = 0;
+#ifdef _WIN32
+    HANDLE rghThreads[HASH_PIPE_THREADS];
+#else
+    pthread_t rgThreads[HASH_PIPE_THREADS];
+#endif
+
+    if (!Hash_DigestLen(alg)) return PIPE_ERROR_PARAM;
+
+    pool.alg = alg;
+    pool.scan = scan;
+    pool.hDir = hDir;
+    pool.pJobs = pJobs;
+    pool.nJobs = nJobs;
+    atomic_init(&pool.iNext, 0);
+
+    for (size_t t = 1; t < nThreads; t++) {
+#ifdef _WIN32
+        rghThreads[nStarted] = CreateThread(NULL, 0, PipeWorker, &pool, 0, NULL);
+        if (rghThreads[nStarted]) nStarted++;
+#else
+        if (0 == pthread_create(&rgThreads[nStarted], NULL, PipeWorker, &pool)) nStarted++;
+#endif
+    }
+
+    PipePoolRun(&pool);
+
+#ifdef _WIN32
+    if (nStarted) WaitForMultipleObjects((DWORD) nStarted, rghThreads, TRUE, INFINITE);
+    for (size_t t = 0; t < nStarted; t++) CloseHandle(rghThreads[t]);
+#else
+    for (size_t t = 0; t < nStarted; t++) pthread_join(rgThreads[t], NULL);
+#endif
+
+    return HASH_STATUS_OK;
+}
+
+
+#ifdef HASH_PIPE_URING
+
+/*
+ *  io_uring backend: raw system calls, no liburing
+ */
+
+#define PIPE_TAG_CLOSE  UINT64_MAX      // user_data of close requests, nobody waits for them
+
+typedef struct {
+    int fd;
+    unsigned nEntries;
+    unsigned nQueued;           // written to SQ, not yet submitted
+    unsigned nInflight;         // queued or submitted, not yet completed
+    unsigned sqTail;            // local copy, published on submit
+    unsigned *pSqHead, *pSqTail, *pSqMask, *pSqArray;
+    unsigned *pCqHead, *pCqTail, *pCqMask;
+    struct io_uring_sqe* pSqes;
+    struct io_uring_cqe* pCqes;
+    void *pSqRing, *pCqRing;
+    size_t cbSqRing, cbCqRing, cbSqes;
+} PIPE_RING;
+
+typedef struct {
+    HASH_PIPE_JOB* pJob;        // NULL if slot is free
+    int fd;
+    int isOwnFd;                // opened here, close when done
+    int isOpening;
+    int isCapturing;            // reading into pJob->pbData
+    int isStream;               // no offsets (pipe): read at current position
+    HASH_SCAN scan;
+    uint64_t cbOffset;          // of next read
+    uint64_t nsQueued;          // when next read was queued (see Hash_ThrottleRead)
+    size_t cbCap, cbCaptured;
+    unsigned iBuf;              // buffer the next read goes to
+    uint8_t* rgpbBuf[2];
+    const uint8_t* pbPending;   // read completed this round, hash after next submit
+    size_t cbPending;
+    HASH_CTX ctx;
+} PIPE_SLOT;
+
+
+static int nUringState = 0;    // 0: not checked, 1: usable, -1: not available
+
+
+static void RingClose(PIPE_RING* pRing) {
+    if (pRing->pSqes) munmap(pRing->pSqes, pRing->cbSqes);
+    if (pRing->pCqRing && pRing->pCqRing != pRing->pSqRing) munmap(pRing->pCqRing, pRing->cbCqRing);
+    if (pRing->pSqRing) munmap(pRing->pSqRing, pRing->cbSqRing);
+    close(pRing->fd);
+}
+
+
+static int RingOpen(PIPE_RING* pRing, unsigned nEntries) {
+    /**
+     * @brief Set up ring and map its queues. Returns 0 or errno
+     */
+    struct io_uring_params params;
+    int iError;
+
+    memset(pRing, 0, sizeof(PIPE_RING));
+    memset(&params, 0, sizeof(params));
+
+    pRing->fd = (int) syscall(__NR_io_uring_setup, nEntries, &params);
+    if (pRing->fd < 0) return errno;
+
+    pRing->nEntries = params.sq_entries;
+    pRing->cbSqRing = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    pRing->cbCqRing = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    pRing->cbSqes = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (pRing->cbCqRing > pRing->cbSqRing) pRing->cbSqRing = pRing->cbCqRing;
+        pRing->cbCqRing = pRing->cbSqRing;
+    }
+
+    pRing->pSqRing = mmap(NULL, pRing->cbSqRing, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_SQ_RING);
+    if (pRing->pSqRing == MAP_FAILED) goto fail;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) pRing->pCqRing = pRing->pSqRing;
+    else {
+        pRing->pCqRing = mmap(NULL, pRing->cbCqRing, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_CQ_RING);
+        if (pRing->pCqRing == MAP_FAILED) goto fail;
+    }
+
+    pRing->pSqes = mmap(NULL, pRing->cbSqes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_SQES);
+    if (pRing->pSqes == MAP_FAILED) goto fail;
+
+    pRing->pSqHead  = (unsigned*) ((uint8_t*) pRing->pSqRing + params.sq_off.head);
+    pRing->pSqTail  = (unsigned*) ((uint8_t*) pRing->pSqRing + params.sq_off.tail);
+    pRing->pSqMask  = (unsigned*) ((uint8_t*) pRing->pSqRing + params.sq_off.ring_mask);
+    pRing->pSqArray = (unsigned*) ((uint8_t*) pRing->pSqRing + params.sq_off.array);
+    pRing->pCqHead  = (unsigned*) ((uint8_t*) pRing->pCqRing + params.cq_off.head);
+    pRing->pCqTail  = (unsigned*) ((uint8_t*) pRing->pCqRing + params.cq_off.tail);
+    pRing->pCqMask  = (unsigned*) ((uint8_t*) pRing->pCqRing + params.cq_off.ring_mask);
+    pRing->pCqes    = (struct io_uring_cqe*) ((uint8_t*) pRing->pCqRing + params.cq_off.cqes);
+    pRing->sqTail   = *pRing->pSqTail;
+
+    // SQ entry i always describes sqes[i]
+    for (unsigned i = 0; i < pRing->nEntries; i++) pRing->pSqArray[i] = i;
+    return 0;
+
+fail:
+    iError = errno;
+    if (pRing->pSqRing == MAP_FAILED) pRing->pSqRing = NULL;
+    if (pRing->pCqRing == MAP_FAILED) pRing->pCqRing = NULL;
+    if (pRing->pSqes == MAP_FAILED) pRing->pSqes = NULL;
+    RingClose(pRing);
+    return iError;
+}
+
+
+static int RingSupportsOps(const PIPE_RING* pRing) {
+    /**
+     * @brief Check kernel has openat, read and close requests (5.6+)
+     */
+    static const int rgOps[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+    size_t cbProbe = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* pProbe = calloc(1, cbProbe);
+    int isSupported = 0;
+
+    if (!pProbe) return 0;
+    if (syscall(__NR_io_uring_register, pRing->fd, IORING_REGISTER_PROBE, pProbe, IORING_OP_LAST) >= 0) {
+        isSupported = 1;
+        for (size_t i = 0; i < sizeof(rgOps) / sizeof(rgOps[0]); i++)
+            if (rgOps[i] > pProbe->last_op || !(pProbe->ops[rgOps[i]].flags & IO_URING_OP_SUPPORTED))
+                isSupported = 0;
+    }
+
+    free(pProbe);
+    return isSupported;
+}
+
+
+static struct io_uring_sqe* RingSqe(PIPE_RING* pRing, uint64_t userData) {
+    /**
+     * @brief Take next submission entry, cleared. NULL if every entry is in flight
+     */
+    struct io_uring_sqe* pSqe;
+
+    if (pRing->nInflight == pRing->nEntries) return NULL;
+
+    pSqe = &pRing->pSqes[pRing->sqTail & *pRing->pSqMask];
+    memset(pSqe, 0, sizeof(struct io_uring_sqe));
+    pSqe->user_data = userData;
+
+    pRing->sqTail++;
+    pRing->nQueued++;
+    pRing->nInflight++;
+    return pSqe;
+}
+
+
+static int RingEnter(PIPE_RING* pRing, unsigned nWait) {
+    /**
+     * @brief Submit queued entries, then wait for nWait completions. Returns 0 or errno
+     */
+    __atomic_store_n(pRing->pSqTail, pRing->sqTail, __ATOMIC_RELEASE);
+
+    for (;;) {
+        long res = syscall(__NR_io_uring_enter, pRing->fd, pRing->nQueued, nWait, nWait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (res >= 0) {
+            pRing->nQueued -= (unsigned) res;
+            return 0;
+        }
+        if (errno != EINTR && errno != EAGAIN) return errno;
+    }
+}
+
+
+static void SlotQueueRead(PIPE_RING* pRing, PIPE_SLOT* pSlot, unsigned iSlot) {
+    /**
+     * @brief Read next piece: into capture buffer while file fits there, into spare buffer after
+     */
+    struct io_uring_sqe* pSqe = RingSqe(pRing, iSlot);      // slot has nothing else in flight: never NULL
+
+    pSlot->nsQueued = Hash_ThrottleClock();
+    pSqe->opcode = IORING_OP_READ;
+    pSqe->fd = pSlot->fd;
+    pSqe->off = pSlot->isStream ? (uint64_t) -1 : pSlot->cbOffset;
+    if (pSlot->isCapturing) {
+        size_t cbLeft = pSlot->cbCap - pSlot->cbCaptured;
+        pSqe->addr = (uintptr_t) (pSlot->pJob->pbData + pSlot->cbCaptured);
+        pSqe->len = (cbLeft > (1u << 30)) ? (1u << 30) : (unsigned) cbLeft;
+    }
+    else {
+        pSqe->addr = (uintptr_t) pSlot->rgpbBuf[pSlot->iBuf];
+        pSqe->len = HASH_PIPE_READ_LEN;
+    }
+}
+
+
+static void SlotFinish(PIPE_RING* pRing, PIPE_SLOT* pSlot, HASH_STATUS status) {
+    /**
+     * @brief Set job status, drop file from cache (nocache scan), close it in background and free slot
+     */
+    struct io_uring_sqe* pSqe;
+
+    pSlot->pJob->status = status;
+
+    // Read-ahead may have cached more than was read
+    if (pSlot->scan == HASH_SCAN_NOCACHE && pSlot->fd >= 0)
+        posix_fadvise(pSlot->fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    if (pSlot->isOwnFd && pSlot->fd >= 0) {
+        pSqe = RingSqe(pRing, PIPE_TAG_CLOSE);
+        if (pSqe) {
+            pSqe->opcode = IORING_OP_CLOSE;
+            pSqe->fd = pSlot->fd;
+        }
+        else close(pSlot->fd);
+    }
+    pSlot->pJob = NULL;
+}
+
+
+static void SlotStart(PIPE_RING* pRing, PIPE_SLOT* pSlot, unsigned iSlot, HASH_PIPE_JOB* pJob, HASH_FILE hDir, HASH_ALG alg, HASH_SCAN scan) {
+    /**
+     * @brief Take job: queue open, or first read if file is already open
+     */
+    pSlot->pJob = pJob;
+    pSlot->scan = scan;
+    pSlot->cbCap = pJob->cbData;
+    pSlot->cbCaptured = 0;
+    pSlot->isCapturing = pJob->pbData && pSlot->cbCap;
+    pSlot->iBuf = 0;
+    pSlot->cbPending = 0;
+    pJob->isHashed = 0;
+    pJob->cbData = 0;
+    Hash_Init(&pSlot->ctx, alg);
+
+    if (pJob->hFile == HASH_FILE_NONE) {
+        Hash_ThrottleOpen();
+        struct io_uring_sqe* pSqe = RingSqe(pRing, iSlot);
+        pSqe->opcode = IORING_OP_OPENAT;
+        pSqe->fd = hDir;
+        pSqe->addr = (uintptr_t) pJob->szPath;
+        pSqe->open_flags = O_RDONLY | O_CLOEXEC;
+        pSlot->fd = -1;
+        pSlot->isOwnFd = 1;
+        pSlot->isOpening = 1;
+        return;
+    }
+
+    off_t cbPos = lseek(pJob->hFile, 0, SEEK_CUR);
+    pSlot->fd = pJob->hFile;
+    pSlot->isOwnFd = 0;
+    pSlot->isOpening = 0;
+    pSlot->isStream = cbPos < 0;
+    pSlot->cbOffset = (cbPos < 0) ? 0 : (uint64_t) cbPos;
+    SlotQueueRead(pRing, pSlot, iSlot);
+}
+
+
+static void SlotComplete(PIPE_RING* pRing, PIPE_SLOT* pSlot, unsigned iSlot, int res) {
+    /**
+     * @brief Handle completed open or read of slot's file
+     */
+    HASH_PIPE_JOB* pJob = pSlot->pJob;
+
+    if (pSlot->isOpening) {
+        pSlot->isOpening = 0;
+        if (res < 0) {
+            SlotFinish(pRing, pSlot, -res);
+            return;
+        }
+        pSlot->fd = res;
+        pSlot->isStream = 0;
+        pSlot->cbOffset = 0;
+        SlotQueueRead(pRing, pSlot, iSlot);
+        return;
+    }
+
+    if (res == -EINTR || res == -EAGAIN) {
+        SlotQueueRead(pRing, pSlot, iSlot);
+        return;
+    }
+    if (res < 0) {
+        SlotFinish(pRing, pSlot, -res);
+        return;
+    }
+
+    // End of file: digest, unless it all fit in capture buffer
+    if (res == 0) {
+        if (pSlot->isCapturing) pJob->cbData = pSlot->cbCaptured;
+        else {
+            Hash_Final(&pSlot->ctx, pJob->pDigest);
+            pJob->isHashed = 1;
+        }
+        SlotFinish(pRing, pSlot, HASH_STATUS_OK);
+        return;
+    }
+
+    // Whole ring waits for budget: no more reads are queued meanwhile
+    Hash_ThrottleRead((size_t) res, Hash_ThrottleClock() - pSlot->nsQueued);
+
+    // Data is in our buffer: page cache copy is not needed
+    if (pSlot->scan == HASH_SCAN_NOCACHE && !pSlot->isStream)
+        posix_fadvise(pSlot->fd, (off_t) pSlot->cbOffset, res, POSIX_FADV_DONTNEED);
+    pSlot->cbOffset += (uint64_t) res;
+
+    if (pSlot->isCapturing) {
+        pSlot->cbCaptured += (size_t) res;
+        // Filled capture buffer: file may go on, hash all of it
+        if (pSlot->cbCaptured == pSlot->cbCap) {
+            pSlot->isCapturing = 0;
+            pJob->cbData = pSlot->cbCap;
+            pSlot->pbPending = pJob->pbData;
+            pSlot->cbPending = pSlot->cbCap;
+        }
+    }
+    else {
+        pSlot->pbPending = pSlot->rgpbBuf[pSlot->iBuf];
+        pSlot->cbPending = (size_t) res;
+        pSlot->iBuf ^= 1;
+    }
+    SlotQueueRead(pRing, pSlot, iSlot);
+}
+
+
+static unsigned RingReap(PIPE_RING* pRing, PIPE_SLOT* pSlots) {
+    /**
+     * @brief Handle every completion available. Returns number of files finished
+     */
+    unsigned head = *pRing->pCqHead;
+    unsigned tail = __atomic_load_n(pRing->pCqTail, __ATOMIC_ACQUIRE);
+    unsigned nFinished = 0;
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe* pCqe = &pRing->pCqes[head & *pRing->pCqMask];
+        pRing->nInflight--;
+        if (pCqe->user_data == PIPE_TAG_CLOSE) continue;
+
+        PIPE_SLOT* pSlot = &pSlots[pCqe->user_data];
+        SlotComplete(pRing, pSlot, (unsigned) pCqe->user_data, pCqe->res);
+        if (!pSlot->pJob) nFinished++;
+    }
+
+    __atomic_store_n(pRing->pCqHead, head, __ATOMIC_RELEASE);
+    return nFinished;
+}
+
+
+static int IsUringUsable() {
+    /**
+     * @brief Check once whether io_uring can be set up and has requests we need
+     */
+    if (!nUringState) {
+        PIPE_RING ring;
+        int state = -1;
+        if (0 == RingOpen(&ring, 2)) {
+            if (RingSupportsOps(&ring)) state = 1;
+            RingClose(&ring);
+        }
+        nUringState = state;
+    }
+    return nUringState > 0;
+}
+
+
+HASH_STATUS Hash_FilePipelineUring(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hDir, HASH_PIPE_JOB* pJobs, size_t nJobs) {
+    /**
+     * @brief Hash files with up to HASH_PIPE_DEPTH of them in flight on one io_uring
+     *
+     * @details Each round:
+     *   - free slots take next files: queue openat (or first read for files already open)
+     *   - submit, wait for at least one completion
+     *   - handle completions: opened -> queue read; read -> queue next read into the slot's
+     *     other buffer, remember data; end of file -> digest, queue close, free slot
+     *   - submit again, so next reads run while remembered data is hashed
+     *
+     *  Files already open are read with explicit offsets from their current position,
+     *  which stays where it was. Returns error without a result for any job if the ring
+     *  could not be set up or failed; the caller may run the whole batch again elsewhere.
+     */
+    PIPE_RING ring;
+    PIPE_SLOT rgSlots[HASH_PIPE_DEPTH];
+    void* pbBufs;
+    unsigned nSlots = (nJobs < HASH_PIPE_DEPTH) ? (unsigned) nJobs : HASH_PIPE_DEPTH;
+    unsigned nActive = 0;
+    size_t iNext = 0;
+    int iError;
+
+    if (!Hash_DigestLen(alg)) return EINVAL;
+    if (!nJobs) return 0;
+    if (!IsUringUsable()) return ENOSYS;
+
+    if (posix_memalign(&pbBufs, HASH_IO_ALIGN, (size_t) nSlots * 2 * HASH_PIPE_READ_LEN)) return ENOMEM;
+
+    // Room for a request per slot, plus as many closes
+    iError = RingOpen(&ring, 2 * HASH_PIPE_DEPTH);
+    if (iError) {
+        free(pbBufs);
+        return iError;
+    }
+
+    for (unsigned s = 0; s < nSlots; s++) {
+        rgSlots[s].pJob = NULL;
+        rgSlots[s].rgpbBuf[0] = (uint8_t*) pbBufs + (2 * s + 0) * (size_t) HASH_PIPE_READ_LEN;
+        rgSlots[s].rgpbBuf[1] = (uint8_t*) pbBufs + (2 * s + 1) * (size_t) HASH_PIPE_READ_LEN;
+    }
+
+    while (iNext < nJobs || nActive) {
+        for (unsigned s = 0; s < nSlots && iNext < nJobs; s++) {
+            if (rgSlots[s].pJob) continue;
+            SlotStart(&ring, &rgSlots[s], s, &pJobs[iNext++], hDir, alg, scan);
+            nActive++;
+        }
+
+        if ((iError = RingEnter(&ring, 1))) break;
+        nActive -= RingReap(&ring, rgSlots);
+        if ((iError = RingEnter(&ring, 0))) break;
+
+        for (unsigned s = 0; s < nSlots; s++) {
+            if (!rgSlots[s].cbPending) continue;
+            Hash_Update(&rgSlots[s].ctx, rgSlots[s].pbPending, rgSlots[s].cbPending);
+            rgSlots[s].cbPending = 0;
+        }
+    }
+
+    // Wait for closes
+    while (!iError && ring.nInflight) {
+        if ((iError = RingEnter(&ring, 1))) break;
+        RingReap(&ring, rgSlots);
+    }
+
+    if (iError) {
+        for (unsigned s = 0; s < nSlots; s++)
+            if (rgSlots[s].pJob && rgSlots[s].isOwnFd && rgSlots[s].fd >= 0) close(rgSlots[s].fd);
+    }
+
+    RingClose(&ring);
+    free(pbBufs);
+    return iError;
+}
+
+#endif //HASH_PIPE_URING
+
+
+const char* Hash_PipelineBackend() {
+#ifdef HASH_PIPE_URING
+    if (IsUringUsable()) return "io_uring";
+#endif
+    return "threads";
+}
+
+
+HASH_STATUS Hash_FilePipeline(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hDir, HASH_PIPE_JOB* pJobs, size_t nJobs) {
+    /**
+     * @brief Hash files with many of them in flight: io_uring where available, worker threads otherwise
+     *
+     * @details hDir: directory for relative paths (POSIX, AT_FDCWD for current one). Unused on Windows.
+     *  Status of each file is written to its job. Jobs with a capture buffer and status
+     *  HASH_STATUS_OK are either hashed (isHashed) or read whole into it (cbData bytes)
+     */
+    if (!Hash_DigestLen(alg)) return PIPE_ERROR_PARAM;
+    if (nJobs <= 1) {
+        if (nJobs) PipeRunJob(alg, scan, hDir, pJobs);
+        return HASH_STATUS_OK;
+    }
+
+#ifdef HASH_PIPE_URING
+    if (0 == Hash_FilePipelineUring(alg, scan, hDir, pJobs, nJobs)) return HASH_STATUS_OK;
+#endif
+    return Hash_FilePipelineThreads(alg, scan, hDir, pJobs, nJobs);
+}
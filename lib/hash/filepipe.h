@@ -0,0 +1,73 @@
+#ifndef INTEGRA_FILEPIPE_H
+#define INTEGRA_FILEPIPE_H
+
+/**
+ * Pipelined file hashing: many files opened and read at once, so the device sees a deep
+ * queue instead of one request at a time. Files are hashed as their reads complete.
+ *
+ * Backends:
+ *   io_uring  (Linux)  -  one ring, up to HASH_PIPE_DEPTH files in flight. openat / read / close
+ *                        are queued together and submitted in one system call. Completed
+ *                        buffers are hashed while the next reads are already running
+ *   threads            -  up to HASH_PIPE_THREADS workers, each opening, reading and hashing
+ *                        one file at a time with ordinary blocking calls (Windows, and Linux
+ *                        when io_uring is missing or disabled)
+ *
+ * A job either names a file to open (closed when done) or passes a file already open
+ * (read from its current position and left open). A job with a capture buffer gets file
+ * read whole into it, for the caller to hash several such files in one Hash_Batch().
+ * Only files that do not fit are hashed by the pipeline.
+ *
+ * Files are read in the given scan mode (see filehash.h). With nocache on Windows, files
+ * passed open must be opened unbuffered, and capture buffers must be HASH_IO_ALIGN-aligned
+ * and sized in multiples of it.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hash.h"
+#include "filehash.h"
+
+#ifdef _WIN32
+typedef LPCTSTR HASH_PATH;          // full path
+#define HASH_FILE_NONE  INVALID_HANDLE_VALUE
+#else
+typedef const char* HASH_PATH;      // relative to hDir, or absolute
+#define HASH_FILE_NONE  (-1)
+#endif
+
+#if defined(__linux__) && !defined(_WIN32) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && !defined(HASH_PIPE_NO_URING)
+#define HASH_PIPE_URING
+#endif
+#endif
+
+// Files in flight: io_uring queue depth / worker threads
+#ifndef HASH_PIPE_DEPTH
+#define HASH_PIPE_DEPTH     32
+#endif
+#ifndef HASH_PIPE_THREADS
+#define HASH_PIPE_THREADS   8
+#endif
+// io_uring: each file in flight reads into two buffers of this size, hashing one while the other fills
+#define HASH_PIPE_READ_LEN  (128 * 1024)
+
+typedef struct {
+    HASH_PATH szPath;       // file to open, if hFile is HASH_FILE_NONE
+    HASH_FILE hFile;        // or file already open
+    uint8_t* pbData;        // optional capture buffer, NULL to always hash
+    size_t cbData;          // in: capture buffer size. out: bytes captured
+    uint8_t* pDigest;       // out: HASH_MAX_DIGEST_LEN bytes, written if isHashed
+    int isHashed;           // out: 0 if file ended within capture buffer and was not hashed
+    HASH_STATUS status;     // out
+} HASH_PIPE_JOB;
+
+HASH_STATUS Hash_FilePipeline(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hDir, HASH_PIPE_JOB* pJobs, size_t nJobs);
+HASH_STATUS Hash_FilePipelineThreads(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hDir, HASH_PIPE_JOB* pJobs, size_t nJobs);
+#ifdef HASH_PIPE_URING
+HASH_STATUS Hash_FilePipelineUring(HASH_ALG alg, HASH_SCAN scan, HASH_FILE hDir, HASH_PIPE_JOB* pJobs, size_t nJobs);
+#endif
+
+const char* Hash_PipelineBackend();
+
+#endif //INTEGRA_FILEPIPE_H
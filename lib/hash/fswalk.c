@@ -0,0 +1,412 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include "fswalk.h"
+#include "throttle.h"
+
+#ifdef _WIN32
+#include <winternl.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+
+#ifdef _WIN32
+#ifndef FILE_OPEN
+#define FILE_OPEN                       0x00000001
+#endif
+#ifndef FILE_SEQUENTIAL_ONLY
+#define FILE_SEQUENTIAL_ONLY            0x00000004
+#endif
+#ifndef FILE_NO_INTERMEDIATE_BUFFERING
+#define FILE_NO_INTERMEDIATE_BUFFERING  0x00000008
+#endif
+#ifndef FILE_SYNCHRONOUS_IO_NONALERT
+#define FILE_SYNCHRONOUS_IO_NONALERT    0x00000020
+#endif
+#ifndef FILE_OPEN_FOR_BACKUP_INTENT
+#define FILE_OPEN_FOR_BACKUP_INTENT     0x00004000
+#endif
+#ifndef OBJ_CASE_INSENSITIVE
+#define OBJ_CASE_INSENSITIVE            0x00000040
+#endif
+#endif
+
+// Names are converted (Windows) or copied (POSIX other than Linux) into reader: room for longest one.
+// Windows: 255 UTF-16 units, up to 2 bytes each in a multi-byte ANSI code page
+#ifdef _WIN32
+#define DIR_NAME_LEN    (MAX_PATH * 2)
+#elif !defined(__linux__)
+#define DIR_NAME_LEN    sizeof(((struct dirent*) 0)->d_name)
+#endif
+
+
+#if !defined(_WIN32) && defined(__linux__)
+/*
+ *  Entry of getdents64 buffer (not in libc headers)
+ */
+typedef struct {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} LINUX_DIRENT64;
+#endif
+
+
+/*
+ *  Listing of open directory in progress (see Hash_DirRead)
+ */
+struct HASH_DIR_READER {
+    HASH_FILE hDir;
+    int isStarted;
+    int isDone;
+#ifdef _WIN32
+    uint32_t dwVolume;
+    FILE_ID_BOTH_DIR_INFO* pNext;       // next entry in buffer, NULL once it is consumed
+#elif defined(__linux__)
+    size_t ibNext;
+    size_t cbFilled;
+#else
+    DIR* pDir;
+#endif
+    HASH_DIR_ENTRY rgEntries[HASH_DIR_BATCH];
+#ifdef _WIN32
+    char rgszNames[HASH_DIR_BATCH][DIR_NAME_LEN];
+    uint64_t rgqwBuf[HASH_DIR_BUF_LEN / sizeof(uint64_t)];
+#elif defined(__linux__)
+    uint64_t rgqwBuf[HASH_DIR_BUF_LEN / sizeof(uint64_t)];      // names of entries point here
+#else
+    char rgszNames[HASH_DIR_BATCH][DIR_NAME_LEN];
+#endif
+};
+
+
+#ifndef _WIN32
+static int IsDotEntry(const char* szName) {
+    return szName[0] == '.' && (!szName[1] || (szName[1] == '.' && !szName[2]));
+}
+
+
+static void StatToInfo(const struct stat* pSt, HASH_NODE_INFO* pInfo) {
+    pInfo->isDirectory = S_ISDIR(pSt->st_mode);
+    pInfo->cbSize = (uint64_t) pSt->st_size;
+    pInfo->ftWrite = (uint64_t) pSt->st_mtim.tv_sec * 1000000000u + pSt->st_mtim.tv_nsec;
+    pInfo->ftChange = (uint64_t) pSt->st_ctim.tv_sec * 1000000000u + pSt->st_ctim.tv_nsec;
+    pInfo->dwVolume = (uint32_t) pSt->st_dev;
+    pInfo->qwIndex = (uint64_t) pSt->st_ino;
+}
+
+
+static int FillEntryByStat(HASH_FILE hDir, const char* szName, HASH_DIR_ENTRY* pEntry) {
+    /**
+     * @brief Type (and all of info) of entry whose type listing did not give. 0 if it is to be skipped
+     */
+    struct stat st;
+    if (fstatat(hDir, szName, &st, AT_SYMLINK_NOFOLLOW) || S_ISLNK(st.st_mode)) return 0;
+    StatToInfo(&st, &pEntry->info);
+    pEntry->hasInfo = 1;
+    return 1;
+}
+#endif
+
+
+HASH_STATUS Hash_OpenAt(HASH_FILE hDir, const char* szName, HASH_SCAN scan, HASH_FILE* phFile) {
+    /**
+     * @brief Open item of directory by its name, for reading. Directories are opened too
+     *
+     * @details Same access, sharing and scan flags as CreateFile() with FILE_FLAG_BACKUP_SEMANTICS
+     *  and Hash_ScanFileFlags(). Missing item: ERROR_FILE_NOT_FOUND / ENOENT. Waits for budget
+     *  of files/s first, if throttled (see throttle.h)
+     */
+#ifdef _WIN32
+    WCHAR wszName[MAX_PATH];
+    UNICODE_STRING usName;
+    OBJECT_ATTRIBUTES oa;
+    IO_STATUS_BLOCK iosb;
+    NTSTATUS status;
+
+    Hash_ThrottleOpen();
+
+    int cchName = MultiByteToWideChar(CP_ACP, 0, szName, -1, wszName, MAX_PATH);
+    if (cchName <= 1) return ERROR_INVALID_NAME;
+
+    usName.Buffer = wszName;
+    usName.Length = (USHORT) ((cchName - 1) * sizeof(WCHAR));
+    usName.MaximumLength = (USHORT) (cchName * sizeof(WCHAR));
+    InitializeObjectAttributes(&oa, &usName, OBJ_CASE_INSENSITIVE, hDir, NULL);
+
+    status = NtCreateFile(phFile, GENERIC_READ | SYNCHRONIZE, &oa, &iosb, NULL, FILE_ATTRIBUTE_NORMAL,
+                          FILE_SHARE_READ, FILE_OPEN,
+                          FILE_SYNCHRONOUS_IO_NONALERT | FILE_OPEN_FOR_BACKUP_INTENT |
+                          ((scan == HASH_SCAN_NOCACHE) ? FILE_NO_INTERMEDIATE_BUFFERING : FILE_SEQUENTIAL_ONLY),
+                          NULL, 0);
+    if (!NT_SUCCESS(status)) {
+        *phFile = INVALID_HANDLE_VALUE;
+        return RtlNtStatusToDosError(status);
+    }
+    return ERROR_SUCCESS;
+#else
+    (void) scan;
+    Hash_ThrottleOpen();
+    // Non-blocking: a FIFO must not hang the walk. No effect on files and directories
+    int fd = openat(hDir, szName, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+    *phFile = fd;
+    return (fd < 0) ? errno : 0;
+#endif
+}
+
+
+HASH_STATUS Hash_QueryNode(HASH_FILE hFile, HASH_NODE_INFO* pInfo) {
+    /**
+     * @brief Read type, size, times and identity of open item
+     */
+#ifdef _WIN32
+    BY_HANDLE_FILE_INFORMATION bhfi;
+    FILE_BASIC_INFO fbi;
+
+    if (!GetFileInformationByHandle(hFile, &bhfi)) return GetLastError();
+    if (!GetFileInformationByHandleEx(hFile, FileBasicInfo, &fbi, sizeof(fbi))) return GetLastError();
+
+    pInfo->isDirectory = (bhfi.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    pInfo->cbSize = (uint64_t) bhfi.nFileSizeHigh << 32 | bhfi.nFileSizeLow;
+    pInfo->ftWrite = fbi.LastWriteTime.QuadPart;
+    pInfo->ftChange = fbi.ChangeTime.QuadPart;
+    pInfo->dwVolume = bhfi.dwVolumeSerialNumber;
+    pInfo->qwIndex = (uint64_t) bhfi.nFileIndexHigh << 32 | bhfi.nFileIndexLow;
+    return ERROR_SUCCESS;
+#else
+    struct stat st;
+    if (fstat(hFile, &st)) return errno;
+    StatToInfo(&st, pInfo);
+    return 0;
+#endif
+}
+
+
+void Hash_CloseNode(HASH_FILE hFile) {
+#ifdef _WIN32
+    CloseHandle(hFile);
+#else
+    close(hFile);
+#endif
+}
+
+
+
+HASH_DIR_READER* Hash_DirOpen(HASH_FILE hDir) {
+    /**
+     * @brief Start listing of open directory, from its first entry. NULL if out of memory
+     *
+     * @details Directory handle stays open and owned by caller. Listing moves its read position:
+     *  it is not to be listed twice at once
+     */
+    HASH_DIR_READER* pReader = calloc(1, sizeof(HASH_DIR_READER));
+    if (!pReader) return NULL;
+    pReader->hDir = hDir;
+#ifdef _WIN32
+    BY_HANDLE_FILE_INFORMATION bhfi;
+    if (GetFileInformationByHandle(hDir, &bhfi)) pReader->dwVolume = bhfi.dwVolumeSerialNumber;
+#endif
+    return pReader;
+}
+
+
+void Hash_DirClose(HASH_DIR_READER* pReader) {
+#if !defined(_WIN32) && !defined(__linux__)
+    if (pReader && pReader->pDir) closedir(pReader->pDir);
+#endif
+    free(pReader);
+}
+
+
+HASH_STATUS Hash_DirRead(HASH_DIR_READER* pReader, const HASH_DIR_ENTRY** ppEntries, size_t* pnEntries) {
+    /**
+     * @brief Next entries of directory, up to HASH_DIR_BATCH. *pnEntries is 0 once all are read
+     *
+     * @details "." and "..", reparse points and symbolic links are skipped, as snapshot skips them.
+     *  Every other entry is returned, whatever its name: on Windows, characters the ANSI code page
+     *  has no match for come out as '?' (not best fit, which may name another file), so opening it
+     *  fails and is reported. A name that cannot be converted at all fails the listing instead of
+     *  being dropped. Entries and their names are valid until next call
+     */
+    size_t n = 0;
+    *ppEntries = pReader->rgEntries;
+    *pnEntries = 0;
+
+#ifdef _WIN32
+    // UTF-8 code page takes no best fit flag: every name converts as it is
+    DWORD dwFlags = GetACP() == CP_UTF8 ? 0 : WC_NO_BEST_FIT_CHARS;
+    while (!n) {
+        if (!pReader->pNext) {
+            if (pReader->isDone) break;
+            if (!GetFileInformationByHandleEx(pReader->hDir,
+                                              pReader->isStarted ? FileIdBothDirectoryInfo : FileIdBothDirectoryRestartInfo,
+                                              pReader->rgqwBuf, HASH_DIR_BUF_LEN)) {
+                DWORD res = GetLastError();
+                pReader->isDone = 1;
+                if (res == ERROR_NO_MORE_FILES) break;
+                return res;
+            }
+            pReader->isStarted = 1;
+            pReader->pNext = (FILE_ID_BOTH_DIR_INFO*) pReader->rgqwBuf;
+        }
+
+        while (pReader->pNext && n < HASH_DIR_BATCH) {
+            FILE_ID_BOTH_DIR_INFO* pInfo = pReader->pNext;
+            HASH_DIR_ENTRY* pEntry = &pReader->rgEntries[n];
+            char* szName = pReader->rgszNames[n];
+
+            pReader->pNext = pInfo->NextEntryOffset ? (FILE_ID_BOTH_DIR_INFO*) ((uint8_t*) pInfo + pInfo->NextEntryOffset) : NULL;
+
+            int cchName = WideCharToMultiByte(CP_ACP, dwFlags, pInfo->FileName,
+                                              (int) (pInfo->FileNameLength / sizeof(WCHAR)),
+                                              szName, DIR_NAME_LEN - 1, NULL, NULL);
+            if (!cchName) {
+                pReader->isDone = 1;
+                pReader->pNext = NULL;
+                DWORD res = GetLastError();
+                return res ? res : ERROR_INVALID_NAME;
+            }
+            szName[cchName] = '\0';
+            if ((pInfo->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ||
+                0 == strcmp(".", szName) || 0 == strcmp("..", szName))
+                continue;
+
+            pEntry->szName = szName;
+            pEntry->hasInfo = 1;
+            pEntry->info.isDirectory = (pInfo->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+            pEntry->info.cbSize = pInfo->EndOfFile.QuadPart;
+            pEntry->info.ftWrite = pInfo->LastWriteTime.QuadPart;
+            pEntry->info.ftChange = pInfo->ChangeTime.QuadPart;
+            pEntry->info.dwVolume = pReader->dwVolume;
+            pEntry->info.qwIndex = pInfo->FileId.QuadPart;
+            n++;
+        }
+    }
+#elif defined(__linux__)
+    while (!n) {
+        if (pReader->ibNext >= pReader->cbFilled) {
+            if (pReader->isDone) break;
+            if (!pReader->isStarted && lseek(pReader->hDir, 0, SEEK_SET) < 0) return errno;
+            pReader->isStarted = 1;
+
+            long cb = syscall(SYS_getdents64, pReader->hDir, pReader->rgqwBuf, HASH_DIR_BUF_LEN);
+            if (cb <= 0) {
+                pReader->isDone = 1;
+                if (cb == 0) break;
+                return errno;
+            }
+            pReader->cbFilled = (size_t) cb;
+            pReader->ibNext = 0;
+        }
+
+        while (pReader->ibNext < pReader->cbFilled && n < HASH_DIR_BATCH) {
+            LINUX_DIRENT64* pDirent = (LINUX_DIRENT64*) ((uint8_t*) pReader->rgqwBuf + pReader->ibNext);
+            HASH_DIR_ENTRY* pEntry = &pReader->rgEntries[n];
+
+            pReader->ibNext += pDirent->d_reclen;
+            if (IsDotEntry(pDirent->d_name) || pDirent->d_type == DT_LNK) continue;
+
+            pEntry->szName = pDirent->d_name;
+            pEntry->hasInfo = 0;
+            if (pDirent->d_type == DT_UNKNOWN) {
+                if (!FillEntryByStat(pReader->hDir, pDirent->d_name, pEntry)) continue;
+            }
+            else pEntry->info.isDirectory = (pDirent->d_type == DT_DIR);
+            n++;
+        }
+    }
+#else
+    if (!pReader->isStarted) {
+        int fd = dup(pReader->hDir);
+        pReader->isStarted = 1;
+        if (fd < 0) return errno;
+        pReader->pDir = fdopendir(fd);
+        if (!pReader->pDir) {
+            int res = errno;
+            close(fd);
+            return res;
+        }
+        rewinddir(pReader->pDir);
+    }
+    while (pReader->pDir && n < HASH_DIR_BATCH) {
+        struct dirent* pDirent = readdir(pReader->pDir);
+        HASH_DIR_ENTRY* pEntry = &pReader->rgEntries[n];
+        if (!pDirent) break;
+        if (IsDotEntry(pDirent->d_name)) continue;
+
+        strcpy(pReader->rgszNames[n], pDirent->d_name);
+        pEntry->szName = pReader->rgszNames[n];
+        if (!FillEntryByStat(pReader->hDir, pEntry->szName, pEntry)) continue;
+        n++;
+    }
+#endif
+
+    *pnEntries = n;
+    return HASH_STATUS_OK;
+}
+
+
+static int PathReserve(HASH_PATH_BUF* pPath, size_t cchNeeded) {
+    if (cchNeeded <= pPath->cchAlloc) return 1;
+    size_t cchAlloc = pPath->cchAlloc ? pPath->cchAlloc : 256;
+    while (cchAlloc < cchNeeded) cchAlloc *= 2;
+    char* szPath = realloc(pPath->szPath, cchAlloc);
+    if (!szPath) return 0;
+    pPath->szPath = szPath;
+    pPath->cchAlloc = cchAlloc;
+    return 1;
+}
+
+
+int Hash_PathInit(HASH_PATH_BUF* pPath, const char* szBase) {
+    /**
+     * @brief Start path at szBase (copied). 0 if out of memory
+     */
+    size_t cchBase = strlen(szBase);
+    pPath->szPath = NULL;
+    pPath->cchPath = pPath->cchAlloc = 0;
+    if (!PathReserve(pPath, cchBase + 1)) return 0;
+    memcpy(pPath->szPath, szBase, cchBase + 1);
+    pPath->cchPath = cchBase;
+    return 1;
+}
+
+
+int Hash_PathPush(HASH_PATH_BUF* pPath, const char* szName) {
+    /**
+     * @brief Append separator and name. 0 if out of memory (path unchanged)
+     *
+     * @details Caller saves cchPath before, to truncate back to it with Hash_PathPop()
+     */
+    size_t cchName = strlen(szName);
+    if (!PathReserve(pPath, pPath->cchPath + cchName + 2)) return 0;
+    pPath->szPath[pPath->cchPath] = HASH_PATH_SEP;
+    memcpy(pPath->szPath + pPath->cchPath + 1, szName, cchName + 1);
+    pPath->cchPath += cchName + 1;
+    return 1;
+}
+
+
+void Hash_PathPop(HASH_PATH_BUF* pPath, size_t cchMark) {
+    pPath->cchPath = cchMark;
+    pPath->szPath[cchMark] = '\0';
+}
+
+
+void Hash_PathFree(HASH_PATH_BUF* pPath) {
+    free(pPath->szPath);
+    pPath->szPath = NULL;
+    pPath->cchPath = pPath->cchAlloc = 0;
+}
@@ -0,0 +1,85 @@
+#ifndef INTEGRA_FSWALK_H
+#define INTEGRA_FSWALK_H
+
+/**
+ * File tree traversal relative to directory handles: an item is opened by its name under an
+ * open parent (Windows: NtCreateFile with RootDirectory, POSIX: openat), and its type, size,
+ * times and identity are read from the open handle. No full path is built or resolved per item,
+ * so each one costs an open and a query, and nothing the file system has to walk again.
+ *
+ *  Windows:  NtCreateFile + GetFileInformationByHandle + GetFileInformationByHandleEx(FileBasicInfo)
+ *  POSIX:    openat + fstat
+ *
+ * Directories are listed in bulk, HASH_DIR_BUF_LEN of entries per call, each entry with its
+ * type (and on Windows size, times and file index too), so nothing is queried per entry:
+ *
+ *  Windows:  GetFileInformationByHandleEx(FileIdBothDirectoryInfo) on the open directory
+ *  Linux:    getdents64, type from d_type (fstatat only if file system leaves it unknown)
+ *
+ * Paths are kept for reports only, so they have no length limit: a walk keeps one HASH_PATH_BUF,
+ * appends a name when it goes down a level and truncates it back when it comes up (see Hash_PathPush),
+ * so each level costs the length of its own name, and the buffer grows (doubling) only on new depth.
+ *
+ * Times are FILETIME (100 ns since 1601) on Windows, nanoseconds since 1970 on POSIX: they are
+ * only compared with times read on the same system.
+ */
+
+#include <stdint.h>
+#include "filehash.h"
+
+// One listing read, in bytes
+#ifndef HASH_DIR_BUF_LEN
+#define HASH_DIR_BUF_LEN    (64 * 1024)
+#endif
+
+// Entries returned by one Hash_DirRead(), at most
+#ifndef HASH_DIR_BATCH
+#define HASH_DIR_BATCH      256
+#endif
+
+typedef struct {
+    int isDirectory;
+    uint64_t cbSize;
+    uint64_t ftWrite;       // modification time
+    uint64_t ftChange;      // change time: also moves on attribute, ACL and rename changes
+    uint32_t dwVolume;      // file identity: volume serial (device) and file index (inode)
+    uint64_t qwIndex;
+} HASH_NODE_INFO;
+
+typedef struct {
+    const char* szName;     // valid until next Hash_DirRead()
+    int hasInfo;            // all of info is set. Otherwise only isDirectory (POSIX)
+    HASH_NODE_INFO info;
+} HASH_DIR_ENTRY;
+
+typedef struct HASH_DIR_READER HASH_DIR_READER;
+
+#ifdef _WIN32
+#define HASH_PATH_SEP   '\\'
+#else
+#define HASH_PATH_SEP   '/'
+#endif
+
+/*
+ *  Path of item being walked: one buffer, names appended and truncated stack-wise
+ */
+typedef struct {
+    char* szPath;
+    size_t cchPath;
+    size_t cchAlloc;
+} HASH_PATH_BUF;
+
+HASH_STATUS Hash_OpenAt(HASH_FILE hDir, const char* szName, HASH_SCAN scan, HASH_FILE* phFile);
+HASH_STATUS Hash_QueryNode(HASH_FILE hFile, HASH_NODE_INFO* pInfo);
+void Hash_CloseNode(HASH_FILE hFile);
+
+HASH_DIR_READER* Hash_DirOpen(HASH_FILE hDir);
+HASH_STATUS Hash_DirRead(HASH_DIR_READER* pReader, const HASH_DIR_ENTRY** ppEntries, size_t* pnEntries);
+void Hash_DirClose(HASH_DIR_READER* pReader);
+
+int Hash_PathInit(HASH_PATH_BUF* pPath, const char* szBase);
+int Hash_PathPush(HASH_PATH_BUF* pPath, const char* szName);
+void Hash_PathPop(HASH_PATH_BUF* pPath, size_t cchMark);
+void Hash_PathFree(HASH_PATH_BUF* pPath);
+
+#endif //INTEGRA_FSWALK_H
@@ -0,0 +1,249 @@
+#include <ctype.h>
+#include <string.h>
+#include "hash.h"
+
+
+static const HASH_PROVIDER rgProviders[HASH_ALG_COUNT] = {
+    { HASH_MD5,      "md5",      MD5_DIGEST_LEN,    1 },
+    { HASH_SHA256,   "sha256",   SHA256_DIGEST_LEN, 1 },
+    { HASH_XXH3_128, "xxh3-128", XXH3_DIGEST_LEN,   0 },
+    { HASH_BLAKE3,   "blake3",   BLAKE3_DIGEST_LEN, 1 },
+};
+
+
+const HASH_PROVIDER* Hash_GetProvider(HASH_ALG alg) {
+    if ((unsigned) alg >= HASH_ALG_COUNT) return NULL;
+    return &rgProviders[alg];
+}
+
+
+const HASH_PROVIDER* Hash_FindProvider(const char* szName) {
+    /**
+     * @brief Look up provider by its Object List name (case-insensitive). NULL if unknown
+     */
+    for (int i = 0; i < HASH_ALG_COUNT; i++) {
+        const char* a = rgProviders[i].szName;
+        const char* b = szName;
+        while (*a && *a == tolower((unsigned char) *b)) { a++; b++; }
+        if (!*a && !*b) return &rgProviders[i];
+    }
+    return NULL;
+}
+
+
+size_t Hash_DigestLen(HASH_ALG alg) {
+    const HASH_PROVIDER* pProvider = Hash_GetProvider(alg);
+    return pProvider ? pProvider->cbDigest : 0;
+}
+
+
+const char* Hash_KernelName(HASH_ALG alg) {
+    /**
+     * @brief Name of implementation picked for this CPU (e.g. "sha-ni", "avx512")
+     */
+    switch (alg) {
+        case HASH_MD5:      return MD5MB_KernelName();
+        case HASH_SHA256:   return SHA256_KernelName();
+        case HASH_XXH3_128:
+        case HASH_BLAKE3:   return "portable";
+        default:            return NULL;
+    }
+}
+
+
+int Hash_Init(HASH_CTX* ctx, HASH_ALG alg) {
+    /**
+     * @brief Set up context for algorithm. Returns 0 if algorithm is unknown
+     */
+    ctx->pProvider = Hash_GetProvider(alg);
+    if (!ctx->pProvider) return 0;
+
+    switch (alg) {
+        case HASH_MD5:      MD5_Init(&ctx->u.md5);       break;
+        case HASH_SHA256:   SHA256_Init(&ctx->u.sha256); break;
+        case HASH_XXH3_128: XXH3_Init(&ctx->u.xxh3);     break;
+        case HASH_BLAKE3:   BLAKE3_Init(&ctx->u.blake3); break;
+        default:            return 0;
+    }
+    return 1;
+}
+
+
+void Hash_Update(HASH_CTX* ctx, const void* pData, size_t cbData) {
+    switch (ctx->pProvider->alg) {
+        case HASH_MD5:      MD5_Update(&ctx->u.md5, pData, cbData);       break;
+        case HASH_SHA256:   SHA256_Update(&ctx->u.sha256, pData, cbData); break;
+        case HASH_XXH3_128: XXH3_Update(&ctx->u.xxh3, pData, cbData);     break;
+        case HASH_BLAKE3:   BLAKE3_Update(&ctx->u.blake3, pData, cbData); break;
+        default:            break;
+    }
+}
+
+
+void Hash_Final(HASH_CTX* ctx, uint8_t* pDigest) {
+    /**
+     * @brief Write digest (provider's cbDigest bytes). Safe with pDigest pointing into hashed data
+     */
+    switch (ctx->pProvider->alg) {
+        case HASH_MD5:      MD5_Final(&ctx->u.md5, pDigest);       break;
+        case HASH_SHA256:   SHA256_Final(&ctx->u.sha256, pDigest); break;
+        case HASH_XXH3_128: XXH3_Final(&ctx->u.xxh3, pDigest);     break;
+        case HASH_BLAKE3:   BLAKE3_Final(&ctx->u.blake3, pDigest); break;
+        default:            break;
+    }
+}
+
+
+int Hash_Digest(HASH_ALG alg, const void* pData, size_t cbData, uint8_t* pDigest) {
+    /**
+     * @brief One-shot digest of memory buffer
+     */
+    HASH_CTX ctx;
+    if (!Hash_Init(&ctx, alg)) return 0;
+    Hash_Update(&ctx, pData, cbData);
+    Hash_Final(&ctx, pDigest);
+    return 1;
+}
+
+
+int Hash_Batch(HASH_ALG alg, HASH_JOB* pJobs, size_t nJobs) {
+    /**
+     * @brief Digest of every job. MD5 goes through the multi-buffer kernel, others one by one
+     */
+    if (!Hash_GetProvider(alg)) return 0;
+
+    if (alg == HASH_MD5) {
+        MD5_HashBatch(pJobs, nJobs);
+        return 1;
+    }
+
+    for (size_t i = 0; i < nJobs; i++)
+        Hash_Digest(alg, pJobs[i].pData, pJobs[i].cbData, pJobs[i].pDigest);
+    return 1;
+}
+
+
+void Hash_ToHex(const uint8_t* pDigest, size_t cbDigest, char* szHex) {
+    /**
+     * @brief Lowercase hex, NUL-terminated. szHex must hold cbDigest*2 + 1 chars
+     */
+    static const char rgDigits[] = "0123456789abcdef";
+    for (size_t i = 0; i < cbDigest; i++) {
+        szHex[2*i]     = rgDigits[pDigest[i] >> 4];
+        szHex[2*i + 1] = rgDigits[pDigest[i] & 0xf];
+    }
+    szHex[2*cbDigest] = '\0';
+}
+
+
+// Object List names, by HASH_ENCODING
+static const char* const rgszEncodingNames[HASH_ENC_COUNT] = {"hex", "base64"};
+static const char rgBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+const char* Hash_EncodingName(HASH_ENCODING enc) {
+    return ((unsigned) enc < HASH_ENC_COUNT) ? rgszEncodingNames[enc] : NULL;
+}
+
+
+int Hash_FindEncoding(const char* szName, HASH_ENCODING* pEnc) {
+    /**
+     * @brief Look up digest encoding by its Object List name (case-insensitive). 0 if unknown
+     */
+    for (int i = 0; i < HASH_ENC_COUNT; i++) {
+        const char* a = rgszEncodingNames[i];
+        const char* b = szName;
+        while (*a && *a == tolower((unsigned char) *b)) { a++; b++; }
+        if (!*a && !*b) {
+            *pEnc = (HASH_ENCODING) i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+void Hash_Encode(const HASH_DIGEST* pDigest, size_t cbDigest, HASH_ENCODING enc, char* szText) {
+    /**
+     * @brief Text form of digest, NUL-terminated. szText must hold HASH_TEXT_BUF_LEN chars
+     */
+    const uint8_t* pb = pDigest->b;
+    size_t i;
+
+    if (enc != HASH_ENC_BASE64) {
+        Hash_ToHex(pb, cbDigest, szText);
+        return;
+    }
+
+    for (i = 0; i + 3 <= cbDigest; i += 3) {
+        uint32_t v = (uint32_t) pb[i] << 16 | (uint32_t) pb[i+1] << 8 | pb[i+2];
+        *szText++ = rgBase64[v >> 18];
+        *szText++ = rgBase64[(v >> 12) & 0x3f];
+        *szText++ = rgBase64[(v >> 6) & 0x3f];
+        *szText++ = rgBase64[v & 0x3f];
+    }
+    if (cbDigest - i == 1) {
+        *szText++ = rgBase64[pb[i] >> 2];
+        *szText++ = rgBase64[(pb[i] & 0x03) << 4];
+    }
+    else if (cbDigest - i == 2) {
+        uint32_t v = (uint32_t) pb[i] << 8 | pb[i+1];
+        *szText++ = rgBase64[v >> 10];
+        *szText++ = rgBase64[(v >> 4) & 0x3f];
+        *szText++ = rgBase64[(v & 0x0f) << 2];
+    }
+    *szText = '\0';
+}
+
+
+static int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = (char) tolower((unsigned char) c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+
+static int Base64Value(char c) {
+    const char* p = (c != '\0') ? strchr(rgBase64, c) : NULL;
+    return p ? (int) (p - rgBase64) : -1;
+}
+
+
+int Hash_Decode(const char* szText, size_t cbDigest, HASH_DIGEST* pDigest) {
+    /**
+     * @brief Parse text form of cbDigest-byte digest. Encoding is told by length, so
+     * hex and base64 (padded or not) are both accepted. 0 if malformed
+     */
+    size_t cch = strlen(szText);
+
+    memset(pDigest, 0, sizeof(*pDigest));
+    if (cbDigest > HASH_MAX_DIGEST_LEN) return 0;
+
+    if (cch == cbDigest * 2) {
+        for (size_t i = 0; i < cbDigest; i++) {
+            int hi = HexValue(szText[2*i]), lo = HexValue(szText[2*i + 1]);
+            if (hi < 0 || lo < 0) return 0;
+            pDigest->b[i] = (uint8_t) (hi << 4 | lo);
+        }
+        return 1;
+    }
+
+    while (cch && szText[cch - 1] == '=') cch--;
+    if (cch != (cbDigest * 4 + 2) / 3) return 0;
+
+    uint32_t v = 0;
+    size_t nBits = 0, iOut = 0;
+    for (size_t i = 0; i < cch; i++) {
+        int d = Base64Value(szText[i]);
+        if (d < 0) return 0;
+        v = (v << 6) | (uint32_t) d;
+        nBits += 6;
+        if (nBits >= 8) {
+            nBits -= 8;
+            pDigest->b[iOut++] = (uint8_t) (v >> nBits);
+        }
+    }
+    // Leftover bits must be zero, so each digest has one text form
+    return iOut == cbDigest && !(v & ((1u << nBits) - 1));
+}
@@ -0,0 +1,100 @@
+#ifndef INTEGRA_HASH_H
+#define INTEGRA_HASH_H
+
+/**
+ * Hash provider interface: one init / update / final API over every supported algorithm.
+ *
+ * Algorithm is recorded per HashTree ("algorithm" in Object List), by name.
+ * Objects without the tag were made before providers existed and use MD5.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "md5core.h"
+#include "md5mb.h"
+#include "sha256.h"
+#include "xxh3.h"
+#include "blake3.h"
+
+typedef enum {
+    HASH_MD5 = 0,
+    HASH_SHA256,
+    HASH_XXH3_128,
+    HASH_BLAKE3,
+    HASH_ALG_COUNT
+} HASH_ALG;
+
+#define HASH_DEFAULT_ALG        HASH_MD5
+#define HASH_MAX_DIGEST_LEN     32
+#define HASH_MAX_HEX_LEN        (HASH_MAX_DIGEST_LEN * 2)
+// Longest text form of a digest (hex), with NUL
+#define HASH_TEXT_BUF_LEN       (HASH_MAX_HEX_LEN + 1)
+
+/*
+ *  Digests are kept raw, in fixed-width words, and compared as such.
+ *  Text forms exist only in Object List and messages. Unused tail is zero
+ */
+typedef union {
+    uint8_t b[HASH_MAX_DIGEST_LEN];
+    uint64_t q[HASH_MAX_DIGEST_LEN / sizeof(uint64_t)];
+} HASH_DIGEST;
+
+// Text form of digests in Object List ("encoding" in HashTree)
+typedef enum {
+    HASH_ENC_HEX = 0,
+    HASH_ENC_BASE64,            // RFC 4648 alphabet, no padding: 22 chars for 128-bit digests, 43 for 256-bit
+    HASH_ENC_COUNT
+} HASH_ENCODING;
+
+#define HASH_DEFAULT_ENCODING   HASH_ENC_HEX
+
+typedef struct {
+    HASH_ALG alg;
+    const char* szName;         // as stored in Object List
+    size_t cbDigest;
+    int isCryptographic;        // collision resistant, suitable against deliberate tampering
+} HASH_PROVIDER;
+
+typedef struct {
+    const HASH_PROVIDER* pProvider;
+    union {
+        MD5_CTX md5;
+        SHA256_CTX sha256;
+        XXH3_CTX xxh3;
+        BLAKE3_CTX blake3;
+    } u;
+} HASH_CTX;
+
+// Same layout for every algorithm; pDigest must hold provider's cbDigest bytes
+typedef MD5_JOB HASH_JOB;
+
+const HASH_PROVIDER* Hash_GetProvider(HASH_ALG alg);
+const HASH_PROVIDER* Hash_FindProvider(const char* szName);
+size_t Hash_DigestLen(HASH_ALG alg);
+const char* Hash_KernelName(HASH_ALG alg);
+
+int Hash_Init(HASH_CTX* ctx, HASH_ALG alg);
+void Hash_Update(HASH_CTX* ctx, const void* pData, size_t cbData);
+void Hash_Final(HASH_CTX* ctx, uint8_t* pDigest);
+
+int Hash_Digest(HASH_ALG alg, const void* pData, size_t cbData, uint8_t* pDigest);
+int Hash_Batch(HASH_ALG alg, HASH_JOB* pJobs, size_t nJobs);
+
+void Hash_ToHex(const uint8_t* pDigest, size_t cbDigest, char* szHex);
+
+const char* Hash_EncodingName(HASH_ENCODING enc);
+int Hash_FindEncoding(const char* szName, HASH_ENCODING* pEnc);
+void Hash_Encode(const HASH_DIGEST* pDigest, size_t cbDigest, HASH_ENCODING enc, char* szText);
+int Hash_Decode(const char* szText, size_t cbDigest, HASH_DIGEST* pDigest);
+
+static inline int Hash_Equal(const HASH_DIGEST* a, const HASH_DIGEST* b, size_t cbDigest) {
+    /**
+     * @brief Compare digests word by word. Every digest length is a multiple of 8 bytes
+     */
+    uint64_t diff = 0;
+    for (size_t i = 0; i < cbDigest / sizeof(uint64_t); i++)
+        diff |= a->q[i] ^ b->q[i];
+    return !diff;
+}
+
+#endif //INTEGRA_HASH_H
@@ -0,0 +1,304 @@
+#include <string.h>
+#include "sha256.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_X86
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define SHA256_ARM
+#include <arm_neon.h>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+
+typedef void (*SHA256_KERNEL)(uint32_t state[8], const uint8_t* pBlocks, size_t nBlocks);
+
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define CH(x, y, z)  ((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+#define S0(x) (ROTR((x),  2) ^ ROTR((x), 13) ^ ROTR((x), 22))
+#define S1(x) (ROTR((x),  6) ^ ROTR((x), 11) ^ ROTR((x), 25))
+#define s0(x) (ROTR((x),  7) ^ ROTR((x), 18) ^ ((x) >>  3))
+#define s1(x) (ROTR((x), 17) ^ ROTR((x), 19) ^ ((x) >> 10))
+
+
+static uint32_t LoadBE32(const uint8_t* p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+
+static void StoreBE32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+}
+
+
+static void SHA256_TransformPortable(uint32_t state[8], const uint8_t* pBlocks, size_t nBlocks) {
+    /**
+     * @brief Run SHA-256 compression over nBlocks consecutive 64-byte blocks
+     */
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
+
+    while (nBlocks--) {
+        for (int i = 0; i < 16; i++)
+            w[i] = LoadBE32(pBlocks + 4*i);
+        for (int i = 16; i < 64; i++)
+            w[i] = s1(w[i-2]) + w[i-7] + s0(w[i-15]) + w[i-16];
+
+        a = state[0]; b = state[1]; c = state[2]; d = state[3];
+        e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+        for (int i = 0; i < 64; i++) {
+            t1 = h + S1(e) + CH(e, f, g) + K[i] + w[i];
+            t2 = S0(a) + MAJ(a, b, c);
+            h = g; g = f; f = e;
+            e = d + t1;
+            d = c; c = b; b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+        pBlocks += SHA256_BLOCK_LEN;
+    }
+}
+
+
+#ifdef SHA256_X86
+
+__attribute__((target("sha,sse4.1")))
+static void SHA256_TransformSHANI(uint32_t state[8], const uint8_t* pBlocks, size_t nBlocks) {
+    /**
+     * @brief SHA-256 compression with Intel SHA extensions
+     *
+     * @details SHA-NI keeps state as ABEF / CDGH and does two rounds per sha256rnds2.
+     *  Message schedule runs in a ring of 4 vectors: W[i] from W[i-4..i-1]
+     */
+    const __m128i BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0, state1, abefSave, cdghSave, msg, tmp;
+    __m128i w[4];
+
+    // ABCD, EFGH -> ABEF, CDGH
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*) &state[0]), 0xB1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*) &state[4]), 0x1B);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (nBlocks--) {
+        abefSave = state0;
+        cdghSave = state1;
+
+        for (int i = 0; i < 16; i++) {
+            if (i < 4)
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (pBlocks + 16*i)), BSWAP);
+            else {
+                tmp = _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4);
+                w[i & 3] = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+                w[i & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(w[i & 3], tmp), w[(i + 3) & 3]);
+            }
+
+            msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i*) &K[4*i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+        pBlocks += SHA256_BLOCK_LEN;
+    }
+
+    // ABEF, CDGH -> ABCD, EFGH
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128((__m128i*) &state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128((__m128i*) &state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+#endif //SHA256_X86
+
+
+#ifdef SHA256_ARM
+
+__attribute__((target("+crypto")))
+static void SHA256_TransformARMv8(uint32_t state[8], const uint8_t* pBlocks, size_t nBlocks) {
+    /**
+     * @brief SHA-256 compression with ARMv8 cryptography extensions, four rounds per sha256h/h2
+     */
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+    uint32x4_t abcdSave, efghSave, msg, tmp;
+    uint32x4_t w[4];
+
+    while (nBlocks--) {
+        abcdSave = state0;
+        efghSave = state1;
+
+        for (int i = 0; i < 16; i++) {
+            if (i < 4)
+                w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(pBlocks + 16*i)));
+            else
+                w[i & 3] = vsha256su1q_u32(vsha256su0q_u32(w[i & 3], w[(i + 1) & 3]),
+                                           w[(i + 2) & 3], w[(i + 3) & 3]);
+
+            msg = vaddq_u32(w[i & 3], vld1q_u32(&K[4*i]));
+            tmp = state0;
+            state0 = vsha256hq_u32(state0, state1, msg);
+            state1 = vsha256h2q_u32(state1, tmp, msg);
+        }
+
+        state0 = vaddq_u32(state0, abcdSave);
+        state1 = vaddq_u32(state1, efghSave);
+        pBlocks += SHA256_BLOCK_LEN;
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+
+static int HasARMv8Sha2() {
+#if defined(_WIN32)
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE);
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#elif defined(__APPLE__)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#endif //SHA256_ARM
+
+
+static SHA256_KERNEL pfnKernel = NULL;
+static const char* szKernelName = NULL;
+
+
+static void SelectKernel() {
+    /**
+     * @brief Pick hardware SHA-256 if CPU has it, portable code otherwise. Racing callers pick the same one
+     */
+    SHA256_KERNEL pfn = SHA256_TransformPortable;
+    const char* name = "portable";
+
+#if defined(SHA256_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")) { pfn = SHA256_TransformSHANI; name = "sha-ni"; }
+#elif defined(SHA256_ARM)
+    if (HasARMv8Sha2()) { pfn = SHA256_TransformARMv8; name = "armv8-sha2"; }
+#endif
+
+    szKernelName = name;
+    pfnKernel = pfn;
+}
+
+
+static void SHA256_Transform(uint32_t state[8], const uint8_t* pBlocks, size_t nBlocks) {
+    if (!pfnKernel) SelectKernel();
+    pfnKernel(state, pBlocks, nBlocks);
+}
+
+
+const char* SHA256_KernelName() {
+    if (!pfnKernel) SelectKernel();
+    return szKernelName;
+}
+
+
+void SHA256_Init(SHA256_CTX* ctx) {
+    ctx->state[0] = 0x6a09e667;
+    ctx->state[1] = 0xbb67ae85;
+    ctx->state[2] = 0x3c6ef372;
+    ctx->state[3] = 0xa54ff53a;
+    ctx->state[4] = 0x510e527f;
+    ctx->state[5] = 0x9b05688c;
+    ctx->state[6] = 0x1f83d9ab;
+    ctx->state[7] = 0x5be0cd19;
+    ctx->cbTotal = 0;
+}
+
+
+void SHA256_Update(SHA256_CTX* ctx, const void* pData, size_t cbData) {
+    /**
+     * @brief Feed bytes to context. Full blocks are compressed straight from caller's buffer
+     */
+    const uint8_t* p = pData;
+    size_t cbPending = ctx->cbTotal % SHA256_BLOCK_LEN;
+
+    ctx->cbTotal += cbData;
+
+    if (cbPending) {
+        size_t cbFill = SHA256_BLOCK_LEN - cbPending;
+        if (cbData < cbFill) {
+            memcpy(ctx->buffer + cbPending, p, cbData);
+            return;
+        }
+        memcpy(ctx->buffer + cbPending, p, cbFill);
+        SHA256_Transform(ctx->state, ctx->buffer, 1);
+        p += cbFill;
+        cbData -= cbFill;
+    }
+
+    if (cbData >= SHA256_BLOCK_LEN) {
+        SHA256_Transform(ctx->state, p, cbData / SHA256_BLOCK_LEN);
+        p += cbData & ~(size_t) (SHA256_BLOCK_LEN - 1);
+        cbData %= SHA256_BLOCK_LEN;
+    }
+
+    if (cbData) memcpy(ctx->buffer, p, cbData);
+}
+
+
+void SHA256_Final(SHA256_CTX* ctx, uint8_t digest[SHA256_DIGEST_LEN]) {
+    /**
+     * @brief Append padding and big-endian length, write digest
+     */
+    size_t cbPending = ctx->cbTotal % SHA256_BLOCK_LEN;
+    uint64_t cBits = ctx->cbTotal << 3;
+
+    ctx->buffer[cbPending++] = 0x80;
+    if (cbPending > SHA256_BLOCK_LEN - 8) {
+        memset(ctx->buffer + cbPending, 0, SHA256_BLOCK_LEN - cbPending);
+        SHA256_Transform(ctx->state, ctx->buffer, 1);
+        cbPending = 0;
+    }
+    memset(ctx->buffer + cbPending, 0, SHA256_BLOCK_LEN - 8 - cbPending);
+
+    StoreBE32(ctx->buffer + SHA256_BLOCK_LEN - 8, (uint32_t) (cBits >> 32));
+    StoreBE32(ctx->buffer + SHA256_BLOCK_LEN - 4, (uint32_t) cBits);
+    SHA256_Transform(ctx->state, ctx->buffer, 1);
+
+    for (int i = 0; i < 8; i++)
+        StoreBE32(digest + 4*i, ctx->state[i]);
+}
+
+
+void SHA256_Digest(const void* pData, size_t cbData, uint8_t digest[SHA256_DIGEST_LEN]) {
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, pData, cbData);
+    SHA256_Final(&ctx, digest);
+}
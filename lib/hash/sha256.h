@@ -0,0 +1,32 @@
+#ifndef INTEGRA_SHA256_H
+#define INTEGRA_SHA256_H
+
+/**
+ * SHA-256 (FIPS 180-4).
+ *
+ * Compression is picked at first use: Intel SHA extensions (SHA-NI) or ARMv8
+ * cryptography extensions when the CPU has them, portable C otherwise.
+ * Every kernel gives the same digest.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_LEN   32
+#define SHA256_BLOCK_LEN    64
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t cbTotal;
+    uint8_t  buffer[SHA256_BLOCK_LEN];
+} SHA256_CTX;
+
+void SHA256_Init(SHA256_CTX* ctx);
+void SHA256_Update(SHA256_CTX* ctx, const void* pData, size_t cbData);
+void SHA256_Final(SHA256_CTX* ctx, uint8_t digest[SHA256_DIGEST_LEN]);
+
+void SHA256_Digest(const void* pData, size_t cbData, uint8_t digest[SHA256_DIGEST_LEN]);
+
+const char* SHA256_KernelName();
+
+#endif //INTEGRA_SHA256_H
@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "taskpool.h"
+
+#ifdef _WIN32
+#define POOL_LOCK               CRITICAL_SECTION
+#define POOL_COND               CONDITION_VARIABLE
+#define PoolLockInit(p)         InitializeCriticalSection(p)
+#define PoolLockFree(p)         DeleteCriticalSection(p)
+#define PoolLock(p)             EnterCriticalSection(p)
+#define PoolUnlock(p)           LeaveCriticalSection(p)
+#define PoolCondInit(p)         InitializeConditionVariable(p)
+#define PoolCondFree(p)         ((void) (p))
+#define PoolCondWait(c, l)      SleepConditionVariableCS(c, l, INFINITE)
+#define PoolCondSignal(p)       WakeConditionVariable(p)
+#define PoolCondBroadcast(p)    WakeAllConditionVariable(p)
+#define POOL_ERROR_MEMORY       ERROR_NOT_ENOUGH_MEMORY
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#define POOL_LOCK               pthread_mutex_t
+#define POOL_COND               pthread_cond_t
+#define PoolLockInit(p)         pthread_mutex_init(p, NULL)
+#define PoolLockFree(p)         pthread_mutex_destroy(p)
+#define PoolLock(p)             pthread_mutex_lock(p)
+#define PoolUnlock(p)           pthread_mutex_unlock(p)
+#define PoolCondInit(p)         pthread_cond_init(p, NULL)
+#define PoolCondFree(p)         pthread_cond_destroy(p)
+#define PoolCondWait(c, l)      pthread_cond_wait(c, l)
+#define PoolCondSignal(p)       pthread_cond_signal(p)
+#define PoolCondBroadcast(p)    pthread_cond_broadcast(p)
+#define POOL_ERROR_MEMORY       ENOMEM
+#endif
+
+// First capacity of each deque, doubled as needed
+#define POOL_DEQUE_LEN  64
+
+
+/*
+ *  Tasks of one worker: ring buffer, owner works at tail, thieves at head
+ */
+typedef struct {
+    void** ppTasks;
+    size_t nAlloc;
+    size_t iHead;
+    size_t nTasks;
+    POOL_LOCK lock;
+} POOL_DEQUE;
+
+typedef struct HASH_POOL HASH_POOL;
+
+struct HASH_WORKER {
+    HASH_POOL* pPool;
+    size_t iWorker;
+    POOL_DEQUE deque;
+};
+
+struct HASH_POOL {
+    HASH_TASK_FN pfnTask;
+    void* pArg;
+    size_t nWorkers;
+    HASH_WORKER rgWorkers[HASH_POOL_MAX_THREADS];
+    atomic_size_t nQueued;      // in deques. Counted before push and after pop: never below actual
+    atomic_size_t nPending;     // queued or running
+    atomic_size_t nSleeping;
+    POOL_LOCK lockIdle;
+    POOL_COND condIdle;
+};
+
+
+static int DequePush(POOL_DEQUE* pDeque, void* pTask) {
+    /**
+     * @brief Add task at tail. Ring grows twice when full. 0 if out of memory
+     */
+    PoolLock(&pDeque->lock);
+    if (pDeque->nTasks == pDeque->nAlloc) {
+        size_t nAlloc = pDeque->nAlloc ? pDeque->nAlloc * 2 : POOL_DEQUE_LEN;
+        void** ppTasks = malloc(nAlloc * sizeof(void*));
+        if (!ppTasks) {
+            PoolUnlock(&pDeque->lock);
+            return 0;
+        }
+        for (size_t i = 0; i < pDeque->nTasks; i++)
+            ppTasks[i] = pDeque->ppTasks[(pDeque->iHead + i) % pDeque->nAlloc];
+        free(pDeque->ppTasks);
+        pDeque->ppTasks = ppTasks;
+        pDeque->nAlloc = nAlloc;
+        pDeque->iHead = 0;
+    }
+    pDeque->ppTasks[(pDeque->iHead + pDeque->nTasks) % pDeque->nAlloc] = pTask;
+    pDeque->nTasks++;
+    PoolUnlock(&pDeque->lock);
+    return 1;
+}
+
+
+static void* DequePopTail(POOL_DEQUE* pDeque) {
+    void* pTask = NULL;
+    PoolLock(&pDeque->lock);
+    if (pDeque->nTasks) {
+        pDeque->nTasks--;
+        pTask = pDeque->ppTasks[(pDeque->iHead + pDeque->nTasks) % pDeque->nAlloc];
+    }
+    PoolUnlock(&pDeque->lock);
+    return pTask;
+}
+
+
+static void* DequePopHead(POOL_DEQUE* pDeque) {
+    void* pTask = NULL;
+    PoolLock(&pDeque->lock);
+    if (pDeque->nTasks) {
+        pTask = pDeque->ppTasks[pDeque->iHead];
+        pDeque->iHead = (pDeque->iHead + 1) % pDeque->nAlloc;
+        pDeque->nTasks--;
+    }
+    PoolUnlock(&pDeque->lock);
+    return pTask;
+}
+
+
+static void* PoolTake(HASH_WORKER* pWorker) {
+    /**
+     * @brief Own newest task, or else oldest task of another worker (starting from next one)
+     */
+    HASH_POOL* pPool = pWorker->pPool;
+    void* pTask = DequePopTail(&pWorker->deque);
+
+    for (size_t i = 1; !pTask && i < pPool->nWorkers; i++)
+        pTask = DequePopHead(&pPool->rgWorkers[(pWorker->iWorker + i) % pPool->nWorkers].deque);
+
+    if (pTask) atomic_fetch_sub(&pPool->nQueued, 1);
+    return pTask;
+}
+
+
+void Hash_PoolPush(HASH_WORKER* pWorker, void* pTask) {
+    /**
+     * @brief Queue task on worker's own deque, for it or an idle worker to run
+     *
+     * @details If deque cannot grow, task is run at once on calling thread
+     */
+    HASH_POOL* pPool = pWorker->pPool;
+
+    atomic_fetch_add(&pPool->nPending, 1);
+    atomic_fetch_add(&pPool->nQueued, 1);
+    if (!DequePush(&pWorker->deque, pTask)) {
+        atomic_fetch_sub(&pPool->nQueued, 1);
+        pPool->pfnTask(pWorker, pTask, pPool->pArg);
+        atomic_fetch_sub(&pPool->nPending, 1);
+        return;
+    }
+
+    // Sleeper counts itself before it checks nQueued, so one of the two sees the other
+    if (atomic_load(&pPool->nSleeping)) {
+        PoolLock(&pPool->lockIdle);
+        PoolCondSignal(&pPool->condIdle);
+        PoolUnlock(&pPool->lockIdle);
+    }
+}
+
+
+static void PoolWork(HASH_WORKER* pWorker) {
+    /**
+     * @brief Run tasks until none is queued or running
+     */
+    HASH_POOL* pPool = pWorker->pPool;
+
+    for (;;) {
+        void* pTask = PoolTake(pWorker);
+        if (pTask) {
+            pPool->pfnTask(pWorker, pTask, pPool->pArg);
+
+            // Last task done: wake everyone to leave
+            if (atomic_fetch_sub(&pPool->nPending, 1) == 1) {
+                PoolLock(&pPool->lockIdle);
+                PoolCondBroadcast(&pPool->condIdle);
+                PoolUnlock(&pPool->lockIdle);
+            }
+            continue;
+        }
+
+        if (!atomic_load(&pPool->nPending)) break;
+
+        // Nothing to steal, but running tasks may push more
+        PoolLock(&pPool->lockIdle);
+        atomic_fetch_add(&pPool->nSleeping, 1);
+        while (!atomic_load(&pPool->nQueued) && atomic_load(&pPool->nPending))
+            PoolCondWait(&pPool->condIdle, &pPool->lockIdle);
+        atomic_fetch_sub(&pPool->nSleeping, 1);
+        PoolUnlock(&pPool->lockIdle);
+    }
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI PoolWorker(LPVOID lpParam) {
+    PoolWork(lpParam);
+    Hash_IoBufferRelease();
+    return 0;
+}
+#else
+static void* PoolWorker(void* pParam) {
+    PoolWork(pParam);
+    Hash_IoBufferRelease();
+    return NULL;
+}
+#endif
+
+
+size_t Hash_PoolDefaultThreads() {
+    /**
+     * @brief Processors available, up to HASH_POOL_MAX_THREADS
+     */
+    size_t nProcessors;
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    nProcessors = si.dwNumberOfProcessors;
+#else
+    long nOnline = sysconf(_SC_NPROCESSORS_ONLN);
+    nProcessors = nOnline > 0 ? (size_t) nOnline : 1;
+#endif
+    if (!nProcessors) nProcessors = 1;
+    return nProcessors < HASH_POOL_MAX_THREADS ? nProcessors : HASH_POOL_MAX_THREADS;
+}
+
+
+HASH_STATUS Hash_PoolRun(size_t nThreads, HASH_TASK_FN pfnTask, void* pArg, void** ppTasks, size_t nTasks) {
+    /**
+     * @brief Run nTasks tasks, and every task pushed from them, on up to nThreads threads
+     *
+     * @details Calling thread is worker 0: it takes given tasks first to last, idle workers steal
+     *  them from the other end. nThreads of 0 means Hash_PoolDefaultThreads(). If a thread cannot
+     *  be started, the others take its share. Returns when all tasks are done
+     */
+    size_t nStarted = 0;
+#ifdef _WIN32
+    HANDLE rghThreads[HASH_POOL_MAX_THREADS];
+#else
+    pthread_t rgThreads[HASH_POOL_MAX_THREADS];
+#endif
+
+    HASH_POOL* pPool = calloc(1, sizeof(HASH_POOL));
+    if (!pPool) return POOL_ERROR_MEMORY;
+
+    if (!nThreads) nThreads = Hash_PoolDefaultThreads();
+    if (nThreads > HASH_POOL_MAX_THREADS) nThreads = HASH_POOL_MAX_THREADS;
+
+    pPool->pfnTask = pfnTask;
+    pPool->pArg = pArg;
+    pPool->nWorkers = nThreads;
+    atomic_init(&pPool->nQueued, 0);
+    atomic_init(&pPool->nPending, 0);
+    atomic_init(&pPool->nSleeping, 0);
+    PoolLockInit(&pPool->lockIdle);
+    PoolCondInit(&pPool->condIdle);
+    for (size_t i = 0; i < nThreads; i++) {
+        pPool->rgWorkers[i].pPool = pPool;
+        pPool->rgWorkers[i].iWorker = i;
+        PoolLockInit(&pPool->rgWorkers[i].deque.lock);
+    }
+
+    // First tasks before any thread starts: nobody leaves early. Last pushed is taken first
+    for (size_t i = nTasks; i > 0; i--)
+        Hash_PoolPush(&pPool->rgWorkers[0], ppTasks[i - 1]);
+
+    for (size_t t = 1; t < nThreads; t++) {
+#ifdef _WIN32
+        rghThreads[nStarted] = CreateThread(NULL, 0, PoolWorker, &pPool->rgWorkers[t], 0, NULL);
+        if (rghThreads[nStarted]) nStarted++;
+#else
+        if (0 == pthread_create(&rgThreads[nStarted], NULL, PoolWorker, &pPool->rgWorkers[t])) nStarted++;
+#endif
+    }
+
+    PoolWork(&pPool->rgWorkers[0]);
+
+#ifdef _WIN32
+    if (nStarted) WaitForMultipleObjects((DWORD) nStarted, rghThreads, TRUE, INFINITE);
+    for (size_t t = 0; t < nStarted; t++) CloseHandle(rghThreads[t]);
+#else
+    for (size_t t = 0; t < nStarted; t++) pthread_join(rgThreads[t], NULL);
+#endif
+
+    for (size_t i = 0; i < nThreads; i++) {
+        free(pPool->rgWorkers[i].deque.ppTasks);
+        PoolLockFree(&pPool->rgWorkers[i].deque.lock);
+    }
+    PoolCondFree(&pPool->condIdle);
+    PoolLockFree(&pPool->lockIdle);
+    free(pPool);
+    return HASH_STATUS_OK;
+}
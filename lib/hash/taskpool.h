@@ -0,0 +1,32 @@
+#ifndef INTEGRA_TASKPOOL_H
+#define INTEGRA_TASKPOOL_H
+
+/**
+ * Work-stealing task pool, for work whose size is unknown up front (a directory tree):
+ * a task may push more tasks while it runs, e.g. a folder pushes its sub-folders.
+ *
+ * Every worker keeps its own deque. It takes newest tasks from its tail (depth first, so
+ * memory stays warm and few tasks are queued at once), and an idle worker steals the oldest
+ * task from head of another deque (usually a big subtree, so steals are rare). Idle workers
+ * sleep until a task is pushed. Hash_PoolRun() returns once every task has run.
+ *
+ * Order in which tasks run is up to scheduling: results must not depend on it.
+ */
+
+#include <stddef.h>
+#include "filehash.h"
+
+#ifndef HASH_POOL_MAX_THREADS
+#define HASH_POOL_MAX_THREADS   64
+#endif
+
+typedef struct HASH_WORKER HASH_WORKER;
+
+// Runs one task. pArg is the one given to Hash_PoolRun()
+typedef void (*HASH_TASK_FN)(HASH_WORKER* pWorker, void* pTask, void* pArg);
+
+HASH_STATUS Hash_PoolRun(size_t nThreads, HASH_TASK_FN pfnTask, void* pArg, void** ppTasks, size_t nTasks);
+void Hash_PoolPush(HASH_WORKER* pWorker, void* pTask);
+size_t Hash_PoolDefaultThreads();
+
+#endif //INTEGRA_TASKPOOL_H
@@ -0,0 +1,247 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdio.h>
+#include <stdatomic.h>
+#include "throttle.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#define NS_PER_SEC      1000000000ull
+#define NS_PER_MS       1000000ull
+
+// Work time counted for one rest, at most: a thread may have been idle since its last read
+#define THROTTLE_WORK_MAX_NS    (HASH_THROTTLE_BURST_MS * NS_PER_MS)
+
+// Reads are compared per 64 KB; shorter ones count as this long (per-call cost dominates them)
+#define THROTTLE_READ_UNIT      (64 * 1024)
+#define THROTTLE_READ_MIN       4096
+
+
+static atomic_int isOn;
+static atomic_uint_least64_t cbRate;
+static atomic_uint_least64_t nFilesRate;
+static atomic_int isAdaptiveOn;
+
+// Token buckets: time each one is next free, on Hash_ThrottleClock()
+static atomic_uint_least64_t nsBytesFree;
+static atomic_uint_least64_t nsFilesFree;
+
+// Adaptive state. Load is sampled by one thread at a time
+static atomic_uint nShare;
+static atomic_uint_least64_t nsNextSample;
+static atomic_flag isSampling = ATOMIC_FLAG_INIT;
+static atomic_uint_least64_t nsReadRecent;     // per THROTTLE_READ_UNIT: moving average
+static atomic_uint_least64_t nsReadBest;       //  and best, drifting up so it follows the device
+static uint64_t nsCpuTotalLast, nsCpuIdleLast, nsCpuOwnLast;
+
+static _Thread_local uint64_t nsLastWork;
+
+
+uint64_t Hash_ThrottleClock() {
+    /**
+     * @brief Monotonic time, ns
+     */
+#ifdef _WIN32
+    static LARGE_INTEGER liFreq;
+    LARGE_INTEGER liNow;
+    if (!liFreq.QuadPart) QueryPerformanceFrequency(&liFreq);
+    QueryPerformanceCounter(&liNow);
+    return (uint64_t) (liNow.QuadPart / liFreq.QuadPart) * NS_PER_SEC +
+           (uint64_t) (liNow.QuadPart % liFreq.QuadPart) * NS_PER_SEC / (uint64_t) liFreq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NS_PER_SEC + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+
+static void SleepNs(uint64_t ns) {
+#ifdef _WIN32
+    Sleep((DWORD) ((ns + NS_PER_MS - 1) / NS_PER_MS));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t) (ns / NS_PER_SEC);
+    ts.tv_nsec = (long) (ns % NS_PER_SEC);
+    while (nanosleep(&ts, &ts) != 0) ;
+#endif
+}
+
+
+static int GetCpuTimes(uint64_t* pnsTotal, uint64_t* pnsIdle, uint64_t* pnsOwn) {
+    /**
+     * @brief CPU time of all processors since boot (total and idle), and of this process. 0 if unknown
+     */
+#ifdef _WIN32
+    FILETIME ftIdle, ftKernel, ftUser, ftCreate, ftExit, ftOwnKernel, ftOwnUser;
+    if (!GetSystemTimes(&ftIdle, &ftKernel, &ftUser) ||
+        !GetProcessTimes(GetCurrentProcess(), &ftCreate, &ftExit, &ftOwnKernel, &ftOwnUser))
+        return 0;
+
+    // 100 ns units. Kernel time includes idle time
+#define FT_NS(ft)   ((((uint64_t) (ft).dwHighDateTime << 32) | (ft).dwLowDateTime) * 100)
+    *pnsTotal = FT_NS(ftKernel) + FT_NS(ftUser);
+    *pnsIdle = FT_NS(ftIdle);
+    *pnsOwn = FT_NS(ftOwnKernel) + FT_NS(ftOwnUser);
+#undef FT_NS
+    return 1;
+#elif defined(__linux__)
+    unsigned long long rgTicks[8] = {0};
+    struct rusage ru;
+    long nHz = sysconf(_SC_CLK_TCK);
+
+    FILE* f = fopen("/proc/stat", "r");
+    if (!f) return 0;
+    int nFields = fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &rgTicks[0], &rgTicks[1], &rgTicks[2],
+                         &rgTicks[3], &rgTicks[4], &rgTicks[5], &rgTicks[6], &rgTicks[7]);
+    fclose(f);
+    if (nFields < 4 || nHz <= 0 || getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+
+    // user nice system idle iowait irq softirq steal
+    uint64_t nTotal = 0;
+    for (int i = 0; i < 8; i++) nTotal += rgTicks[i];
+    *pnsTotal = nTotal * NS_PER_SEC / (uint64_t) nHz;
+    *pnsIdle = (uint64_t) (rgTicks[3] + rgTicks[4]) * NS_PER_SEC / (uint64_t) nHz;
+    *pnsOwn = ((uint64_t) ru.ru_utime.tv_sec + (uint64_t) ru.ru_stime.tv_sec) * NS_PER_SEC +
+              ((uint64_t) ru.ru_utime.tv_usec + (uint64_t) ru.ru_stime.tv_usec) * 1000;
+    return 1;
+#else
+    (void) pnsTotal; (void) pnsIdle; (void) pnsOwn;
+    return 0;
+#endif
+}
+
+
+static void SampleLoad(uint64_t nsNow) {
+    /**
+     * @brief Every HASH_THROTTLE_SAMPLE_MS: raise or cut adaptive share by load since last sample
+     */
+    uint64_t nsTotal, nsIdle, nsOwn;
+    int nCpuOther = -1;
+
+    if (nsNow < atomic_load(&nsNextSample) || atomic_flag_test_and_set(&isSampling)) return;
+    if (nsNow < atomic_load(&nsNextSample)) {
+        atomic_flag_clear(&isSampling);
+        return;
+    }
+    atomic_store(&nsNextSample, nsNow + HASH_THROTTLE_SAMPLE_MS * NS_PER_MS);
+
+    // CPU time of other processes, % of all processors
+    if (GetCpuTimes(&nsTotal, &nsIdle, &nsOwn)) {
+        uint64_t nsDeltaTotal = nsTotal - nsCpuTotalLast;
+        uint64_t nsDeltaBusy = nsDeltaTotal - (nsIdle - nsCpuIdleLast);
+        uint64_t nsDeltaOwn = nsOwn - nsCpuOwnLast;
+        if (nsCpuTotalLast && nsDeltaTotal && nsDeltaTotal >= nsDeltaBusy)
+            nCpuOther = (int) ((nsDeltaBusy > nsDeltaOwn ? nsDeltaBusy - nsDeltaOwn : 0) * 100 / nsDeltaTotal);
+        nsCpuTotalLast = nsTotal;
+        nsCpuIdleLast = nsIdle;
+        nsCpuOwnLast = nsOwn;
+    }
+
+    uint64_t nsRecent = atomic_load(&nsReadRecent);
+    uint64_t nsBest = atomic_load(&nsReadBest);
+    int isSlow = nsBest && nsRecent > nsBest * HASH_THROTTLE_SLOW_RATIO;
+    int isBusy = isSlow || nCpuOther >= HASH_THROTTLE_CPU_BUSY;
+    int isIdle = !isSlow && nCpuOther < HASH_THROTTLE_CPU_IDLE;
+    atomic_store(&nsReadBest, nsBest + nsBest / 64);
+
+    unsigned nOld = atomic_load(&nShare);
+    unsigned nNew = nOld;
+    if (isBusy) nNew = nOld ? (nOld * 2 < HASH_THROTTLE_SHARE_MAX ? nOld * 2 : HASH_THROTTLE_SHARE_MAX) : HASH_THROTTLE_SHARE_ONE;
+    else if (isIdle) nNew = nOld > HASH_THROTTLE_SHARE_ONE / 4 ? nOld - (nOld + 3) / 4 : 0;
+    atomic_store(&nShare, nNew);
+
+    atomic_flag_clear(&isSampling);
+}
+
+
+static void NoteReadTime(size_t cbRead, uint64_t nsLatency) {
+    uint64_t nsUnit = nsLatency * THROTTLE_READ_UNIT / (cbRead > THROTTLE_READ_MIN ? cbRead : THROTTLE_READ_MIN);
+    uint64_t nsRecent = atomic_load(&nsReadRecent);
+    uint64_t nsBest = atomic_load(&nsReadBest);
+
+    // Races only lose a sample
+    atomic_store(&nsReadRecent, nsRecent ? nsRecent - nsRecent / 8 + nsUnit / 8 : nsUnit);
+    if (!nsBest || nsUnit < nsBest) atomic_store(&nsReadBest, nsUnit ? nsUnit : 1);
+}
+
+
+static void BucketTake(atomic_uint_least64_t* pnsFree, uint64_t nsCost) {
+    /**
+     * @brief Take nsCost of bucket's time. Sleep while bucket runs over HASH_THROTTLE_BURST_MS ahead of now
+     */
+    uint64_t nsNow = Hash_ThrottleClock();
+    uint64_t nsOld = atomic_load(pnsFree);
+    uint64_t nsNew;
+
+    do nsNew = (nsOld > nsNow ? nsOld : nsNow) + nsCost;
+    while (!atomic_compare_exchange_weak(pnsFree, &nsOld, nsNew));
+
+    if (nsNew > nsNow + HASH_THROTTLE_BURST_MS * NS_PER_MS)
+        SleepNs(nsNew - nsNow - HASH_THROTTLE_BURST_MS * NS_PER_MS);
+}
+
+
+void Hash_ThrottleSet(uint64_t cbPerSec, uint32_t nFilesPerSec, int isAdaptive) {
+    /**
+     * @brief Limit reads to cbPerSec bytes/s and opens to nFilesPerSec items/s (0: unlimited),
+     *  and rest after reads while system is busy if isAdaptive is set. All zero turns throttling off
+     */
+    atomic_store(&cbRate, cbPerSec);
+    atomic_store(&nFilesRate, nFilesPerSec);
+    atomic_store(&isAdaptiveOn, isAdaptive);
+    atomic_store(&nShare, 0);
+    atomic_store(&isOn, cbPerSec || nFilesPerSec || isAdaptive);
+}
+
+
+void Hash_ThrottleRead(size_t cbRead, uint64_t nsLatency) {
+    /**
+     * @brief Count cbRead bytes just read, nsLatency long (0: not measured). Waits for budget
+     */
+    if (!atomic_load_explicit(&isOn, memory_order_relaxed)) return;
+
+    uint64_t cbLimit = atomic_load(&cbRate);
+    if (cbLimit) BucketTake(&nsBytesFree, (uint64_t) cbRead * NS_PER_SEC / cbLimit);
+
+    if (atomic_load(&isAdaptiveOn)) {
+        uint64_t nsNow = Hash_ThrottleClock();
+        if (nsLatency) NoteReadTime(cbRead, nsLatency);
+        SampleLoad(nsNow);
+
+        // Rest for share of time worked since last read
+        unsigned nRest = atomic_load(&nShare);
+        if (nRest && nsLastWork && nsNow > nsLastWork) {
+            uint64_t nsWork = nsNow - nsLastWork;
+            if (nsWork > THROTTLE_WORK_MAX_NS) nsWork = THROTTLE_WORK_MAX_NS;
+            SleepNs(nsWork * nRest / HASH_THROTTLE_SHARE_ONE);
+        }
+    }
+    nsLastWork = Hash_ThrottleClock();
+}
+
+
+void Hash_ThrottleOpen() {
+    /**
+     * @brief Count one item about to be opened. Waits for budget
+     */
+    if (!atomic_load_explicit(&isOn, memory_order_relaxed)) return;
+
+    uint64_t nFilesLimit = atomic_load(&nFilesRate);
+    if (nFilesLimit) BucketTake(&nsFilesFree, NS_PER_SEC / nFilesLimit);
+}
+
+
+unsigned Hash_ThrottleShare() {
+    /**
+     * @brief Adaptive rest, in HASH_THROTTLE_SHARE_ONE units of work time
+     */
+    return atomic_load(&nShare);
+}
@@ -0,0 +1,49 @@
+#ifndef INTEGRA_THROTTLE_H
+#define INTEGRA_THROTTLE_H
+
+/**
+ * Throttling of background scans: every read and open on the hashing path asks for budget
+ * first, so a periodic check does not compete with the machine's own I/O.
+ *
+ * Budget: token buckets of bytes/s and files/s (items opened), shared by all threads.
+ * Each take moves its bucket's next free time on by its cost; a thread that runs more
+ * than HASH_THROTTLE_BURST_MS ahead of it sleeps until it is back within. 0 is unlimited.
+ *
+ * Adaptive: after each read, thread rests for a share of time it worked since its last
+ * one. Share is sampled every HASH_THROTTLE_SAMPLE_MS: doubled (from 1x) while system is
+ * busy, cut by a quarter (down to none) while it is idle. Busy means
+ *   - CPU time of other processes over HASH_THROTTLE_CPU_BUSY % of all processors, or
+ *   - our reads taking over HASH_THROTTLE_SLOW_RATIO times their best recent time (per 64 KB),
+ *     i.e. device is queued up with somebody else's requests
+ * and idle means other processes under HASH_THROTTLE_CPU_IDLE %, with reads at their usual pace.
+ *
+ * Off until Hash_ThrottleSet(): snapshots and on-demand checks run at full speed.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_THROTTLE_BURST_MS      100
+#define HASH_THROTTLE_SAMPLE_MS     250
+
+#ifndef HASH_THROTTLE_CPU_BUSY
+#define HASH_THROTTLE_CPU_BUSY      50
+#endif
+#ifndef HASH_THROTTLE_CPU_IDLE
+#define HASH_THROTTLE_CPU_IDLE      20
+#endif
+#ifndef HASH_THROTTLE_SLOW_RATIO
+#define HASH_THROTTLE_SLOW_RATIO    3
+#endif
+
+// Adaptive rest, in 1/16 of work time: at most 16x, i.e. scan runs at 1/17 of its speed
+#define HASH_THROTTLE_SHARE_ONE     16
+#define HASH_THROTTLE_SHARE_MAX     (16 * HASH_THROTTLE_SHARE_ONE)
+
+void Hash_ThrottleSet(uint64_t cbPerSec, uint32_t nFilesPerSec, int isAdaptive);
+void Hash_ThrottleRead(size_t cbRead, uint64_t nsLatency);
+void Hash_ThrottleOpen();
+unsigned Hash_ThrottleShare();
+uint64_t Hash_ThrottleClock();
+
+#endif //INTEGRA_THROTTLE_H
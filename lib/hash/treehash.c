@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include "treehash.h"
+
+
+static void StoreLE64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t) (v >> (8*i));
+}
+
+
+uint64_t Hash_TreeLeafCount(uint64_t cbTotal, uint64_t cbChunk) {
+    /**
+     * @brief Number of chunks. Empty data still has one (empty) leaf
+     */
+    if (!cbChunk) return 0;
+    return cbTotal ? (cbTotal + cbChunk - 1) / cbChunk : 1;
+}
+
+
+int Hash_TreeRoot(HASH_ALG alg, const uint8_t* pLeaves, uint64_t nLeaves,
+                  uint64_t cbChunk, uint64_t cbTotal, uint8_t* pDigest) {
+    /**
+     * @brief Combine leaf digests (nLeaves * cbDigest bytes, in chunk order) into root
+     */
+    HASH_CTX ctx;
+    uint8_t rgbSizes[16];
+
+    if (!Hash_Init(&ctx, alg)) return 0;
+
+    Hash_Update(&ctx, pLeaves, (size_t) (nLeaves * ctx.pProvider->cbDigest));
+    StoreLE64(rgbSizes, cbChunk);
+    StoreLE64(rgbSizes + 8, cbTotal);
+    Hash_Update(&ctx, rgbSizes, sizeof(rgbSizes));
+    Hash_Final(&ctx, pDigest);
+    return 1;
+}
+
+
+int Hash_TreeDigest(HASH_ALG alg, const void* pData, size_t cbData, uint64_t cbChunk, uint8_t* pDigest) {
+    /**
+     * @brief Tree digest of memory buffer, single-threaded. Same result as the threaded file path
+     */
+    const uint8_t* p = pData;
+    size_t cbDigest = Hash_DigestLen(alg);
+    uint64_t nLeaves = Hash_TreeLeafCount(cbData, cbChunk);
+    uint8_t* pLeaves;
+    int res;
+
+    if (!cbDigest || !nLeaves) return 0;
+
+    pLeaves = malloc(nLeaves * cbDigest);
+    if (!pLeaves) return 0;
+
+    for (uint64_t i = 0; i < nLeaves; i++) {
+        size_t cbLeaf = (size_t) (i + 1 < nLeaves ? cbChunk : cbData - i * cbChunk);
+        Hash_Digest(alg, p + i * cbChunk, cbLeaf, pLeaves + i * cbDigest);
+    }
+
+    res = Hash_TreeRoot(alg, pLeaves, nLeaves, cbChunk, cbData, pDigest);
+    free(pLeaves);
+    return res;
+}
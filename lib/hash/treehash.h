@@ -0,0 +1,39 @@
+#ifndef INTEGRA_TREEHASH_H
+#define INTEGRA_TREEHASH_H
+
+/**
+ * Tree-mode digest for large files: data is split into fixed chunks, each chunk
+ * is hashed on its own (so chunks can be hashed on separate threads) and leaf
+ * digests are combined into a root:
+ *
+ *      root = H( H(chunk0) | H(chunk1) | ... | H(chunkN-1) | cbChunk | cbTotal )
+ *
+ *  where  H        -  object's hash algorithm,
+ *         cbChunk  -  chunk size, 8-byte little-endian (last chunk may be shorter),
+ *         cbTotal  -  data size, 8-byte little-endian,
+ *          |       -  concat operation
+ *
+ * Trailing sizes keep root distinct from a plain digest of the same data.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hash.h"
+
+// Chunk size for new tree digests
+#ifndef HASH_TREE_CHUNK_LEN
+#define HASH_TREE_CHUNK_LEN     (8 * 1024 * 1024)
+#endif
+
+// Files at least this large get a tree digest, smaller ones keep a single stream
+#ifndef HASH_TREE_THRESHOLD
+#define HASH_TREE_THRESHOLD     (64 * 1024 * 1024)
+#endif
+
+uint64_t Hash_TreeLeafCount(uint64_t cbTotal, uint64_t cbChunk);
+int Hash_TreeRoot(HASH_ALG alg, const uint8_t* pLeaves, uint64_t nLeaves,
+                  uint64_t cbChunk, uint64_t cbTotal, uint8_t* pDigest);
+
+int Hash_TreeDigest(HASH_ALG alg, const void* pData, size_t cbData, uint64_t cbChunk, uint8_t* pDigest);
+
+#endif //INTEGRA_TREEHASH_H
@@ -0,0 +1,349 @@
+#include <string.h>
+#include "xxh3.h"
+
+
+#define SECRET_SIZE             192
+#define SECRET_LASTACC_START    7
+#define SECRET_MERGEACCS_START  11
+#define SECRET_SIZE_MIN         136
+#define MIDSIZE_STARTOFFSET     3
+#define MIDSIZE_LASTOFFSET      17
+#define STRIPES_PER_BLOCK       ((SECRET_SIZE - XXH3_STRIPE_LEN) / 8)
+
+#define PRIME32_1  0x9E3779B1U
+#define PRIME32_2  0x85EBCA77U
+#define PRIME32_3  0xC2B2AE3DU
+#define PRIME64_1  0x9E3779B185EBCA87ULL
+#define PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3  0x165667B19E3779F9ULL
+#define PRIME64_4  0x85EBCA77C2B2AE63ULL
+#define PRIME64_5  0x27D4EB2F165667C5ULL
+#define PRIME_MX1  0x165667919E3779F9ULL
+#define PRIME_MX2  0x9FB21C651E98DF25ULL
+
+typedef struct { uint64_t lo, hi; } U128;
+
+
+// Default secret (from FARSH), as in reference xxHash
+static const uint8_t kSecret[SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+
+static uint32_t Read32(const uint8_t* p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+static uint64_t Read64(const uint8_t* p) {
+    return (uint64_t) Read32(p) | ((uint64_t) Read32(p + 4) << 32);
+}
+
+
+static uint32_t Swap32(uint32_t x) {
+    return ((x << 24) & 0xff000000) | ((x << 8) & 0x00ff0000) | ((x >> 8) & 0x0000ff00) | ((x >> 24) & 0x000000ff);
+}
+
+
+static uint64_t Swap64(uint64_t x) {
+    return ((uint64_t) Swap32((uint32_t) x) << 32) | Swap32((uint32_t) (x >> 32));
+}
+
+
+static uint32_t Rotl32(uint32_t x, int r) { return (x << r) | (x >> (32 - r)); }
+static uint64_t XorShift64(uint64_t v, int s) { return v ^ (v >> s); }
+
+
+static U128 Mul64To128(uint64_t a, uint64_t b) {
+    U128 r;
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 p = (unsigned __int128) a * b;
+    r.lo = (uint64_t) p;
+    r.hi = (uint64_t) (p >> 64);
+#else
+    uint64_t lolo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    uint64_t hilo = (a >> 32) * (b & 0xFFFFFFFF);
+    uint64_t lohi = (a & 0xFFFFFFFF) * (b >> 32);
+    uint64_t hihi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lolo >> 32) + (hilo & 0xFFFFFFFF) + lohi;
+    r.hi = (hilo >> 32) + (cross >> 32) + hihi;
+    r.lo = (cross << 32) | (lolo & 0xFFFFFFFF);
+#endif
+    return r;
+}
+
+
+static uint64_t Mul128Fold64(uint64_t a, uint64_t b) {
+    U128 p = Mul64To128(a, b);
+    return p.lo ^ p.hi;
+}
+
+
+static uint64_t XXH64_Avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+
+static uint64_t Avalanche(uint64_t h) {
+    h = XorShift64(h, 37);
+    h *= PRIME_MX1;
+    return XorShift64(h, 32);
+}
+
+
+static uint64_t Mix16B(const uint8_t* in, const uint8_t* secret) {
+    return Mul128Fold64(Read64(in) ^ Read64(secret), Read64(in + 8) ^ Read64(secret + 8));
+}
+
+
+static U128 Mix32B(U128 acc, const uint8_t* in1, const uint8_t* in2, const uint8_t* secret) {
+    acc.lo += Mix16B(in1, secret);
+    acc.lo ^= Read64(in2) + Read64(in2 + 8);
+    acc.hi += Mix16B(in2, secret + 16);
+    acc.hi ^= Read64(in1) + Read64(in1 + 8);
+    return acc;
+}
+
+
+static U128 Finish17To240(U128 acc, size_t len) {
+    U128 h;
+    h.lo = acc.lo + acc.hi;
+    h.hi = acc.lo * PRIME64_1 + acc.hi * PRIME64_4 + (uint64_t) len * PRIME64_2;
+    h.lo = Avalanche(h.lo);
+    h.hi = 0 - Avalanche(h.hi);
+    return h;
+}
+
+
+static U128 HashShort(const uint8_t* in, size_t len) {
+    /**
+     * @brief One-shot XXH3-128 for inputs up to 240 bytes
+     */
+    const uint8_t* s = kSecret;
+    U128 h, acc;
+
+    if (len == 0) {
+        h.lo = XXH64_Avalanche(Read64(s + 64) ^ Read64(s + 72));
+        h.hi = XXH64_Avalanche(Read64(s + 80) ^ Read64(s + 88));
+        return h;
+    }
+
+    if (len <= 3) {
+        uint32_t combinedl = ((uint32_t) in[0] << 16) | ((uint32_t) in[len >> 1] << 24)
+                           | (uint32_t) in[len - 1] | ((uint32_t) len << 8);
+        uint32_t combinedh = Rotl32(Swap32(combinedl), 13);
+        h.lo = XXH64_Avalanche((uint64_t) combinedl ^ (uint64_t) (Read32(s) ^ Read32(s + 4)));
+        h.hi = XXH64_Avalanche((uint64_t) combinedh ^ (uint64_t) (Read32(s + 8) ^ Read32(s + 12)));
+        return h;
+    }
+
+    if (len <= 8) {
+        uint64_t in64 = Read32(in) + ((uint64_t) Read32(in + len - 4) << 32);
+        uint64_t keyed = in64 ^ (Read64(s + 16) ^ Read64(s + 24));
+        U128 m = Mul64To128(keyed, PRIME64_1 + ((uint64_t) len << 2));
+        m.hi += m.lo << 1;
+        m.lo ^= m.hi >> 3;
+        m.lo = XorShift64(m.lo, 35);
+        m.lo *= PRIME_MX2;
+        m.lo = XorShift64(m.lo, 28);
+        m.hi = Avalanche(m.hi);
+        return m;
+    }
+
+    if (len <= 16) {
+        uint64_t bitflipl = Read64(s + 32) ^ Read64(s + 40);
+        uint64_t bitfliph = Read64(s + 48) ^ Read64(s + 56);
+        uint64_t inLo = Read64(in);
+        uint64_t inHi = Read64(in + len - 8);
+        U128 m = Mul64To128(inLo ^ inHi ^ bitflipl, PRIME64_1);
+        m.lo += (uint64_t) (len - 1) << 54;
+        inHi ^= bitfliph;
+        m.hi += inHi + (uint64_t) (uint32_t) inHi * (PRIME32_2 - 1);
+        m.lo ^= Swap64(m.hi);
+        h = Mul64To128(m.lo, PRIME64_2);
+        h.hi += m.hi * PRIME64_2;
+        h.lo = Avalanche(h.lo);
+        h.hi = Avalanche(h.hi);
+        return h;
+    }
+
+    acc.lo = (uint64_t) len * PRIME64_1;
+    acc.hi = 0;
+
+    if (len <= 128) {
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) acc = Mix32B(acc, in + 48, in + len - 64, s + 96);
+                acc = Mix32B(acc, in + 32, in + len - 48, s + 64);
+            }
+            acc = Mix32B(acc, in + 16, in + len - 32, s + 32);
+        }
+        acc = Mix32B(acc, in, in + len - 16, s);
+        return Finish17To240(acc, len);
+    }
+
+    // 129..240
+    for (size_t i = 32; i < 160; i += 32)
+        acc = Mix32B(acc, in + i - 32, in + i - 16, s + i - 32);
+    acc.lo = Avalanche(acc.lo);
+    acc.hi = Avalanche(acc.hi);
+    for (size_t i = 160; i <= len; i += 32)
+        acc = Mix32B(acc, in + i - 32, in + i - 16, s + MIDSIZE_STARTOFFSET + i - 160);
+    acc = Mix32B(acc, in + len - 16, in + len - 32, s + SECRET_SIZE_MIN - MIDSIZE_LASTOFFSET - 16);
+    return Finish17To240(acc, len);
+}
+
+
+static void Accumulate512(uint64_t* acc, const uint8_t* in, const uint8_t* secret) {
+    for (int i = 0; i < 8; i++) {
+        uint64_t dataVal = Read64(in + 8*i);
+        uint64_t dataKey = dataVal ^ Read64(secret + 8*i);
+        acc[i ^ 1] += dataVal;
+        acc[i] += (dataKey & 0xFFFFFFFF) * (dataKey >> 32);
+    }
+}
+
+
+static void Accumulate(uint64_t* acc, const uint8_t* in, size_t nStripes) {
+    for (size_t n = 0; n < nStripes; n++)
+        Accumulate512(acc, in + n * XXH3_STRIPE_LEN, kSecret + n * 8);
+}
+
+
+static void ScrambleAcc(uint64_t* acc) {
+    const uint8_t* secret = kSecret + SECRET_SIZE - XXH3_STRIPE_LEN;
+    for (int i = 0; i < 8; i++) {
+        uint64_t a = XorShift64(acc[i], 47);
+        a ^= Read64(secret + 8*i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+
+static void ConsumeBlock(XXH3_CTX* ctx, const uint8_t* pBlock) {
+    Accumulate(ctx->acc, pBlock, STRIPES_PER_BLOCK);
+    ScrambleAcc(ctx->acc);
+    memcpy(ctx->lastStripe, pBlock + XXH3_BLOCK_LEN - XXH3_STRIPE_LEN, XXH3_STRIPE_LEN);
+}
+
+
+static uint64_t MergeAccs(const uint64_t* acc, const uint8_t* secret, uint64_t start) {
+    uint64_t r = start;
+    for (int i = 0; i < 4; i++)
+        r += Mul128Fold64(acc[2*i] ^ Read64(secret + 16*i), acc[2*i + 1] ^ Read64(secret + 16*i + 8));
+    return Avalanche(r);
+}
+
+
+void XXH3_Init(XXH3_CTX* ctx) {
+    ctx->acc[0] = PRIME32_3;
+    ctx->acc[1] = PRIME64_1;
+    ctx->acc[2] = PRIME64_2;
+    ctx->acc[3] = PRIME64_3;
+    ctx->acc[4] = PRIME64_4;
+    ctx->acc[5] = PRIME32_2;
+    ctx->acc[6] = PRIME64_5;
+    ctx->acc[7] = PRIME32_1;
+    ctx->cbTotal = 0;
+    ctx->cbBuffered = 0;
+}
+
+
+void XXH3_Update(XXH3_CTX* ctx, const void* pData, size_t cbData) {
+    /**
+     * @brief Feed bytes to context
+     *
+     * @details A block is consumed only when more data follows it: final block
+     *  is always handled by XXH3_Final(), like the last partial block in one-shot mode.
+     */
+    const uint8_t* p = pData;
+
+    ctx->cbTotal += cbData;
+
+    if (ctx->cbBuffered + cbData <= XXH3_BLOCK_LEN) {
+        memcpy(ctx->buffer + ctx->cbBuffered, p, cbData);
+        ctx->cbBuffered += cbData;
+        return;
+    }
+
+    // Complete and consume buffered block
+    if (ctx->cbBuffered) {
+        size_t cbFill = XXH3_BLOCK_LEN - ctx->cbBuffered;
+        memcpy(ctx->buffer + ctx->cbBuffered, p, cbFill);
+        p += cbFill;
+        cbData -= cbFill;
+        ConsumeBlock(ctx, ctx->buffer);
+    }
+
+    // Whole blocks straight from input, keeping at least one byte back
+    while (cbData > XXH3_BLOCK_LEN) {
+        ConsumeBlock(ctx, p);
+        p += XXH3_BLOCK_LEN;
+        cbData -= XXH3_BLOCK_LEN;
+    }
+
+    memcpy(ctx->buffer, p, cbData);
+    ctx->cbBuffered = cbData;
+}
+
+
+void XXH3_Final(XXH3_CTX* ctx, uint8_t digest[XXH3_DIGEST_LEN]) {
+    U128 h;
+
+    if (ctx->cbTotal <= 240)
+        h = HashShort(ctx->buffer, ctx->cbBuffered);
+    else {
+        uint64_t acc[8];
+        uint8_t rgbLast[XXH3_STRIPE_LEN];
+        const uint8_t* pLast;
+
+        memcpy(acc, ctx->acc, sizeof(acc));
+
+        // Stripes of last partial block, then last stripe of input
+        Accumulate(acc, ctx->buffer, (ctx->cbBuffered - 1) / XXH3_STRIPE_LEN);
+
+        if (ctx->cbBuffered >= XXH3_STRIPE_LEN)
+            pLast = ctx->buffer + ctx->cbBuffered - XXH3_STRIPE_LEN;
+        else {
+            size_t cbOld = XXH3_STRIPE_LEN - ctx->cbBuffered;
+            memcpy(rgbLast, ctx->lastStripe + XXH3_STRIPE_LEN - cbOld, cbOld);
+            memcpy(rgbLast + cbOld, ctx->buffer, ctx->cbBuffered);
+            pLast = rgbLast;
+        }
+        Accumulate512(acc, pLast, kSecret + SECRET_SIZE - XXH3_STRIPE_LEN - SECRET_LASTACC_START);
+
+        h.lo = MergeAccs(acc, kSecret + SECRET_MERGEACCS_START, ctx->cbTotal * PRIME64_1);
+        h.hi = MergeAccs(acc, kSecret + SECRET_SIZE - sizeof(acc) - SECRET_MERGEACCS_START,
+                         ~(ctx->cbTotal * PRIME64_2));
+    }
+
+    // Canonical: big-endian high, then low
+    for (int i = 0; i < 8; i++) {
+        digest[i]     = (uint8_t) (h.hi >> (56 - 8*i));
+        digest[8 + i] = (uint8_t) (h.lo >> (56 - 8*i));
+    }
+}
+
+
+void XXH3_Digest(const void* pData, size_t cbData, uint8_t digest[XXH3_DIGEST_LEN]) {
+    XXH3_CTX ctx;
+    XXH3_Init(&ctx);
+    XXH3_Update(&ctx, pData, cbData);
+    XXH3_Final(&ctx, digest);
+}
@@ -0,0 +1,32 @@
+#ifndef INTEGRA_XXH3_H
+#define INTEGRA_XXH3_H
+
+/**
+ * XXH3-128 (xxHash v0.8, seed 0, default secret). Fast, non-cryptographic.
+ *
+ * Digest is in canonical form: high 64 bits then low 64 bits, big-endian,
+ * same bytes as XXH128_canonicalFromHash() / xxhsum --xxh128 output.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define XXH3_DIGEST_LEN     16
+#define XXH3_STRIPE_LEN     64
+#define XXH3_BLOCK_LEN      1024    // 16 stripes per block with default secret
+
+typedef struct {
+    uint64_t acc[8];
+    uint64_t cbTotal;
+    size_t cbBuffered;
+    uint8_t buffer[XXH3_BLOCK_LEN];         // pending data, never consumed until more data follows
+    uint8_t lastStripe[XXH3_STRIPE_LEN];    // tail of last consumed block
+} XXH3_CTX;
+
+void XXH3_Init(XXH3_CTX* ctx);
+void XXH3_Update(XXH3_CTX* ctx, const void* pData, size_t cbData);
+void XXH3_Final(XXH3_CTX* ctx, uint8_t digest[XXH3_DIGEST_LEN]);
+
+void XXH3_Digest(const void* pData, size_t cbData, uint8_t digest[XXH3_DIGEST_LEN]);
+
+#endif //INTEGRA_XXH3_H
@@ -0,0 +1,30 @@
+#ifndef INTEGRA_MD5CORE_H
+#define INTEGRA_MD5CORE_H
+
+/**
+ * Portable MD5 engine (RFC 1321).
+ *
+ * No OS dependencies: context lives on the caller's stack and can be reused
+ * after MD5_Final() by calling MD5_Init() again.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MD5_DIGEST_LEN  16
+#define MD5_BLOCK_LEN   64
+
+typedef struct {
+    uint32_t state[4];
+    uint64_t cbTotal;                   // bytes hashed so far
+    uint8_t  buffer[MD5_BLOCK_LEN];     // pending partial block
+} MD5_CTX;
+
+void MD5_Init(MD5_CTX* ctx);
+void MD5_Update(MD5_CTX* ctx, const void* pData, size_t cbData);
+void MD5_Final(MD5_CTX* ctx, uint8_t digest[MD5_DIGEST_LEN]);
+
+void MD5_Digest(const void* pData, size_t cbData, uint8_t digest[MD5_DIGEST_LEN]);
+void MD5_Transform(uint32_t state[4], const uint8_t* pBlocks, size_t nBlocks);
+
+#endif //INTEGRA_MD5CORE_H
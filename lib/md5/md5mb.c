@@ -0,0 +1,262 @@
+#include <string.h>
+#include "md5mb.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MD5MB_X86
+#include <immintrin.h>
+#endif
+
+
+typedef void (*MD5MB_KERNEL)(uint32_t* state, const uint8_t* const* ppBlocks);
+
+typedef struct {
+    MD5_JOB* pJob;
+    const uint8_t* pData;
+    size_t iBlock;                          // next block to compress
+    size_t nDataBlocks;                     // full blocks taken straight from pData
+    size_t nBlocks;                         // data blocks + 1 or 2 padding blocks
+    uint8_t tail[2 * MD5_BLOCK_LEN];        // last partial block with padding and length
+} MD5_LANE;
+
+
+static uint32_t LoadLE32(const uint8_t* p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+#ifdef MD5MB_X86
+
+// SSE2: 4 lanes
+#define KERNEL_NAME   MD5MB_KernelSSE2
+#define KERNEL_TARGET __attribute__((target("sse2")))
+#define LANES         4
+#define VEC           __m128i
+#define V_LOAD(p)     _mm_load_si128((const __m128i*) (p))
+#define V_STORE(p, v) _mm_store_si128((__m128i*) (p), (v))
+#define V_SET1(x)     _mm_set1_epi32((int) (x))
+#define V_ADD(a, b)   _mm_add_epi32((a), (b))
+#define V_XOR(a, b)   _mm_xor_si128((a), (b))
+#define V_AND(a, b)   _mm_and_si128((a), (b))
+#define V_OR(a, b)    _mm_or_si128((a), (b))
+#define V_ROTL(x, n)  _mm_or_si128(_mm_slli_epi32((x), (n)), _mm_srli_epi32((x), 32 - (n)))
+#include "md5mb_kernel.inc"
+#undef KERNEL_NAME
+#undef KERNEL_TARGET
+#undef LANES
+#undef VEC
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET1
+#undef V_ADD
+#undef V_XOR
+#undef V_AND
+#undef V_OR
+#undef V_ROTL
+
+// AVX2: 8 lanes
+#define KERNEL_NAME   MD5MB_KernelAVX2
+#define KERNEL_TARGET __attribute__((target("avx2")))
+#define LANES         8
+#define VEC           __m256i
+#define V_LOAD(p)     _mm256_load_si256((const __m256i*) (p))
+#define V_STORE(p, v) _mm256_store_si256((__m256i*) (p), (v))
+#define V_SET1(x)     _mm256_set1_epi32((int) (x))
+#define V_ADD(a, b)   _mm256_add_epi32((a), (b))
+#define V_XOR(a, b)   _mm256_xor_si256((a), (b))
+#define V_AND(a, b)   _mm256_and_si256((a), (b))
+#define V_OR(a, b)    _mm256_or_si256((a), (b))
+#define V_ROTL(x, n)  _mm256_or_si256(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+#include "md5mb_kernel.inc"
+#undef KERNEL_NAME
+#undef KERNEL_TARGET
+#undef LANES
+#undef VEC
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET1
+#undef V_ADD
+#undef V_XOR
+#undef V_AND
+#undef V_OR
+#undef V_ROTL
+
+// AVX-512: 16 lanes, native rotate
+#define KERNEL_NAME   MD5MB_KernelAVX512
+#define KERNEL_TARGET __attribute__((target("avx512f")))
+#define LANES         16
+#define VEC           __m512i
+#define V_LOAD(p)     _mm512_load_si512((const void*) (p))
+#define V_STORE(p, v) _mm512_store_si512((void*) (p), (v))
+#define V_SET1(x)     _mm512_set1_epi32((int) (x))
+#define V_ADD(a, b)   _mm512_add_epi32((a), (b))
+#define V_XOR(a, b)   _mm512_xor_si512((a), (b))
+#define V_AND(a, b)   _mm512_and_si512((a), (b))
+#define V_OR(a, b)    _mm512_or_si512((a), (b))
+#define V_ROTL(x, n)  _mm512_rol_epi32((x), (n))
+#include "md5mb_kernel.inc"
+#undef KERNEL_NAME
+#undef KERNEL_TARGET
+#undef LANES
+#undef VEC
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET1
+#undef V_ADD
+#undef V_XOR
+#undef V_AND
+#undef V_OR
+#undef V_ROTL
+
+#endif //MD5MB_X86
+
+
+static MD5MB_KERNEL pfnKernel = NULL;
+static unsigned nKernelLanes = 0;
+static const char* szKernelName = NULL;
+
+
+static void SelectKernel() {
+    /**
+     * @brief Pick widest kernel supported by CPU. Racing callers pick the same one
+     */
+    MD5MB_KERNEL pfn = NULL;
+    unsigned lanes = 1;
+    const char* name = "scalar";
+
+#ifdef MD5MB_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))   { pfn = MD5MB_KernelAVX512; lanes = 16; name = "avx512"; }
+    else if (__builtin_cpu_supports("avx2")) { pfn = MD5MB_KernelAVX2;   lanes = 8;  name = "avx2"; }
+    else if (__builtin_cpu_supports("sse2")) { pfn = MD5MB_KernelSSE2;   lanes = 4;  name = "sse2"; }
+#endif
+
+    pfnKernel = pfn;
+    szKernelName = name;
+    nKernelLanes = lanes;
+}
+
+
+unsigned MD5MB_Lanes() {
+    if (!nKernelLanes) SelectKernel();
+    return nKernelLanes;
+}
+
+
+const char* MD5MB_KernelName() {
+    if (!nKernelLanes) SelectKernel();
+    return szKernelName;
+}
+
+
+static void LaneStart(MD5_LANE* lane, MD5_JOB* pJob, uint32_t* state, unsigned l, unsigned nLanes) {
+    /**
+     * @brief Assign job to lane: reset lane state to IV and prepare padded tail
+     */
+    size_t cbTail = pJob->cbData % MD5_BLOCK_LEN;
+    size_t cbPadded = (cbTail < MD5_BLOCK_LEN - 8) ? MD5_BLOCK_LEN : 2 * MD5_BLOCK_LEN;
+    uint64_t cBits = (uint64_t) pJob->cbData << 3;
+
+    lane->pJob = pJob;
+    lane->pData = pJob->pData;
+    lane->iBlock = 0;
+    lane->nDataBlocks = pJob->cbData / MD5_BLOCK_LEN;
+    lane->nBlocks = lane->nDataBlocks + cbPadded / MD5_BLOCK_LEN;
+
+    if (cbTail) memcpy(lane->tail, lane->pData + lane->nDataBlocks * MD5_BLOCK_LEN, cbTail);
+    lane->tail[cbTail] = 0x80;
+    memset(lane->tail + cbTail + 1, 0, cbPadded - cbTail - 1);
+    for (int i = 0; i < 8; i++)
+        lane->tail[cbPadded - 8 + i] = (uint8_t) (cBits >> (8*i));
+
+    state[0 * nLanes + l] = 0x67452301;
+    state[1 * nLanes + l] = 0xefcdab89;
+    state[2 * nLanes + l] = 0x98badcfe;
+    state[3 * nLanes + l] = 0x10325476;
+}
+
+
+static const uint8_t* LaneBlock(const MD5_LANE* lane) {
+    if (lane->iBlock < lane->nDataBlocks)
+        return lane->pData + lane->iBlock * MD5_BLOCK_LEN;
+    return lane->tail + (lane->iBlock - lane->nDataBlocks) * MD5_BLOCK_LEN;
+}
+
+
+static void LaneFinish(MD5_LANE* lane, const uint32_t* state, unsigned l, unsigned nLanes) {
+    for (int i = 0; i < 4; i++) {
+        uint32_t v = state[i * nLanes + l];
+        lane->pJob->pDigest[4*i + 0] = (uint8_t) v;
+        lane->pJob->pDigest[4*i + 1] = (uint8_t) (v >> 8);
+        lane->pJob->pDigest[4*i + 2] = (uint8_t) (v >> 16);
+        lane->pJob->pDigest[4*i + 3] = (uint8_t) (v >> 24);
+    }
+    lane->pJob = NULL;
+}
+
+
+void MD5_HashBatch(MD5_JOB* pJobs, size_t nJobs) {
+    /**
+     * @brief Compute MD5 of every job, filling lanes as earlier jobs complete
+     *
+     * @details Lanes advance in lockstep, one block per kernel call. A lane that finishes
+     *  its job immediately takes the next one, so short and long buffers can be mixed.
+     *  Idle lanes compress a dummy block. When the queue is drained and one lane is left,
+     *  it is finished with the scalar transform.
+     */
+    static const uint8_t rgbZeroBlock[MD5_BLOCK_LEN] = {0};
+
+    _Alignas(64) uint32_t state[4 * MD5MB_MAX_LANES];
+    const uint8_t* ppBlocks[MD5MB_MAX_LANES];
+    MD5_LANE lanes[MD5MB_MAX_LANES];
+    unsigned nLanes = MD5MB_Lanes();
+    unsigned nActive = 0;
+    size_t iNext = 0;
+
+    // Scalar kernel or nothing worth batching
+    if (nLanes == 1 || nJobs == 1) {
+        for (size_t i = 0; i < nJobs; i++)
+            MD5_Digest(pJobs[i].pData, pJobs[i].cbData, pJobs[i].pDigest);
+        return;
+    }
+
+    for (unsigned l = 0; l < nLanes; l++) {
+        lanes[l].pJob = NULL;
+        if (iNext < nJobs) {
+            LaneStart(&lanes[l], &pJobs[iNext++], state, l, nLanes);
+            nActive++;
+        }
+    }
+
+    while (nActive) {
+        // Last job running alone: no point in wide kernel
+        if (nActive == 1 && iNext == nJobs) {
+            for (unsigned l = 0; l < nLanes; l++) {
+                if (!lanes[l].pJob) continue;
+                uint32_t s[4];
+                for (int i = 0; i < 4; i++) s[i] = state[i * nLanes + l];
+                if (lanes[l].iBlock < lanes[l].nDataBlocks) {
+                    MD5_Transform(s, LaneBlock(&lanes[l]), lanes[l].nDataBlocks - lanes[l].iBlock);
+                    lanes[l].iBlock = lanes[l].nDataBlocks;
+                }
+                MD5_Transform(s, LaneBlock(&lanes[l]), lanes[l].nBlocks - lanes[l].iBlock);
+                for (int i = 0; i < 4; i++) state[i * nLanes + l] = s[i];
+                LaneFinish(&lanes[l], state, l, nLanes);
+            }
+            break;
+        }
+
+        for (unsigned l = 0; l < nLanes; l++)
+            ppBlocks[l] = lanes[l].pJob ? LaneBlock(&lanes[l]) : rgbZeroBlock;
+
+        pfnKernel(state, ppBlocks);
+
+        for (unsigned l = 0; l < nLanes; l++) {
+            if (!lanes[l].pJob) continue;
+            if (++lanes[l].iBlock < lanes[l].nBlocks) continue;
+
+            LaneFinish(&lanes[l], state, l, nLanes);
+            if (iNext < nJobs) LaneStart(&lanes[l], &pJobs[iNext++], state, l, nLanes);
+            else nActive--;
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef INTEGRA_MD5MB_H
+#define INTEGRA_MD5MB_H
+
+/**
+ * Multi-buffer MD5: hashes independent buffers in SIMD lanes, one block per lane per step.
+ *
+ * Kernel is picked at first use: AVX-512 (16 lanes), AVX2 (8), SSE2 (4) or scalar (1).
+ * Output is bit-for-bit identical to MD5_Digest() for every job.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "md5core.h"
+
+#define MD5MB_MAX_LANES 16
+
+typedef struct {
+    const void* pData;
+    size_t cbData;
+    uint8_t* pDigest;       // MD5_DIGEST_LEN bytes, may alias pData
+} MD5_JOB;
+
+void MD5_HashBatch(MD5_JOB* pJobs, size_t nJobs);
+
+unsigned MD5MB_Lanes();
+const char* MD5MB_KernelName();
+
+#endif //INTEGRA_MD5MB_H
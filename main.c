@@ -5,10 +5,57 @@
 #include "cfg.h"
 #include "utils.h"
 #include "integra.h"
+#include "taskpool.h"
 
 #pragma comment(lib, "advapi32.lib")
 
 
+static WINBOOL ParseObjectArgs(int argc, char** argv, int index, BOOL hasFiles, OBJECT_OPTIONS* pOptions) {
+    /**
+     * @brief Get optional [algorithm], [scan], [check], [chunking], [entries] and [encoding] arguments, in any order.
+     * Default is MD5, cached, full, fixed, allow-new, hex. All but algorithm and encoding are only for objects with files (not registry)
+     */
+    SetDefaultOptions(pOptions);
+
+    for (int i = index; i < argc; i++) {
+        const HASH_PROVIDER* pProvider = Hash_FindProvider(argv[i]);
+        if (pProvider) {
+            pOptions->alg = pProvider->alg;
+            continue;
+        }
+        if (hasFiles && Hash_FindScan(argv[i], &pOptions->scan)) continue;
+        if (hasFiles && FindCheckMode(argv[i], &pOptions->check)) continue;
+        if (hasFiles && FindChunking(argv[i], &pOptions->chunking)) continue;
+        if (hasFiles && FindEntriesMode(argv[i], &pOptions->entries)) continue;
+        if (Hash_FindEncoding(argv[i], &pOptions->enc)) continue;
+
+        printf("Unknown option '%s'. Hash algorithms:", argv[i]);
+        for (int j = 0; j < HASH_ALG_COUNT; j++)
+            printf(" %s", Hash_GetProvider(j)->szName);
+        if (hasFiles) {
+            printf("\nScan modes:");
+            for (int j = 0; j < HASH_SCAN_COUNT; j++)
+                printf(" %s", Hash_ScanName(j));
+            printf("\nCheck modes:");
+            for (int j = 0; j < CHECK_MODE_COUNT; j++)
+                printf(" %s", CheckModeName(j));
+            printf("\nChunking modes:");
+            for (int j = 0; j < CHUNKING_MODE_COUNT; j++)
+                printf(" %s", ChunkingName(j));
+            printf("\nEntries modes:");
+            for (int j = 0; j < ENTRIES_MODE_COUNT; j++)
+                printf(" %s", EntriesModeName(j));
+        }
+        printf("\nEncodings:");
+        for (int j = 0; j < HASH_ENC_COUNT; j++)
+            printf(" %s", Hash_EncodingName(j));
+        printf("\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
 int main(int argc, char** argv) {
     // Initialize registry paths *
     InitRegPaths();
@@ -21,6 +68,68 @@ int main(int argc, char** argv) {
     if (argc > 1 && !strcmpi(argv[1], "uninstall"))
         return SvcUninstall();
 
+    // "interval slice [slice_ms]" - Get / set* time slice of service checks (0: whole check at once)
+    if (argc > 2 && !strcmpi(argv[1], "interval") && !strcmpi(argv[2], "slice")) {
+        if (argc == 3) {
+            DWORD slice = GetCheckSlice();
+            if (!slice) printf("Check slice is not set. Checks run whole at once\n");
+            else printf("Check slice:  %lu ms (%luh %lum %lus)\n", slice, slice/3600000, (slice/60000)%60, (slice/1000)%60);
+            return EXIT_SUCCESS;
+        }
+        if (SetCheckSlice(atol(argv[3]))) {
+            printf("OK\n");
+            return EXIT_SUCCESS;
+        }
+        printf("Failed. Try to run as administrator\n");
+        return EXIT_FAILURE;
+    }
+
+    // "throttle [bytes_per_sec files_per_sec [adaptive]]" - Get / set* read limits of service checks (0: no limit)
+    if (argc > 1 && !strcmpi(argv[1], "throttle")) {
+        if (argc == 2) {
+            DWORD cbPerSec, nFilesPerSec;
+            WINBOOL isAdaptive;
+            GetCheckThrottle(&cbPerSec, &nFilesPerSec, &isAdaptive);
+            if (cbPerSec) printf("Bytes per second:  %lu (%lu MB/s)\n", cbPerSec, cbPerSec / (1024*1024));
+            else printf("Bytes per second:  no limit\n");
+            if (nFilesPerSec) printf("Files per second:  %lu\n", nFilesPerSec);
+            else printf("Files per second:  no limit\n");
+            printf("Adaptive:          %s\n", isAdaptive ? "on (back off while system is busy)" : "off");
+            return EXIT_SUCCESS;
+        }
+        if (argc != 4 && !(argc == 5 && !strcmpi(argv[4], "adaptive"))) {
+            printf("Failed: Usage: throttle [bytes_per_sec files_per_sec [adaptive]]\n");
+            return EXIT_FAILURE;
+        }
+        if (SetCheckThrottle(atol(argv[2]), atol(argv[3]), argc == 5)) {
+            printf("OK\n");
+            return EXIT_SUCCESS;
+        }
+        printf("Failed. Try to run as administrator\n");
+        return EXIT_FAILURE;
+    }
+
+    // "interval full [delay_ms]" - Get / set* interval between full checks (every file hashed)
+    if (argc > 2 && !strcmpi(argv[1], "interval") && !strcmpi(argv[2], "full")) {
+        if (argc == 3) {
+            DWORD delay = GetFullCheckInterval();
+            if (!delay) printf("Full check interval is not set. Using default (24 hours)\n");
+            else printf("Full check interval:  %lu ms (%luh %lum %lus)\n", delay, delay/3600000, (delay/60000)%60, (delay/1000)%60);
+            return EXIT_SUCCESS;
+        }
+        DWORD delay = atol(argv[3]);
+        if (!delay) {
+            printf("Failed: Please enter valid delay (ms)\n");
+            return EXIT_FAILURE;
+        }
+        if (SetFullCheckInterval(delay)) {
+            printf("OK\n");
+            return EXIT_SUCCESS;
+        }
+        printf("Failed. Try to run as administrator\n");
+        return EXIT_FAILURE;
+    }
+
     // "interval [delay_ms]" - Get / set* integrity check interval for service
     if (argc > 1 && !strcmpi(argv[1], "interval")) {
         // no interval specified, print existing
@@ -47,6 +156,53 @@ int main(int argc, char** argv) {
         }
     }
 
+    // "threads verify [count]" - Get / set* number of threads for verification
+    if (argc > 2 && !strcmpi(argv[1], "threads") && !strcmpi(argv[2], "verify")) {
+        if (argc == 3) {
+            DWORD nThreads = GetVerifyThreads();
+            if (!nThreads) printf("Verification threads are not set. Using default (%zu, one per processor)\n", Hash_PoolDefaultThreads());
+            else printf("Verification threads:  %lu\n", nThreads);
+            return EXIT_SUCCESS;
+        }
+        DWORD nThreads = atol(argv[3]);
+        if (!nThreads) {
+            printf("Failed: Please enter valid number of threads\n");
+            return EXIT_FAILURE;
+        }
+        if (SetVerifyThreads(nThreads)) {
+            printf("OK\n");
+            return EXIT_SUCCESS;
+        }
+        printf("Failed. Try to run as administrator\n");
+        return EXIT_FAILURE;
+    }
+
+    // "threads [count]" - Get / set* number of threads for snapshots
+    if (argc > 1 && !strcmpi(argv[1], "threads")) {
+        // no count specified, print existing
+        if (argc == 2) {
+            DWORD nThreads = GetSnapshotThreads();
+            if (!nThreads) printf("Snapshot threads are not set. Using default (%zu, one per processor)\n", Hash_PoolDefaultThreads());
+            else printf("Snapshot threads:  %lu\n", nThreads);
+            return EXIT_SUCCESS;
+        }
+        else {
+            DWORD nThreads = atol(argv[2]);
+            if (!nThreads) {
+                printf("Failed: Please enter valid number of threads\n");
+                return EXIT_FAILURE;
+            }
+            if (SetSnapshotThreads(nThreads)) {
+                printf("OK\n");
+                return EXIT_SUCCESS;
+            }
+            else {
+                printf("Failed. Try to run as administrator\n");
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
     // "list path [path]" - Get / set* absolute path for OL file
     if (argc > 2 && !strcmpi(argv[1], "list") && !strcmpi(argv[2], "path")) {
         // no path specified, print existing
@@ -70,30 +226,40 @@ int main(int argc, char** argv) {
         }
     }
 
-    // "addFile <name> <path>" - Add object (file / folder) to OL
-    if (argc > 3 && !strcmpi(argv[1], "addfile"))
-        return AddObjectToOL(argv[2], OBJECT_FILE, argv[3]);
+    // "addFile <name> <path> [algorithm] [scan] [check] [chunking] [entries] [encoding]" - Add object (file / folder) to OL
+    if (argc > 3 && !strcmpi(argv[1], "addfile")) {
+        OBJECT_OPTIONS options;
+        if (!ParseObjectArgs(argc, argv, 4, TRUE, &options)) return EXIT_FAILURE;
+        return AddObjectToOL(argv[2], OBJECT_FILE, argv[3], &options);
+    }
 
-    // "addReg <name> <path>" - Add object (regisry key) to OL
-    if (argc > 3 && !strcmpi(argv[1], "addreg"))
-        return AddObjectToOL(argv[2], OBJECT_REGISTRY, argv[3]);
+    // "addReg <name> <path> [algorithm] [encoding]" - Add object (regisry key) to OL
+    if (argc > 3 && !strcmpi(argv[1], "addreg")) {
+        OBJECT_OPTIONS options;
+        if (!ParseObjectArgs(argc, argv, 4, FALSE, &options)) return EXIT_FAILURE;
+        return AddObjectToOL(argv[2], OBJECT_REGISTRY, argv[3], &options);
+    }
 
     // "remove <name>" - Remove object from OL
     if (argc > 2 && !strcmpi(argv[1], "remove"))
         return RemoveObjectFromOL(argv[2]);
 
-    // "update <name>" - Update hashes for object in OL
+    // "update <name> [path]" - Update hashes for object in OL, or for one file or folder of it
     if (argc > 2 && !strcmpi(argv[1], "update"))
-        return UpdateObjectInOL(argv[2]);
+        return UpdateObjectInOL(argv[2], argc > 3 ? argv[3] : NULL);
+
+    // "accept <name> [path]" - Take state found by last check of object as its snapshot, or of one file or folder of it
+    if (argc > 2 && !strcmpi(argv[1], "accept"))
+        return AcceptObjectInOL(argv[2], argc > 3 ? argv[3] : NULL);
 
     // "list" - Show objects in OL
     if (argc == 2 && !strcmpi(argv[1], "list"))
         return PrintObjectsInOL();
 
-    // "verify" - Verify on-demand
-    if (argc == 2 && !strcmpi(argv[1], "verify")) {
+    // "verify [full]" - Verify on-demand
+    if ((argc == 2 || (argc == 3 && !strcmpi(argv[2], "full"))) && !strcmpi(argv[1], "verify")) {
         // run service without stop  =>  check once
-        ServiceLoop(INTEGRA_CHECK_ONCE);
+        ServiceLoop(INTEGRA_CHECK_ONCE, argc == 3);
         printf("Verification complete. See Event Log for details\n");
         return EXIT_SUCCESS;
     }
@@ -104,15 +270,35 @@ int main(int argc, char** argv) {
         printf("Lab 8: Integrity control service\n"
                "Available commands:\n"
                "\tinstall                -  Install service (run as admin)\n"
-               "\tverify                 -  Verify objects on-demand\n"
+               "\tverify [full]          -  Verify objects on-demand. full: hash every file\n"
                "\tinterval [delay_ms]    -  Get or set time interval (ms) between checks. Default: 1800000 (30 min)\n"
+               "\tinterval full [ms]     -  Get or set interval between full checks. Default: 86400000 (24 hours)\n"
+               "\tinterval slice [ms]    -  Get or set time slice of checks, spread over interval. Default: 0 (whole)\n"
+               "\tthrottle [limits]      -  Get or set read limits of service checks (see below)\n"
+               "\tthreads [count]        -  Get or set number of threads for snapshots. Default: one per processor\n"
+               "\tthreads verify [count] -  Get or set number of threads for verification. Default: one per processor\n"
                "\tlist path [path]       -  Get or set path for Object List. Default: (same as exe)\\integra-objects.json\n"
                "\tlist                   -  Print list of objects\n"
-               "\taddFile <name> <path>  -  Add file or folder\n"
-               "\taddReg <name> <path>   -  Add registry key\n"
-               "\tupdate <name>          -  Update object's state\n"
+               "\taddFile <name> <path>  -  Add file or folder. Options may follow (see below)\n"
+               "\taddReg <name> <path>   -  Add registry key. Options may follow (see below)\n"
+               "\tupdate <name> [path]   -  Update object's state. path: only this file or folder of it\n"
+               "\taccept <name> [path]   -  Take changes found by last check as object's state, without rescan\n"
                "\tremove <name>          -  Remove object from list\n"
-               "\th, help                -  Print this message\n");
+               "\th, help                -  Print this message\n"
+               "\n"
+               "addFile <name> <path> [algorithm] [scan] [check] [chunking] [entries] [encoding]\n"
+               "addReg <name> <path> [algorithm] [encoding]\n"
+               "throttle [bytes_per_sec files_per_sec [adaptive]]  (0: no limit. adaptive: back off while system is busy)\n"
+               "\n"
+               "Algorithms: md5 (default), sha256 (SHA-NI / ARMv8 if available), blake3, xxh3-128 (fast, not tamper-resistant)\n"
+               "Scan modes: cached (default), nocache (unbuffered reads: checks do not evict other programs' data from cache)\n"
+               "Check modes: full (default), metadata (hash only files whose size, times or id changed, and on full checks),\n"
+               "             sampled (files of 64 MB and more: compare head, middle and tail, hash whole only on full checks)\n"
+               "Chunking: fixed (default), cdc (files of 64 MB and more: content-defined chunks, a change is reported\n"
+               "          as changed byte ranges, update rehashes only changed chunks)\n"
+               "Entries: allow-new (default: files and folders added since snapshot are ignored),\n"
+               "         exact (entries of every folder must be the same as in snapshot)\n"
+               "Encodings: hex (default), base64 (compact Object List: a third smaller digests)\n");
         return EXIT_SUCCESS;
     }
 
@@ -1,8 +1,17 @@
 /**
 
  base path:   HKLM\SYSTEM\CurrentControlSet\Services\Integra\
-    - \Parameters                  - subkey. if not exists, create
-    - \Parameters\ObjectListFile   - REG_SZ. required (exit if not present)
+    - \Parameters                       - subkey. if not exists, create
+    - \Parameters\ObjectListFile        - REG_SZ. required (exit if not present)
+    - \Parameters\CheckIntervalMS       - REG_DWORD. optional
+    - \Parameters\FullCheckIntervalMS   - REG_DWORD. optional
+    - \Parameters\SnapshotThreads       - REG_DWORD. optional
+    - \Parameters\VerifyThreads         - REG_DWORD. optional
+    - \Parameters\CheckSliceMS          - REG_DWORD. optional
+    - \Parameters\ThrottleBytesPerSec   - REG_DWORD. optional
+    - \Parameters\ThrottleFilesPerSec   - REG_DWORD. optional
+    - \Parameters\ThrottleAdaptive      - REG_DWORD. optional
+    - \Parameters\CheckCursor           - REG_MULTI_SZ. set by service while a check is in progress
 
  */
 
@@ -15,12 +24,21 @@
 #define PARAMETERS_PATH BASE_PATH _T("\\Parameters")
 #define OL_FILE _T("ObjectListFile")
 #define CHECK_INTERVAL _T("CheckIntervalMS")
+#define FULL_CHECK_INTERVAL _T("FullCheckIntervalMS")
+#define SNAPSHOT_THREADS _T("SnapshotThreads")
+#define VERIFY_THREADS _T("VerifyThreads")
+#define CHECK_SLICE _T("CheckSliceMS")
+#define THROTTLE_BYTES _T("ThrottleBytesPerSec")
+#define THROTTLE_FILES _T("ThrottleFilesPerSec")
+#define THROTTLE_ADAPTIVE _T("ThrottleAdaptive")
+#define CHECK_CURSOR _T("CheckCursor")
 
 
-LPTSTR GetOLFilePath() {
+static LPTSTR GetParameterText(LPCTSTR szValueName, DWORD dwType) {
     /**
-     * @brief Allocate and Read REG_SZ: Parameters/ObjectListFile.
-     * Allocates result string, so the caller is responsible for freeing.
+     * @brief Allocate and Read REG_SZ or REG_MULTI_SZ from Parameters. NULL if missing
+     *
+     * @details Ends with two NULs, even if stored without them
      */
     HKEY parametersKey;
     DWORD valueType;
@@ -30,47 +48,55 @@ LPTSTR GetOLFilePath() {
         return FALSE;  // Failed to create or open parameters key
 
 
-    if (ERROR_SUCCESS != RegQueryValueEx(parametersKey, OL_FILE, NULL, &valueType, NULL, &bufferSize)) {
+    if (ERROR_SUCCESS != RegQueryValueEx(parametersKey, szValueName, NULL, &valueType, NULL, &bufferSize)) {
         RegCloseKey(parametersKey);
-        return NULL;  // Failed to get log file value size
+        return NULL;  // Failed to get value size
     }
 
-    if (valueType != REG_SZ) {
+    if (valueType != dwType) {
         RegCloseKey(parametersKey);
-        return NULL;  // Log file value is not REG_SZ
+        return NULL;  // Value is of another type
     }
 
-    LPTSTR filePath = calloc(bufferSize, sizeof(TCHAR));
-    if (!filePath) {
+    LPTSTR szValue = calloc(bufferSize / sizeof(TCHAR) + 2, sizeof(TCHAR));
+    if (!szValue) {
         RegCloseKey(parametersKey);
         return NULL;
     }
 
-    if (ERROR_SUCCESS != RegQueryValueEx(parametersKey, OL_FILE, NULL, NULL, (LPVOID) filePath, &bufferSize)) {
-        free(filePath);
+    if (ERROR_SUCCESS != RegQueryValueEx(parametersKey, szValueName, NULL, NULL, (LPVOID) szValue, &bufferSize)) {
+        free(szValue);
         RegCloseKey(parametersKey);
-        return NULL;  // Failed to get log file value
+        return NULL;  // Failed to get value
     }
 
     RegCloseKey(parametersKey);
-    return filePath;
+    return szValue;
 }
 
 
-WINBOOL SetOLFilePath(LPCTSTR path) {
+static LPTSTR GetParameterString(LPCTSTR szValueName) {
     /**
-     * @brief Create or set REG_SZ at Parameters/ObjectListFile
+     * @brief Allocate and Read REG_SZ from Parameters. NULL if missing
+     */
+    return GetParameterText(szValueName, REG_SZ);
+}
+
+
+static WINBOOL SetParameterString(LPCTSTR szValueName, LPCTSTR szValue) {
+    /**
+     * @brief Create or set REG_SZ in Parameters
      */
     HKEY parametersKey;
     if (ERROR_SUCCESS != RegCreateKeyEx(HKEY_LOCAL_MACHINE, PARAMETERS_PATH, 0, NULL, REG_OPTION_NON_VOLATILE, KEY_WRITE, NULL, &parametersKey, NULL))
         return FALSE;  // Failed to create or open parameters key
 
     WINBOOL result = (RegSetValueEx(parametersKey,
-                                    OL_FILE,
+                                    szValueName,
                                     0,
                                     REG_SZ,
-                                    (LPVOID) path,
-                                    (_tcslen(path) + 1) * sizeof(TCHAR)
+                                    (LPVOID) szValue,
+                                    (_tcslen(szValue) + 1) * sizeof(TCHAR)
     ) == ERROR_SUCCESS);
 
     RegCloseKey(parametersKey);
@@ -78,6 +104,23 @@ WINBOOL SetOLFilePath(LPCTSTR path) {
 }
 
 
+LPTSTR GetOLFilePath() {
+    /**
+     * @brief Allocate and Read REG_SZ: Parameters/ObjectListFile.
+     * Allocates result string, so the caller is responsible for freeing.
+     */
+    return GetParameterString(OL_FILE);
+}
+
+
+WINBOOL SetOLFilePath(LPCTSTR path) {
+    /**
+     * @brief Create or set REG_SZ at Parameters/ObjectListFile
+     */
+    return SetParameterString(OL_FILE, path);
+}
+
+
 WINBOOL InitRegPaths() {
     /**
      * @brief Create sub-key Parameters
@@ -96,9 +139,9 @@ WINBOOL InitRegPaths() {
 
 
 
-DWORD GetCheckInterval() {
+static DWORD GetParameterDword(LPCTSTR szValueName) {
     /**
-     * @brief Read DWORD: Parameters/CheckIntervalMS
+     * @brief Read DWORD from Parameters. 0 if missing
      */
     HKEY parametersKey;
     DWORD dwValue = 0, dwSize = sizeof(DWORD);
@@ -107,7 +150,7 @@ DWORD GetCheckInterval() {
         return 0;  // Failed to create or open parameters key
 
 
-    if (ERROR_SUCCESS != RegQueryValueEx(parametersKey, CHECK_INTERVAL, NULL, NULL, (LPVOID) &dwValue, &dwSize)) {
+    if (ERROR_SUCCESS != RegQueryValueEx(parametersKey, szValueName, NULL, NULL, (LPVOID) &dwValue, &dwSize)) {
         RegCloseKey(parametersKey);
         return 0;
     }
@@ -116,24 +159,170 @@ DWORD GetCheckInterval() {
     return dwValue;
 }
 
+
+static WINBOOL SetParameterDword(LPCTSTR szValueName, DWORD dwValue) {
+    /**
+     * @brief Create or set REG_DWORD in Parameters
+     */
+    HKEY parametersKey;
+    if (ERROR_SUCCESS != RegCreateKeyEx(HKEY_LOCAL_MACHINE, PARAMETERS_PATH, 0, NULL, REG_OPTION_NON_VOLATILE, KEY_WRITE, NULL, &parametersKey, NULL))
+        return FALSE;  // Failed to create or open parameters key
+
+    WINBOOL result = (RegSetValueEx(parametersKey,
+                                    szValueName,
+                                    0,
+                                    REG_DWORD,
+                                    (LPVOID) &dwValue,
+                                    sizeof(DWORD)
+                     ) == ERROR_SUCCESS);
+
+    RegCloseKey(parametersKey);
+    return result;
+}
+
+
+DWORD GetCheckInterval() {
+    /**
+     * @brief Read DWORD: Parameters/CheckIntervalMS
+     */
+    return GetParameterDword(CHECK_INTERVAL);
+}
+
 WINBOOL SetCheckInterval(DWORD dwValueMs) {
     /**
      * @brief Create or set REG_DWORD at Parameters/CheckIntervalMS
      */
     if (!dwValueMs) return FALSE;
+    return SetParameterDword(CHECK_INTERVAL, dwValueMs);
+}
+
+
+DWORD GetFullCheckInterval() {
+    /**
+     * @brief Read DWORD: Parameters/FullCheckIntervalMS
+     */
+    return GetParameterDword(FULL_CHECK_INTERVAL);
+}
+
+WINBOOL SetFullCheckInterval(DWORD dwValueMs) {
+    /**
+     * @brief Create or set REG_DWORD at Parameters/FullCheckIntervalMS
+     */
+    if (!dwValueMs) return FALSE;
+    return SetParameterDword(FULL_CHECK_INTERVAL, dwValueMs);
+}
+
+
+DWORD GetSnapshotThreads() {
+    /**
+     * @brief Read DWORD: Parameters/SnapshotThreads. 0 if not set (one per processor)
+     */
+    return GetParameterDword(SNAPSHOT_THREADS);
+}
+
+WINBOOL SetSnapshotThreads(DWORD dwThreads) {
+    /**
+     * @brief Create or set REG_DWORD at Parameters/SnapshotThreads
+     */
+    if (!dwThreads) return FALSE;
+    return SetParameterDword(SNAPSHOT_THREADS, dwThreads);
+}
+
+
+DWORD GetVerifyThreads() {
+    /**
+     * @brief Read DWORD: Parameters/VerifyThreads. 0 if not set (one per processor)
+     */
+    return GetParameterDword(VERIFY_THREADS);
+}
+
+WINBOOL SetVerifyThreads(DWORD dwThreads) {
+    /**
+     * @brief Create or set REG_DWORD at Parameters/VerifyThreads
+     */
+    if (!dwThreads) return FALSE;
+    return SetParameterDword(VERIFY_THREADS, dwThreads);
+}
+
+
+DWORD GetCheckSlice() {
+    /**
+     * @brief Read DWORD: Parameters/CheckSliceMS. 0 if not set (whole check at once)
+     */
+    return GetParameterDword(CHECK_SLICE);
+}
+
+WINBOOL SetCheckSlice(DWORD dwValueMs) {
+    /**
+     * @brief Create or set REG_DWORD at Parameters/CheckSliceMS. 0: whole check at once
+     */
+    return SetParameterDword(CHECK_SLICE, dwValueMs);
+}
+
+
+void GetCheckThrottle(DWORD* pcbPerSec, DWORD* pnFilesPerSec, WINBOOL* pIsAdaptive) {
+    /**
+     * @brief Read DWORDs: Parameters/ThrottleBytesPerSec, ThrottleFilesPerSec, ThrottleAdaptive. 0 if not set (no limit)
+     */
+    *pcbPerSec = GetParameterDword(THROTTLE_BYTES);
+    *pnFilesPerSec = GetParameterDword(THROTTLE_FILES);
+    *pIsAdaptive = GetParameterDword(THROTTLE_ADAPTIVE) != 0;
+}
 
+WINBOOL SetCheckThrottle(DWORD cbPerSec, DWORD nFilesPerSec, WINBOOL isAdaptive) {
+    /**
+     * @brief Create or set REG_DWORDs at Parameters/ThrottleBytesPerSec, ThrottleFilesPerSec, ThrottleAdaptive
+     */
+    return SetParameterDword(THROTTLE_BYTES, cbPerSec) &&
+           SetParameterDword(THROTTLE_FILES, nFilesPerSec) &&
+           SetParameterDword(THROTTLE_ADAPTIVE, isAdaptive ? 1 : 0);
+}
+
+
+LPTSTR GetCheckCursor() {
+    /**
+     * @brief Allocate and Read REG_MULTI_SZ: Parameters/CheckCursor. NULL if no check is in progress
+     *
+     * @details Strings follow one another, each ended by NUL, and the last by two.
+     *  Caller is responsible for freeing
+     */
+    return GetParameterText(CHECK_CURSOR, REG_MULTI_SZ);
+}
+
+WINBOOL SetCheckCursor(LPCTSTR mszCursor) {
+    /**
+     * @brief Create or set REG_MULTI_SZ at Parameters/CheckCursor: position of check in progress
+     *
+     * @details Whole position is one value, written at once: it is never left half old, half new
+     */
     HKEY parametersKey;
+    LPCTSTR pEnd = mszCursor;
+    while (*pEnd) pEnd += _tcslen(pEnd) + 1;
+
     if (ERROR_SUCCESS != RegCreateKeyEx(HKEY_LOCAL_MACHINE, PARAMETERS_PATH, 0, NULL, REG_OPTION_NON_VOLATILE, KEY_WRITE, NULL, &parametersKey, NULL))
         return FALSE;  // Failed to create or open parameters key
 
     WINBOOL result = (RegSetValueEx(parametersKey,
-                                    CHECK_INTERVAL,
+                                    CHECK_CURSOR,
                                     0,
-                                    REG_DWORD,
-                                    (LPVOID) &dwValueMs,
-                                    sizeof(DWORD)
+                                    REG_MULTI_SZ,
+                                    (LPVOID) mszCursor,
+                                    (pEnd - mszCursor + 1) * sizeof(TCHAR)
                      ) == ERROR_SUCCESS);
 
     RegCloseKey(parametersKey);
     return result;
-}
\ No newline at end of file
+}
+
+WINBOOL ClearCheckCursor() {
+    /**
+     * @brief Mark check complete: next one starts from first object
+     */
+    HKEY parametersKey;
+    if (ERROR_SUCCESS != RegOpenKeyEx(HKEY_LOCAL_MACHINE, PARAMETERS_PATH, 0, KEY_SET_VALUE, &parametersKey))
+        return FALSE;  // Failed to open parameters key
+
+    LSTATUS res = RegDeleteValue(parametersKey, CHECK_CURSOR);
+    RegCloseKey(parametersKey);
+    return res == ERROR_SUCCESS || res == ERROR_FILE_NOT_FOUND;
+}
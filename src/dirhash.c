@@ -0,0 +1,549 @@
+#include <stdio.h>
+#include <tchar.h>
+#include "dirhash.h"
+
+
+/*
+ *  Entry of directory listing (see WalkDirMeta)
+ */
+typedef struct {
+    size_t ichName;         // in name pool, while it grows
+    LPCTSTR szName;         // once it is complete
+    HASH_NODE_INFO info;
+} DIR_ENTRY;
+
+
+/*
+ *  Item of directory HashNode (see SortSlaves)
+ */
+typedef struct {
+    LPCTSTR szName;
+    BOOL isDirectory;
+    cJSON* jsonNode;
+} SLAVE_REF;
+
+
+static int CompareEntries(const void* a, const void* b) {
+    return _tcscmp(((const DIR_ENTRY*) a)->szName, ((const DIR_ENTRY*) b)->szName);
+}
+
+
+static int CompareSlaves(const void* a, const void* b) {
+    return _tcscmp(((const SLAVE_REF*) a)->szName, ((const SLAVE_REF*) b)->szName);
+}
+
+
+static int CompareDirs(const void* a, const void* b) {
+    return _tcscmp(((const DIR_META*) a)->szPath, ((const DIR_META*) b)->szPath);
+}
+
+
+static void UpdateLE(HASH_CTX* ctx, ULONGLONG qwValue, int cbValue) {
+    BYTE rgb[8];
+    for (int i = 0; i < cbValue; i++)
+        rgb[i] = (BYTE) (qwValue >> (8 * i));
+    Hash_Update(ctx, rgb, cbValue);
+}
+
+
+static void UpdateEntryName(HASH_CTX* ctx, LPCTSTR szName, BOOL isDirectory) {
+    // Name with its terminator, then type
+    BYTE bType = isDirectory ? 'd' : 'f';
+    Hash_Update(ctx, szName, (_tcslen(szName) + 1) * sizeof(TCHAR));
+    Hash_Update(ctx, &bType, 1);
+}
+
+
+void InitDirMetaCache(DIR_META_CACHE* pCache, HASH_ALG alg) {
+    pCache->alg = alg;
+    pCache->pDirs = NULL;
+    pCache->nDirs = pCache->nAlloc = 0;
+    pCache->pfnStop = NULL;
+    pCache->pStopArg = NULL;
+}
+
+
+void FreeDirMetaCache(DIR_META_CACHE* pCache) {
+    for (size_t i = 0; i < pCache->nDirs; i++)
+        free(pCache->pDirs[i].szPath);
+    free(pCache->pDirs);
+    pCache->pDirs = NULL;
+    pCache->nDirs = pCache->nAlloc = 0;
+}
+
+
+static BOOL ReadListing(HANDLE hDir, DIR_ENTRY** ppEntries, size_t* pnEntries, LPTSTR* pszPool) {
+    /**
+     * @brief Read all entries of open directory: names, types, sizes, times and file indices
+     *
+     * @details Entries come in bulk (see Hash_DirRead), "." and ".." and reparse points skipped,
+     *  as snapshot skips them. Entries and their name pool are allocated, caller frees them
+     */
+    DIR_ENTRY* pEntries = NULL;
+    LPTSTR szPool = NULL;
+    size_t nEntries = 0, nAlloc = 0, cchPool = 0, cchAlloc = 0;
+    const HASH_DIR_ENTRY* pBatch;
+    size_t nBatch;
+    BOOL isOk = TRUE;
+
+    HASH_DIR_READER* pReader = Hash_DirOpen(hDir);
+    if (!pReader) return FALSE;
+
+    while (isOk) {
+        if (ERROR_SUCCESS != Hash_DirRead(pReader, &pBatch, &nBatch)) { isOk = FALSE; break; }
+        if (!nBatch) break;
+
+        for (size_t i = 0; i < nBatch; i++) {
+            size_t cchName = _tcslen(pBatch[i].szName);
+
+            if (nEntries == nAlloc) {
+                nAlloc = nAlloc ? nAlloc * 2 : 64;
+                DIR_ENTRY* pNew = realloc(pEntries, nAlloc * sizeof(DIR_ENTRY));
+                if (!pNew) { isOk = FALSE; break; }
+                pEntries = pNew;
+            }
+            if (cchPool + cchName + 1 > cchAlloc) {
+                cchAlloc = max(cchAlloc * 2, cchPool + cchName + 1 + 4096);
+                LPTSTR szNew = realloc(szPool, cchAlloc * sizeof(TCHAR));
+                if (!szNew) { isOk = FALSE; break; }
+                szPool = szNew;
+            }
+
+            DIR_ENTRY* pEntry = &pEntries[nEntries++];
+            pEntry->ichName = cchPool;
+            pEntry->info = pBatch[i].info;
+            _tcscpy(szPool + cchPool, pBatch[i].szName);
+            cchPool += cchName + 1;
+        }
+    }
+
+    Hash_DirClose(pReader);
+    if (!isOk) {
+        free(pEntries);
+        free(szPool);
+        return FALSE;
+    }
+
+    for (size_t i = 0; i < nEntries; i++)
+        pEntries[i].szName = szPool + pEntries[i].ichName;
+
+    *ppEntries = pEntries;
+    *pnEntries = nEntries;
+    *pszPool = szPool;
+    return TRUE;
+}
+
+
+/*
+ *  Folder being summed up by WalkDirMeta: one level of its explicit stack
+ */
+typedef struct {
+    HANDLE hDir;            // closed when folder is done, unless it is walk's own root
+    DIR_ENTRY* pEntries;    // sorted by name
+    size_t nEntries;
+    LPTSTR szPool;
+    size_t iNext;
+    size_t cchMark;         // length of path before folder's name
+    HASH_CTX ctxMeta;
+} WALK_FRAME;
+
+
+static BOOL PushWalkFrame(WALK_FRAME** ppFrames, size_t* pnFrames, size_t* pnAlloc, HANDLE hDir, size_t cchMark, HASH_ALG alg) {
+    /**
+     * @brief List folder and put it on top of walk stack. FALSE if it cannot be listed
+     */
+    if (*pnFrames == *pnAlloc) {
+        size_t nAlloc = *pnAlloc ? *pnAlloc * 2 : 16;
+        WALK_FRAME* pFrames = realloc(*ppFrames, nAlloc * sizeof(WALK_FRAME));
+        if (!pFrames) return FALSE;
+        *ppFrames = pFrames;
+        *pnAlloc = nAlloc;
+    }
+
+    WALK_FRAME* pFrame = &(*ppFrames)[*pnFrames];
+    if (!ReadListing(hDir, &pFrame->pEntries, &pFrame->nEntries, &pFrame->szPool)) return FALSE;
+    qsort(pFrame->pEntries, pFrame->nEntries, sizeof(DIR_ENTRY), CompareEntries);
+
+    pFrame->hDir = hDir;
+    pFrame->iNext = 0;
+    pFrame->cchMark = cchMark;
+    Hash_Init(&pFrame->ctxMeta, alg);
+    (*pnFrames)++;
+    return TRUE;
+}
+
+
+static void CacheDirMeta(DIR_META_CACHE* pCache, LPCTSTR szPath, const DIR_META* pMeta) {
+    /**
+     * @brief Add meta of folder to cache. Sorted by caller, once whole walk is done. Skipped if out of memory
+     */
+    if (pCache->nDirs == pCache->nAlloc) {
+        size_t nAlloc = pCache->nAlloc ? pCache->nAlloc * 2 : 64;
+        DIR_META* pDirs = realloc(pCache->pDirs, nAlloc * sizeof(DIR_META));
+        if (!pDirs) return;
+        pCache->pDirs = pDirs;
+        pCache->nAlloc = nAlloc;
+    }
+    DIR_META* pCached = &pCache->pDirs[pCache->nDirs];
+    *pCached = *pMeta;
+    pCached->szPath = _tcsdup(szPath);
+    if (pCached->szPath) pCache->nDirs++;
+}
+
+
+static BOOL IsWalkStopped(const DIR_META_CACHE* pCache) {
+    return pCache->pfnStop && pCache->pfnStop(pCache->pStopArg);
+}
+
+
+static BOOL WalkDirMeta(DIR_META_CACHE* pCache, HANDLE hRoot, HASH_PATH_BUF* pPath) {
+    /**
+     * @brief Sum up actual state of directory and everything under it, caching every sub-folder on the way
+     *
+     * @details Iterative, depth first: one frame per level on an explicit stack, so any depth
+     *  takes the same native stack. Sub-folders are opened relative to their parent (see Hash_OpenAt),
+     *  pPath only names them in cache: its name is appended going down and cut off coming up.
+     *  Fails if any folder in subtree cannot be listed, or if cache's stop function says so
+     *  before a folder is listed: walk of a huge subtree may be cut short by its caller's deadline
+     */
+    WALK_FRAME* pFrames = NULL;
+    size_t nFrames = 0, nAlloc = 0;
+    size_t cbDigest = Hash_DigestLen(pCache->alg);
+    BOOL isOk;
+
+    isOk = !IsWalkStopped(pCache) && PushWalkFrame(&pFrames, &nFrames, &nAlloc, hRoot, pPath->cchPath, pCache->alg);
+
+    while (isOk && nFrames) {
+        WALK_FRAME* pFrame = &pFrames[nFrames - 1];
+
+        // Next item of folder on top
+        if (pFrame->iNext < pFrame->nEntries) {
+            const DIR_ENTRY* pEntry = &pFrame->pEntries[pFrame->iNext++];
+            const HASH_NODE_INFO* pInfo = &pEntry->info;
+            UpdateEntryName(&pFrame->ctxMeta, pEntry->szName, pInfo->isDirectory);
+
+            if (pInfo->isDirectory) {
+                // Down a level. Its meta goes to this folder's sum when it is done
+                HANDLE hSubDir;
+                size_t cchMark = pPath->cchPath;
+                if (IsWalkStopped(pCache) ||
+                    ERROR_SUCCESS != Hash_OpenAt(pFrame->hDir, pEntry->szName, HASH_SCAN_CACHED, &hSubDir)) {
+                    isOk = FALSE;
+                    break;
+                }
+                if (!Hash_PathPush(pPath, pEntry->szName) ||
+                    !PushWalkFrame(&pFrames, &nFrames, &nAlloc, hSubDir, cchMark, pCache->alg)) {
+                    Hash_PathPop(pPath, cchMark);
+                    CloseHandle(hSubDir);
+                    isOk = FALSE;
+                }
+            }
+            else {
+                UpdateLE(&pFrame->ctxMeta, pInfo->cbSize, 8);
+                UpdateLE(&pFrame->ctxMeta, pInfo->ftWrite, 8);
+                UpdateLE(&pFrame->ctxMeta, pInfo->ftChange, 8);
+                UpdateLE(&pFrame->ctxMeta, pInfo->dwVolume, 4);
+                UpdateLE(&pFrame->ctxMeta, pInfo->qwIndex, 8);
+            }
+            continue;
+        }
+
+        // Folder done: cache it, up a level
+        DIR_META meta;
+        memset(&meta, 0, sizeof(meta));
+        Hash_Final(&pFrame->ctxMeta, meta.meta.b);
+        CacheDirMeta(pCache, pPath->szPath, &meta);
+
+        free(pFrame->pEntries);
+        free(pFrame->szPool);
+        if (pFrame->hDir != hRoot) CloseHandle(pFrame->hDir);
+        Hash_PathPop(pPath, pFrame->cchMark);
+        nFrames--;
+
+        if (nFrames) Hash_Update(&pFrames[nFrames - 1].ctxMeta, meta.meta.b, cbDigest);
+    }
+
+    // Failed: unwind what is left
+    while (nFrames) {
+        WALK_FRAME* pFrame = &pFrames[--nFrames];
+        free(pFrame->pEntries);
+        free(pFrame->szPool);
+        if (pFrame->hDir != hRoot) CloseHandle(pFrame->hDir);
+        Hash_PathPop(pPath, pFrame->cchMark);
+    }
+    free(pFrames);
+    return isOk;
+}
+
+
+const DIR_META* GetDirMeta(DIR_META_CACHE* pCache, HANDLE hDir, LPCTSTR szPath) {
+    /**
+     * @brief Get actual meta of open directory, cached by its full path (see dirhash.h)
+     *
+     * @details First request for a path walks its whole subtree, so requests for its sub-folders
+     *  are answered from cache. Returns NULL if subtree could not be listed
+     */
+    HASH_PATH_BUF walkPath;
+    DIR_META key = {(LPTSTR) szPath};
+    DIR_META* pFound;
+    BOOL isOk;
+
+    if (pCache->nDirs) {
+        pFound = bsearch(&key, pCache->pDirs, pCache->nDirs, sizeof(DIR_META), CompareDirs);
+        if (pFound) return pFound;
+    }
+
+    if (!Hash_PathInit(&walkPath, szPath)) return NULL;
+    isOk = WalkDirMeta(pCache, hDir, &walkPath);
+    Hash_PathFree(&walkPath);
+
+    // Folders summed up before a failed walk stopped are kept as well
+    qsort(pCache->pDirs, pCache->nDirs, sizeof(DIR_META), CompareDirs);
+    if (!isOk) return NULL;
+    return bsearch(&key, pCache->pDirs, pCache->nDirs, sizeof(DIR_META), CompareDirs);
+}
+
+
+static SLAVE_REF* SortSlaves(cJSON* jsonSlaves, int* pnRefs) {
+    /**
+     * @brief Items of directory HashNode, sorted by name. NULL if node has no slaves or out of memory
+     */
+    cJSON* jsonSlave;
+    int nRefs = 0;
+
+    *pnRefs = 0;
+    if (!jsonSlaves || !cJSON_IsArray(jsonSlaves)) return NULL;
+    SLAVE_REF* pRefs = malloc((cJSON_GetArraySize(jsonSlaves) + 1) * sizeof(SLAVE_REF));
+    if (!pRefs) return NULL;
+
+    cJSON_ArrayForEach(jsonSlave, jsonSlaves) {
+        cJSON* jsonName = cJSON_GetObjectItem(jsonSlave, "name");
+        if (!jsonName || !cJSON_IsString(jsonName)) continue;
+        pRefs[nRefs].szName = cJSON_GetStringValue(jsonName);
+        pRefs[nRefs].isDirectory = cJSON_IsArray(cJSON_GetObjectItem(jsonSlave, "slaves"));
+        pRefs[nRefs].jsonNode = jsonSlave;
+        nRefs++;
+    }
+    qsort(pRefs, nRefs, sizeof(SLAVE_REF), CompareSlaves);
+    *pnRefs = nRefs;
+    return pRefs;
+}
+
+
+WINBOOL GetSlavesDigest(cJSON* jsonSlaves, HASH_ALG alg, HASH_DIGEST* pDigest) {
+    /**
+     * @brief Compute directory hash from its slaves in HashTree (see dirhash.h)
+     *
+     * @details Directory hash needs a hash of every slave: FALSE if any has none (could not be read
+     *  at snapshot) or it is malformed
+     */
+    HASH_CTX ctx;
+    HASH_DIGEST digest;
+    size_t cbDigest = Hash_DigestLen(alg);
+    int nRefs;
+    BOOL isOk = TRUE;
+
+    SLAVE_REF* pRefs = SortSlaves(jsonSlaves, &nRefs);
+    if (!pRefs) return FALSE;
+
+    Hash_Init(&ctx, alg);
+    for (int i = 0; i < nRefs && isOk; i++) {
+        UpdateEntryName(&ctx, pRefs[i].szName, pRefs[i].isDirectory);
+
+        cJSON* jsonHash = cJSON_GetObjectItem(pRefs[i].jsonNode, "hash");
+        isOk = jsonHash && cJSON_IsString(jsonHash) && Hash_Decode(cJSON_GetStringValue(jsonHash), cbDigest, &digest);
+        if (isOk) Hash_Update(&ctx, digest.b, cbDigest);
+    }
+
+    memset(pDigest, 0, sizeof(*pDigest));
+    Hash_Final(&ctx, pDigest->b);
+    free(pRefs);
+    return isOk;
+}
+
+
+WINBOOL GetSlavesMeta(cJSON* jsonSlaves, HASH_ALG alg, HASH_DIGEST* pDigest) {
+    /**
+     * @brief Compute directory meta from its slaves in HashTree: same sum as WalkDirMeta over listings,
+     *  over metadata recorded in file nodes and meta of folder nodes
+     *
+     * @details FALSE if any slave has none (older lists) or it is malformed
+     */
+    HASH_CTX ctx;
+    HASH_DIGEST digest;
+    FILE_META meta;
+    size_t cbDigest = Hash_DigestLen(alg);
+    int nRefs;
+    BOOL isOk = TRUE;
+
+    SLAVE_REF* pRefs = SortSlaves(jsonSlaves, &nRefs);
+    if (!pRefs) return FALSE;
+
+    Hash_Init(&ctx, alg);
+    for (int i = 0; i < nRefs && isOk; i++) {
+        UpdateEntryName(&ctx, pRefs[i].szName, pRefs[i].isDirectory);
+
+        if (pRefs[i].isDirectory) {
+            cJSON* jsonMeta = cJSON_GetObjectItem(pRefs[i].jsonNode, "meta");
+            isOk = jsonMeta && cJSON_IsString(jsonMeta) && Hash_Decode(cJSON_GetStringValue(jsonMeta), cbDigest, &digest);
+            if (isOk) Hash_Update(&ctx, digest.b, cbDigest);
+        }
+        else if ((isOk = GetNodeFileMeta(pRefs[i].jsonNode, &meta))) {
+            UpdateLE(&ctx, meta.cbSize, 8);
+            UpdateLE(&ctx, meta.ftWrite, 8);
+            UpdateLE(&ctx, meta.ftChange, 8);
+            UpdateLE(&ctx, meta.dwVolume, 4);
+            UpdateLE(&ctx, meta.qwIndex, 8);
+        }
+    }
+
+    memset(pDigest, 0, sizeof(*pDigest));
+    Hash_Final(&ctx, pDigest->b);
+    free(pRefs);
+    return isOk;
+}
+
+
+static BOOL IsSameHash(cJSON* jsonA, cJSON* jsonB) {
+    // Text compare: both trees of one object, written in same encoding
+    cJSON* jsonHashA = cJSON_GetObjectItem(jsonA, "hash");
+    cJSON* jsonHashB = cJSON_GetObjectItem(jsonB, "hash");
+    return jsonHashA && jsonHashB && cJSON_IsString(jsonHashA) && cJSON_IsString(jsonHashB) &&
+           !_tcscmp(cJSON_GetStringValue(jsonHashA), cJSON_GetStringValue(jsonHashB));
+}
+
+
+void CountTreeChanges(cJSON* jsonOld, cJSON* jsonNew, TREE_CHANGES* pChanges) {
+    /**
+     * @brief Count items changed between two file snapshots of one object. Added to pChanges
+     *
+     * @details Folders of equal hash are skipped whole, so work is proportional to changes,
+     *  not tree size. Items of differing folders are matched by name in one sorted merge.
+     *  An added or removed folder counts as one item. A file replaced by a folder (or back)
+     *  counts as removed and added
+     */
+    SLAVE_REF *pOld, *pNew;
+    int nOld, nNew, i = 0, j = 0;
+
+    if (IsSameHash(jsonOld, jsonNew)) return;
+
+    pOld = SortSlaves(cJSON_GetObjectItem(jsonOld, "slaves"), &nOld);
+    pNew = SortSlaves(cJSON_GetObjectItem(jsonNew, "slaves"), &nNew);
+    if (!pOld || !pNew) {
+        // File (or unreadable folder): changed as a whole
+        if (!pOld && !pNew) pChanges->nModified++;
+        else {
+            pChanges->nRemoved++;
+            pChanges->nAdded++;
+        }
+        free(pOld);
+        free(pNew);
+        return;
+    }
+
+    while (i < nOld || j < nNew) {
+        int cmp = i == nOld ? 1 : j == nNew ? -1 : _tcscmp(pOld[i].szName, pNew[j].szName);
+        if (cmp < 0) {
+            pChanges->nRemoved++;
+            i++;
+        }
+        else if (cmp > 0) {
+            pChanges->nAdded++;
+            j++;
+        }
+        else {
+            if (pOld[i].isDirectory == pNew[j].isDirectory)
+                CountTreeChanges(pOld[i].jsonNode, pNew[j].jsonNode, pChanges);
+            else {
+                pChanges->nRemoved++;
+                pChanges->nAdded++;
+            }
+            i++;
+            j++;
+        }
+    }
+
+    free(pOld);
+    free(pNew);
+}
+
+
+static void ClassifyMatch(DIR_DIFF* pDiff, const DIR_ENTRY* pEntry, const SLAVE_REF* pRef) {
+    /**
+     * @brief Entry found in both: tell type change, and what listing alone says of a file
+     */
+    FILE_META expected, actual;
+
+    if (pEntry->info.isDirectory != pRef->isDirectory)
+        pDiff->kind = DIR_DIFF_TYPE_CHANGED;
+    else if (pEntry->info.isDirectory || !GetNodeFileMeta(pDiff->jsonNode, &expected))
+        pDiff->kind = DIR_DIFF_MATCHED;
+    else {
+        CopyFileMeta(&pEntry->info, &actual);
+
+        if (expected.cbSize != actual.cbSize)        pDiff->kind = DIR_DIFF_MODIFIED;
+        else if (IsSameFileMeta(&expected, &actual)) pDiff->kind = DIR_DIFF_SAME_META;
+        else                                         pDiff->kind = DIR_DIFF_MATCHED;
+    }
+}
+
+
+WINBOOL DiffDirectory(HANDLE hDir, cJSON* jsonSlaves, DIR_DIFF_FN pfnDiff, LPVOID pArg) {
+    /**
+     * @brief Compare listing of open directory with its HashNode's slaves, calling pfnDiff for each entry
+     *
+     * @details Directory is listed once (see ReadListing), listing and slaves are sorted by name
+     *  and merged in one pass: O(n log n) for n entries, no file is opened. Entries come in
+     *  name order. FALSE if directory could not be listed (pfnDiff not called)
+     */
+    DIR_ENTRY* pEntries;
+    size_t nEntries, i = 0;
+    LPTSTR szPool;
+    int nRefs, j = 0;
+
+    SLAVE_REF* pRefs = SortSlaves(jsonSlaves, &nRefs);
+    if (!pRefs) return FALSE;
+
+    if (!ReadListing(hDir, &pEntries, &nEntries, &szPool)) {
+        free(pRefs);
+        return FALSE;
+    }
+    qsort(pEntries, nEntries, sizeof(DIR_ENTRY), CompareEntries);
+
+    while (i < nEntries || j < nRefs) {
+        DIR_DIFF diff;
+        int cmp = (i == nEntries) ? 1 : (j == nRefs) ? -1 : _tcscmp(pEntries[i].szName, pRefs[j].szName);
+
+        if (cmp < 0) {
+            diff.kind = DIR_DIFF_ADDED;
+            diff.szName = pEntries[i].szName;
+            diff.isDirectory = pEntries[i].info.isDirectory;
+            diff.jsonNode = NULL;
+            diff.pInfo = &pEntries[i].info;
+            i++;
+        }
+        else if (cmp > 0) {
+            diff.kind = DIR_DIFF_REMOVED;
+            diff.szName = pRefs[j].szName;
+            diff.isDirectory = pRefs[j].isDirectory;
+            diff.jsonNode = pRefs[j].jsonNode;
+            diff.pInfo = NULL;
+            j++;
+        }
+        else {
+            diff.szName = pRefs[j].szName;
+            diff.isDirectory = pEntries[i].info.isDirectory;
+            diff.jsonNode = pRefs[j].jsonNode;
+            diff.pInfo = &pEntries[i].info;
+            ClassifyMatch(&diff, &pEntries[i], &pRefs[j]);
+            i++;
+            j++;
+        }
+        pfnDiff(&diff, pArg);
+    }
+
+    free(pEntries);
+    free(szPool);
+    free(pRefs);
+    return TRUE;
+}
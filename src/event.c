@@ -1,7 +1,25 @@
+#include <stdlib.h>
+#include <tchar.h>
 #include "event.h"
 
 #define SVC_EVENT_CODE 0
 
+// First capacity of report log, doubled as needed
+#define REPORT_LOG_LEN 16
+
+
+typedef struct {
+    WORD wType;
+    LPTSTR szMsg;               // or NULL, for nested log
+    REPORT_LOG* pNested;
+} REPORT_ITEM;
+
+struct REPORT_LOG {
+    REPORT_ITEM* pItems;
+    size_t nItems;
+    size_t nAlloc;
+};
+
 
 void SvcReportEvent(WORD wType, LPCTSTR szEventMsg) {
     /**
@@ -28,4 +46,80 @@ void SvcReportEvent(WORD wType, LPCTSTR szEventMsg) {
 
         DeregisterEventSource(hEventSource);
     }
-}
\ No newline at end of file
+}
+
+
+REPORT_LOG* ReportLogCreate() {
+    /**
+     * @brief Allocate empty log. NULL if out of memory: reports then go to Event Log directly
+     */
+    return calloc(1, sizeof(REPORT_LOG));
+}
+
+
+static REPORT_ITEM* ReportLogAppend(REPORT_LOG* pLog) {
+    if (pLog->nItems == pLog->nAlloc) {
+        size_t nAlloc = pLog->nAlloc ? pLog->nAlloc * 2 : REPORT_LOG_LEN;
+        REPORT_ITEM* pItems = realloc(pLog->pItems, nAlloc * sizeof(REPORT_ITEM));
+        if (!pItems) return NULL;
+        pLog->pItems = pItems;
+        pLog->nAlloc = nAlloc;
+    }
+    return &pLog->pItems[pLog->nItems++];
+}
+
+
+void ReportLogAdd(REPORT_LOG* pLog, WORD wType, LPCTSTR szEventMsg) {
+    /**
+     * @brief Keep message in log. Without log (or memory), message is written at once
+     */
+    LPTSTR szMsg = pLog ? _tcsdup(szEventMsg) : NULL;
+    REPORT_ITEM* pItem = szMsg ? ReportLogAppend(pLog) : NULL;
+
+    if (!pItem) {
+        free(szMsg);
+        SvcReportEvent(wType, szEventMsg);
+        return;
+    }
+    pItem->wType = wType;
+    pItem->szMsg = szMsg;
+    pItem->pNested = NULL;
+}
+
+
+REPORT_LOG* ReportLogNest(REPORT_LOG* pLog) {
+    /**
+     * @brief Make nested log at current end of pLog, written in its place
+     *
+     * @details NULL if out of memory (or no pLog): its reports then go to Event Log directly
+     */
+    REPORT_ITEM* pItem;
+    REPORT_LOG* pNested;
+
+    if (!pLog || !(pNested = ReportLogCreate())) return NULL;
+    if (!(pItem = ReportLogAppend(pLog))) {
+        free(pNested);
+        return NULL;
+    }
+    pItem->wType = 0;
+    pItem->szMsg = NULL;
+    pItem->pNested = pNested;
+    return pNested;
+}
+
+
+void ReportLogFlush(REPORT_LOG* pLog) {
+    /**
+     * @brief Write log to Event Log in order, nested logs in place, and free it
+     */
+    if (!pLog) return;
+    for (size_t i = 0; i < pLog->nItems; i++) {
+        if (pLog->pItems[i].pNested) ReportLogFlush(pLog->pItems[i].pNested);
+        else {
+            SvcReportEvent(pLog->pItems[i].wType, pLog->pItems[i].szMsg);
+            free(pLog->pItems[i].szMsg);
+        }
+    }
+    free(pLog->pItems);
+    free(pLog);
+}
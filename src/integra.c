@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <tchar.h>
-#include "md5.h"
+#include "digest.h"
+#include "throttle.h"
 #include "cfg.h"
 #include "event.h"
 #include "utils.h"
@@ -9,9 +10,245 @@
 
 #define BUF_LEN 256
 
+// CDC file mismatch: changed byte ranges named in report, at most
+#define REPORT_MAX_RANGES 4
+
+// Position of check in Parameters (see SaveCheckCursor)
+#define CURSOR_FULL _T("full")
+#define CURSOR_QUICK _T("quick")
+#define CURSOR_DONE _T(".")
+#define CURSOR_START _T("*")
+#define CURSOR_STRINGS 4
+
+#define NOT_FOUND (-1)
+
 CRITICAL_SECTION csVerification;
 
 
+/*
+ *  Files of one directory waiting to be hashed together (see Hash_FileDigestBatch)
+ */
+typedef struct {
+    VERIFY_CONTEXT* pCtx;
+    const OBJECT_OPTIONS* pOptions;
+    REPORT_LOG* pLog;
+    DWORD nFiles;
+    HANDLE rghFiles[HASH_BATCH_SIZE];
+    HASH_DIGEST rgExpected[HASH_BATCH_SIZE];
+    LPCTSTR szDirPath;                  // files are named by it and their node's name, in reports
+    LPCTSTR rgszNames[HASH_BATCH_SIZE];
+    cJSON* rgJsonNodes[HASH_BATCH_SIZE];
+    HASH_NODE_INFO rgInfo[HASH_BATCH_SIZE];     // metadata of files, taken before they are read
+} VERIFY_BATCH;
+
+
+/*
+ *  Slice of a check (see VerifyObjectListSlice): objects are verified until stop is signaled or deadline passes
+ */
+typedef struct {
+    HANDLE hStop;               // or NULL
+    ULONGLONG ullDeadline;      // GetTickCount64() time, or 0: none
+    volatile LONG hasTaken;     // slice verified something already: it may be cut
+} VERIFY_SLICE;
+
+
+/*
+ *  Part of one object verified in a slice: items from szResume on in tree order (see CompareSubPaths),
+ *  until slice is over
+ */
+typedef struct {
+    VERIFY_SLICE* pSlice;
+    LPCTSTR szResume;           // path relative to object. NULL: from its start
+    LPTSTR szCut;               // first item left for next slice, if cut short. Allocated
+    LPTSTR szTaken;             // first item verified: only items after it are cut. Allocated
+    BOOL isStarted;             // object was reached: if not, it is left to next slice whole
+    CRITICAL_SECTION csSpan;    // cut and first item move back, whichever thread reaches them
+} VERIFY_SPAN;
+
+
+/*
+ *  One verification run over a list of objects: reports of objects are written in list order,
+ *  each one as soon as it and all objects before it are verified (see CompleteVerifyObject)
+ */
+typedef struct VERIFY_RUN {
+    BOOL isFullCheck;
+    VERIFY_SPAN* rgSpans;       // span of each object in a slice. NULL: objects are verified whole
+    int nObjects;
+    REPORT_LOG** rgpLogs;
+    cJSON** rgjsonActual;       // actual state of each object, once verified (see StoreActualState)
+    BOOL* rgIsDone;
+    int iNextFlush;
+    CRITICAL_SECTION csFlush;
+} VERIFY_RUN;
+
+
+/*
+ *  Task of verification pool (see RunVerifyTask): an object, or a sub-folder of one
+ */
+typedef struct {
+    cJSON* jsonNode;            // object, or HashNode of sub-folder
+    int iObject;                // object: index in list
+    VERIFY_CONTEXT* pCtx;       // sub-folder: context of its object. NULL for object
+    HANDLE hBase;               // sub-folder: duplicate of its parent's handle, closed when done
+    REPORT_LOG* pLog;           // sub-folder: its place in object's reports
+    LPTSTR szPath;              // sub-folder: its own path, for reports
+} VERIFY_TASK;
+
+
+/*
+ *  Folder being verified, for each entry of its diff (see VerifyDiffEntry)
+ */
+typedef struct {
+    VERIFY_CONTEXT* pCtx;
+    REPORT_LOG* pLog;
+    HASH_WORKER* pWorker;
+    VERIFY_BATCH* pBatch;       // files of folder. NULL if out of memory
+    HANDLE hDir;
+    HASH_PATH_BUF* pPath;       // path of folder, names of its items appended in turn
+    LPCTSTR szPath;             // path of folder alone
+} VERIFY_FOLDER;
+
+
+static void VerifyObjectContext(cJSON* jsonObject, VERIFY_CONTEXT* pCtx, HASH_WORKER* pWorker);
+static void VerifyNodeFileBatched(cJSON* jsonNode, HANDLE hBase, LPCTSTR szPath, const HASH_NODE_INFO* pInfo,
+                                  VERIFY_CONTEXT* pCtx, REPORT_LOG* pLog, VERIFY_BATCH* pBatch, HASH_WORKER* pWorker);
+static void VerifyDiffEntry(const DIR_DIFF* pDiff, LPVOID pArg);
+static void VerifySlave(VERIFY_FOLDER* pFolder, cJSON* jsonSlave, BOOL isDirectory, const HASH_NODE_INFO* pInfo);
+
+
+static void ReportChangedRanges(REPORT_LOG* pLog, LPCTSTR szPath, const HASH_CDC_CHUNK* pExpected, size_t nExpected,
+                                const HASH_CDC_CHUNK* pActual, size_t nActual) {
+    /**
+     * @brief Report mismatch of file with CDC digest, naming byte ranges that changed (see Hash_CdcDiff)
+     */
+    TCHAR buf[BUF_LEN];
+    HASH_CDC_RANGE rgRanges[REPORT_MAX_RANGES];
+    size_t nRanges = Hash_CdcDiff(pExpected, nExpected, pActual, nActual, rgRanges, REPORT_MAX_RANGES);
+    int cch;
+
+    if (!nRanges) {
+        snprintf(buf, BUF_LEN-1, "File '%s': Modified (data removed or reordered)", szPath);
+        ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+        return;
+    }
+
+    cch = snprintf(buf, BUF_LEN-1, "File '%s': Modified (changed bytes", szPath);
+    for (size_t i = 0; i < nRanges && i < REPORT_MAX_RANGES && cch < BUF_LEN-1; i++)
+        cch += snprintf(buf + cch, BUF_LEN-1 - cch, "%s %llu-%llu", i ? "," : ":",
+                        rgRanges[i].cbOffset, rgRanges[i].cbOffset + rgRanges[i].cbSize - 1);
+    if (nRanges > REPORT_MAX_RANGES && cch < BUF_LEN-1)
+        cch += snprintf(buf + cch, BUF_LEN-1 - cch, " and %zu more", nRanges - REPORT_MAX_RANGES);
+    if (cch < BUF_LEN-1)
+        snprintf(buf + cch, BUF_LEN-1 - cch, ")");
+    ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+}
+
+
+static LPCTSTR GetSubPath(const VERIFY_CONTEXT* pCtx, LPCTSTR szPath) {
+    /**
+     * @brief Path of item relative to object, from its path in reports
+     */
+    LPCTSTR szRel = _tcslen(szPath) > pCtx->cchRoot ? szPath + pCtx->cchRoot : _T("");
+    if (*szRel == '\\') szRel++;
+    return szRel;
+}
+
+
+static void NoteActualState(VERIFY_CONTEXT* pCtx, LPCTSTR szPath, LPCTSTR szName, LPCTSTR szState, cJSON* jsonNode) {
+    /**
+     * @brief Record mismatched item for accept (see AcceptObjectInOL): its path relative to object, its state,
+     *  and its actual node, if verification computed one (NULL if not: accept reads item again)
+     *
+     * @details szPath is item's path in reports, or its folder's if szName is set. Takes jsonNode over.
+     *  Dropped if out of memory
+     */
+    LPCTSTR szRel = GetSubPath(pCtx, szPath);
+
+    size_t cchRelPath = _tcslen(szRel) + (szName ? _tcslen(szName) + 1 : 0) + 1;
+    LPTSTR szRelPath = malloc(cchRelPath * sizeof(TCHAR));
+    cJSON* jsonEntry = cJSON_CreateObject();
+    if (!szRelPath || !jsonEntry) {
+        free(szRelPath);
+        cJSON_Delete(jsonEntry);
+        cJSON_Delete(jsonNode);
+        return;
+    }
+    if (!szName) _tcscpy(szRelPath, szRel);
+    else snprintf(szRelPath, cchRelPath, *szRel ? "%s\\%s" : "%s%s", szRel, szName);
+
+    cJSON_AddStringToObject(jsonEntry, "path", szRelPath);
+    cJSON_AddStringToObject(jsonEntry, "state", szState);
+    if (jsonNode) cJSON_AddItemToObject(jsonEntry, "node", jsonNode);
+    free(szRelPath);
+
+    EnterCriticalSection(&pCtx->csActual);
+    cJSON_AddItemToArray(pCtx->jsonActual, jsonEntry);
+    LeaveCriticalSection(&pCtx->csActual);
+}
+
+
+static cJSON* MakeActualNode(cJSON* jsonNode, const HASH_NODE_INFO* pInfo, const HASH_DIGEST* pActual, const OBJECT_OPTIONS* pOptions) {
+    /**
+     * @brief File node as verification found it: actual metadata and hash, and what was verified equal
+     *  (sample) or tells how hash was computed (tree chunk). NULL if out of memory
+     */
+    static const LPCTSTR rgszKept[] = {_T("sample"), _T("tree_chunk")};
+    TCHAR szHash[HASH_TEXT_BUF_LEN];
+    FILE_META meta;
+
+    cJSON* jsonActual = cJSON_CreateObject();
+    if (!jsonActual) return NULL;
+
+    CopyFileMeta(pInfo, &meta);
+    AddFileMetaToNode(jsonActual, &meta);
+    Hash_Encode(pActual, Hash_DigestLen(pOptions->alg), pOptions->enc, szHash);
+    cJSON_AddStringToObject(jsonActual, "hash", szHash);
+
+    for (int i = 0; i < sizeof(rgszKept) / sizeof(rgszKept[0]); i++) {
+        cJSON* jsonItem = cJSON_GetObjectItem(jsonNode, rgszKept[i]);
+        if (jsonItem) cJSON_AddItemToObject(jsonActual, rgszKept[i], cJSON_Duplicate(jsonItem, TRUE));
+    }
+    return jsonActual;
+}
+
+
+static void FlushVerifyBatch(VERIFY_BATCH* pBatch) {
+    /**
+     * @brief Hash pending files, compare against expected hashes, close handles
+     */
+    TCHAR buf[BUF_LEN];
+    HASH_DIGEST rgActual[HASH_BATCH_SIZE];
+    DWORD rgdwStatus[HASH_BATCH_SIZE];
+    size_t cbDigest = Hash_DigestLen(pBatch->pOptions->alg);
+
+    if (!pBatch->nFiles) return;
+
+    Hash_FileDigestBatch(pBatch->pOptions->alg, pBatch->pOptions->scan, pBatch->rghFiles, pBatch->nFiles, rgActual, rgdwStatus);
+
+    for (DWORD i = 0; i < pBatch->nFiles; i++) {
+        CloseHandle(pBatch->rghFiles[i]);
+
+        if (rgdwStatus[i] != ERROR_SUCCESS) {
+            snprintf(buf, BUF_LEN-1, "File '%s\\%s': Could not compute hash", pBatch->szDirPath, pBatch->rgszNames[i]);
+            ReportLogAdd(pBatch->pLog, EVENTLOG_WARNING_TYPE, buf);
+            continue;
+        }
+        if (!Hash_Equal(&pBatch->rgExpected[i], &rgActual[i], cbDigest)) {
+            snprintf(buf, BUF_LEN-1, "File '%s\\%s': Modified (hash mismatch)", pBatch->szDirPath, pBatch->rgszNames[i]);
+            ReportLogAdd(pBatch->pLog, EVENTLOG_WARNING_TYPE, buf);
+            NoteActualState(pBatch->pCtx, pBatch->szDirPath, pBatch->rgszNames[i], _T("modified"),
+                            MakeActualNode(pBatch->rgJsonNodes[i], &pBatch->rgInfo[i], &rgActual[i], pBatch->pOptions));
+            continue;
+        }
+#ifdef REPORT_SUCCESSFUL_CHECKS
+        snprintf(buf, BUF_LEN-1, "Path '%s\\%s': OK", pBatch->szDirPath, pBatch->rgszNames[i]);
+        ReportLogAdd(pBatch->pLog, EVENTLOG_INFORMATION_TYPE, buf);
+#endif
+    }
+    pBatch->nFiles = 0;
+}
+
+
 void NotificationLoopThread(HANDLE stopEvent) {
     /**
      * @brief Thread for registering and processing Change Notifications
@@ -92,7 +329,7 @@ void NotificationLoopThread(HANDLE stopEvent) {
             SvcReportEvent(EVENTLOG_INFORMATION_TYPE, buf);
             cJSON* jsonArrItem = cJSON_GetArrayItem(jsonObjectList, (int) dwObjIndex);
             EnterCriticalSection(&csVerification);
-            VerifyObject(jsonArrItem);
+            VerifyObject(jsonArrItem, FALSE);
             LeaveCriticalSection(&csVerification);
             if (FindNextChangeNotification(lpChangeHandles[dwObjIndex]) == FALSE) {
                 SvcReportEvent(EVENTLOG_WARNING_TYPE, "FindNextChangeNotification failed. Monitoring for the object is on timer now.");
@@ -110,20 +347,233 @@ void NotificationLoopThread(HANDLE stopEvent) {
 }
 
 
-void ServiceLoop(HANDLE stopEvent) {
+static void FreeCheckCursor(VERIFY_CURSOR* pCursor) {
+    /**
+     * @brief Drop positions of objects: next check starts from start of each
+     */
+    for (DWORD i = 0; i < pCursor->nObjects; i++) {
+        free(pCursor->rgPositions[i].szName);
+        free(pCursor->rgPositions[i].szPath);
+        free(pCursor->rgPositions[i].szEntry);
+    }
+    free(pCursor->rgPositions);
+    pCursor->rgPositions = NULL;
+    pCursor->nObjects = 0;
+}
+
+
+static int FindPosition(const VERIFY_CURSOR* pCursor, cJSON* jsonObject) {
+    /**
+     * @brief Index of object's position in cursor: same name, type and path. NOT_FOUND if it has none
+     */
+    LPCTSTR szName = cJSON_GetStringValue(cJSON_GetObjectItem(jsonObject, "object_name"));
+    LPCTSTR szPath = cJSON_GetStringValue(cJSON_GetObjectItem(jsonObject, "path"));
+    cJSON* jsonType = cJSON_GetObjectItem(jsonObject, "type");
+    if (!szName || !szPath || !cJSON_IsNumber(jsonType)) return NOT_FOUND;
+
+    for (DWORD i = 0; i < pCursor->nObjects; i++) {
+        const VERIFY_POSITION* pPosition = &pCursor->rgPositions[i];
+        if (pPosition->szName && pPosition->szPath && !_tcscmp(pPosition->szName, szName) &&
+            !_tcscmp(pPosition->szPath, szPath) && pPosition->dwType == (DWORD) cJSON_GetNumberValue(jsonType))
+            return (int) i;
+    }
+    return NOT_FOUND;
+}
+
+
+static BOOL MatchCheckCursor(VERIFY_CURSOR* pCursor, cJSON* jsonObjectList) {
+    /**
+     * @brief Line positions up with objects of list, matched by name, type and path (see FindPosition)
+     *
+     * @details Objects added to list since cursor was saved start from their start, positions of removed
+     *  or changed ones are dropped. FALSE if out of memory: cursor is left as it was
+     */
+    int nObjects = cJSON_GetArraySize(jsonObjectList);
+    VERIFY_POSITION* rgPositions = calloc(nObjects ? nObjects : 1, sizeof(VERIFY_POSITION));
+    cJSON* jsonObject;
+    int i = 0;
+    if (!rgPositions) return FALSE;
+
+    cJSON_ArrayForEach(jsonObject, jsonObjectList) {
+        VERIFY_POSITION* pPosition = &rgPositions[i++];
+        int index = FindPosition(pCursor, jsonObject);
+        if (index != NOT_FOUND) {
+            *pPosition = pCursor->rgPositions[index];
+            memset(&pCursor->rgPositions[index], 0, sizeof(VERIFY_POSITION));
+            continue;
+        }
+
+        // Without its name and path, position is not saved: object starts over after a restart
+        LPCTSTR szName = cJSON_GetStringValue(cJSON_GetObjectItem(jsonObject, "object_name"));
+        LPCTSTR szPath = cJSON_GetStringValue(cJSON_GetObjectItem(jsonObject, "path"));
+        cJSON* jsonType = cJSON_GetObjectItem(jsonObject, "type");
+        pPosition->szName = szName ? _tcsdup(szName) : NULL;
+        pPosition->szPath = szPath ? _tcsdup(szPath) : NULL;
+        pPosition->dwType = cJSON_IsNumber(jsonType) ? (DWORD) cJSON_GetNumberValue(jsonType) : 0;
+    }
+
+    FreeCheckCursor(pCursor);
+    pCursor->rgPositions = rgPositions;
+    pCursor->nObjects = (DWORD) nObjects;
+    return TRUE;
+}
+
+
+static BOOL LoadCheckCursor(VERIFY_CURSOR* pCursor) {
+    /**
+     * @brief Read position of check in progress from Parameters (see SaveCheckCursor). FALSE if there is none
+     */
+    LPTSTR mszCursor = GetCheckCursor();
+    if (!mszCursor) return FALSE;
+
+    DWORD nStrings = 0;
+    for (LPTSTR p = mszCursor; *p; p += _tcslen(p) + 1) nStrings++;
+    DWORD nObjects = nStrings ? (nStrings - 1) / CURSOR_STRINGS : 0;
+    VERIFY_POSITION* rgPositions = nObjects ? calloc(nObjects, sizeof(VERIFY_POSITION)) : NULL;
+    if (nObjects && !rgPositions) {
+        free(mszCursor);
+        return FALSE;
+    }
+
+    // Check mode first, then name, type, path and position of each object
+    LPTSTR p = mszCursor;
+    FreeCheckCursor(pCursor);
+    pCursor->isFullCheck = !_tcscmp(p, CURSOR_FULL);
+    pCursor->rgPositions = rgPositions;
+    p += _tcslen(p) + 1;
+    for (DWORD i = 0; i < nObjects; i++) {
+        VERIFY_POSITION* pPosition = &rgPositions[pCursor->nObjects++];
+        pPosition->szName = _tcsdup(p);
+        p += _tcslen(p) + 1;
+        pPosition->dwType = _tcstoul(p, NULL, 10);
+        p += _tcslen(p) + 1;
+        pPosition->szPath = _tcsdup(p);
+        p += _tcslen(p) + 1;
+        pPosition->isDone = !_tcscmp(p, CURSOR_DONE);
+        if (!pPosition->isDone && _tcscmp(p, CURSOR_START)) pPosition->szEntry = _tcsdup(p);
+        p += _tcslen(p) + 1;
+    }
+    free(mszCursor);
+    return TRUE;
+}
+
+
+static LPCTSTR GetPositionString(const VERIFY_POSITION* pPosition) {
+    if (pPosition->isDone) return CURSOR_DONE;
+    return pPosition->szEntry ? pPosition->szEntry : CURSOR_START;
+}
+
+
+static void SaveCheckCursor(const VERIFY_CURSOR* pCursor) {
+    /**
+     * @brief Save position of check in progress in Parameters, all in one value (see SetCheckCursor)
+     *
+     * @details Strings: check mode (full or quick), then name, type, path and position of each object:
+     *  done, from start, or path of first item not verified yet. Neither mark is a valid path.
+     *  Objects are matched by name, type and path when check resumes (see MatchCheckCursor)
+     */
+    TCHAR szType[16];
+    size_t cchCursor = _tcslen(CURSOR_QUICK) + 2;
+    for (DWORD i = 0; i < pCursor->nObjects; i++) {
+        const VERIFY_POSITION* pPosition = &pCursor->rgPositions[i];
+        if (!pPosition->szName || !*pPosition->szName || !pPosition->szPath || !*pPosition->szPath) continue;
+        cchCursor += _tcslen(pPosition->szName) + _tcslen(pPosition->szPath) + _tcslen(GetPositionString(pPosition)) +
+                     sizeof(szType) / sizeof(TCHAR) + 4;
+    }
+
+    LPTSTR mszCursor = malloc(cchCursor * sizeof(TCHAR));
+    if (!mszCursor) {
+        SvcReportEvent(EVENTLOG_WARNING_TYPE, "Could not save position of check: Out of memory");
+        return;
+    }
+
+    LPTSTR p = mszCursor;
+    _tcscpy(p, pCursor->isFullCheck ? CURSOR_FULL : CURSOR_QUICK);
+    p += _tcslen(p) + 1;
+    for (DWORD i = 0; i < pCursor->nObjects; i++) {
+        const VERIFY_POSITION* pPosition = &pCursor->rgPositions[i];
+        if (!pPosition->szName || !*pPosition->szName || !pPosition->szPath || !*pPosition->szPath) continue;
+        snprintf(szType, sizeof(szType) / sizeof(TCHAR), "%lu", pPosition->dwType);
+        LPCTSTR rgszStrings[CURSOR_STRINGS] = {pPosition->szName, szType, pPosition->szPath, GetPositionString(pPosition)};
+        for (int j = 0; j < CURSOR_STRINGS; j++) {
+            _tcscpy(p, rgszStrings[j]);
+            p += _tcslen(p) + 1;
+        }
+    }
+    *p = '\0';
+
+    if (!SetCheckCursor(mszCursor))
+        SvcReportEvent(EVENTLOG_WARNING_TYPE, "Could not save position of check");
+    free(mszCursor);
+}
+
+
+static double GetCheckProgress(cJSON* jsonObjectList, const VERIFY_CURSOR* pCursor) {
+    /**
+     * @brief Part of check done at cursor, 0 to 1: objects done, and entries of root folder passed in others
+     */
+    int nObjects = cJSON_GetArraySize(jsonObjectList);
+    cJSON* jsonObject;
+    double fDone = 0;
+    if (!nObjects) return 1;
+
+    cJSON_ArrayForEach(jsonObject, jsonObjectList) {
+        int index = FindPosition(pCursor, jsonObject);
+        if (index == NOT_FOUND) continue;
+        const VERIFY_POSITION* pPosition = &pCursor->rgPositions[index];
+        if (pPosition->isDone) {
+            fDone++;
+            continue;
+        }
+
+        cJSON* jsonSlaves = cJSON_GetObjectItem(cJSON_GetObjectItem(jsonObject, "root"), "slaves");
+        int nSlaves = cJSON_GetArraySize(jsonSlaves);
+        if (pPosition->szEntry && nSlaves) {
+            cJSON* jsonSlave;
+            int nDone = 0;
+            cJSON_ArrayForEach(jsonSlave, jsonSlaves) {
+                LPCTSTR szName = cJSON_GetStringValue(cJSON_GetObjectItem(jsonSlave, "name"));
+                if (szName && CompareSubPaths(szName, pPosition->szEntry) < 0 && !IsAtOrUnder(pPosition->szEntry, szName)) nDone++;
+            }
+            fDone += (double) nDone / nSlaves;
+        }
+    }
+    return fDone / nObjects;
+}
+
+
+void ServiceLoop(HANDLE stopEvent, BOOL isFullCheck) {
     /**
      * @brief Main loop for service. Truly main.
      *
      * @details sleep for delay, then perform hash check based on object list (path in registry, cfg.h)
      *  Can be run manually (outside of service): call with stopEvent = INTEGRA_CHECK_ONCE
+     *
+     *  First check is full if isFullCheck is set. After that, a full check (every file hashed,
+     *  see CHECK_METADATA) is made once per full check interval
+     *
+     *  Service checks in slices of Parameters/CheckSliceMS (see VerifyObjectListSlice): each slice starts
+     *  when its share of the interval is due, so a check is spread over the whole interval instead of
+     *  running in one burst. Without it, a check runs at once and the next starts an interval after it ends.
+     *  Either way, a check is cut short on stop, and its position saved (see SaveCheckCursor): the service
+     *  resumes it on start
+     *
+     *  Service reads are throttled by Parameters/Throttle* (see throttle.h): bytes/s, files/s, and
+     *  adaptive backoff while system is busy. Manual checks run at full speed
      */
 
     InitializeCriticalSection(&csVerification);
 
-    // Read interval from registry
+    // Read intervals from registry
     DWORD dwIntervalMs = GetCheckInterval();
     if (!dwIntervalMs) dwIntervalMs = DEFAULT_CHECK_INTERVAL_MS;
-    DWORD res, dwNumObjects;
+    DWORD dwFullIntervalMs = GetFullCheckInterval();
+    if (!dwFullIntervalMs) dwFullIntervalMs = DEFAULT_FULL_CHECK_INTERVAL_MS;
+    DWORD dwSliceMs = GetCheckSlice();
+    ULONGLONG ullNextFullCheck = GetTickCount64() + dwFullIntervalMs;
+    ULONGLONG ullCheckStart = 0;
+    BOOL hasCheckStart = FALSE;
+    DWORD res, dwWaitMs;
     HANDLE hCnThread = INVALID_HANDLE_VALUE;
 
     // Read path to OL from registry
@@ -135,10 +585,23 @@ void ServiceLoop(HANDLE stopEvent) {
         return;
     }
 
+    // Check in progress when service stopped goes on where it was
+    VERIFY_CURSOR cursor = {isFullCheck, 0, NULL};
+    if (stopEvent != INTEGRA_CHECK_ONCE && LoadCheckCursor(&cursor))
+        SvcReportEvent(EVENTLOG_INFORMATION_TYPE, "Resuming check stopped with service");
+
     // Runs as service, report params and create Change Notifications thread
     if (stopEvent != INTEGRA_CHECK_ONCE) {
         TCHAR buf[BUF_LEN];
-        snprintf(buf, BUF_LEN-1, "Service is running. Interval: %lu, List: %s", dwIntervalMs, szOlPath);
+        DWORD cbPerSec, nFilesPerSec;
+        WINBOOL isAdaptive;
+        GetCheckThrottle(&cbPerSec, &nFilesPerSec, &isAdaptive);
+        Hash_ThrottleSet(cbPerSec, nFilesPerSec, isAdaptive);
+
+        snprintf(buf, BUF_LEN-1, "Service is running. Interval: %lu, Full check: %lu, Slice: %lu, "
+                                 "Throttle: %lu B/s, %lu files/s, adaptive: %s, List: %s, SHA-256: %s",
+                 dwIntervalMs, dwFullIntervalMs, dwSliceMs, cbPerSec, nFilesPerSec, isAdaptive ? "on" : "off",
+                 szOlPath, Hash_KernelName(HASH_SHA256));
         SvcReportEvent(EVENTLOG_INFORMATION_TYPE, buf);
 #ifndef CHANGE_NOTIFICATION_DISABLE
         // Run Change Notification thread
@@ -149,14 +612,30 @@ void ServiceLoop(HANDLE stopEvent) {
     }
 
     while (TRUE) {
+        BOOL isDone = FALSE;    // List not read: check stays where it was
+        dwWaitMs = dwIntervalMs;
+
         // Read Object List
         cJSON* jsonObjectList = ReadJSON(szOlPath);
         if (jsonObjectList && cJSON_IsArray(jsonObjectList)) {
-            // Verify objects
-            dwNumObjects = cJSON_GetArraySize(jsonObjectList);
+            // Verify objects: at once, or next slice of check
             EnterCriticalSection(&csVerification);
-            for (int i = 0; i < dwNumObjects; i++)
-                VerifyObject(cJSON_GetArrayItem(jsonObjectList, i));
+            if (stopEvent == INTEGRA_CHECK_ONCE) VerifyObjectList(jsonObjectList, isFullCheck);
+            else {
+                // Resumed check is due as far as it got
+                if (!hasCheckStart) {
+                    ULONGLONG ullDone = (ULONGLONG) (dwIntervalMs * GetCheckProgress(jsonObjectList, &cursor));
+                    ullCheckStart = GetTickCount64();
+                    ullCheckStart = ullCheckStart > ullDone ? ullCheckStart - ullDone : 0;
+                    hasCheckStart = TRUE;
+                }
+                isDone = VerifyObjectListSlice(jsonObjectList, &cursor, stopEvent, dwSliceMs ? GetTickCount64() + dwSliceMs : 0);
+
+                // Cut short: next slice once check is behind its schedule. At once if it already is
+                ULONGLONG ullNow = GetTickCount64();
+                ULONGLONG ullDue = ullCheckStart + (ULONGLONG) (dwIntervalMs * (isDone ? 1 : GetCheckProgress(jsonObjectList, &cursor)));
+                if (!isDone || dwSliceMs) dwWaitMs = ullDue > ullNow ? (DWORD) (ullDue - ullNow) : 0;
+            }
             LeaveCriticalSection(&csVerification);
         }
         else SvcReportEvent(EVENTLOG_ERROR_TYPE, "Could not read JSON from OL path");
@@ -169,14 +648,27 @@ void ServiceLoop(HANDLE stopEvent) {
             return;
         }
 
+        if (isDone) {
+            ClearCheckCursor();
+
+            // Next check is full if its interval is over by then
+            isFullCheck = (GetTickCount64() + dwWaitMs >= ullNextFullCheck);
+            if (isFullCheck) ullNextFullCheck = GetTickCount64() + dwWaitMs + dwFullIntervalMs;
+
+            FreeCheckCursor(&cursor);
+            cursor.isFullCheck = isFullCheck;
+            hasCheckStart = FALSE;
+        }
+
         // Sleep for Check Delay while listening for stop signal
-        res = WaitForSingleObject(stopEvent, dwIntervalMs);
+        res = WaitForSingleObject(stopEvent, dwWaitMs);
         if (res != WAIT_TIMEOUT) {
             if (hCnThread != INVALID_HANDLE_VALUE) {
                 DWORD dwWaitStatus = WaitForSingleObject(hCnThread, 3000);
                 if (dwWaitStatus == WAIT_TIMEOUT) TerminateThread(hCnThread, ERROR_TIMEOUT);
                 CloseHandle(hCnThread);
             }
+            FreeCheckCursor(&cursor);
             DeleteCriticalSection(&csVerification);
             return;
         }
@@ -186,28 +678,433 @@ void ServiceLoop(HANDLE stopEvent) {
 #define ReportObjErrorAndRet() \
     do { \
         snprintf(buf, BUF_LEN - 1, "Verification for object '%s': Failed (bad JSON)", szObjectName);   \
-        SvcReportEvent(EVENTLOG_ERROR_TYPE, buf);                                           \
+        ReportLogAdd(pLog, EVENTLOG_ERROR_TYPE, buf);                                           \
         return;                                                                       \
     } while (0)
 
 
-void VerifyObject(cJSON* jsonObject) {
+static BOOL IsSliceOver(const VERIFY_SLICE* pSlice) {
+    if (pSlice->hStop && WaitForSingleObject(pSlice->hStop, 0) == WAIT_OBJECT_0) return TRUE;
+    return pSlice->ullDeadline && GetTickCount64() >= pSlice->ullDeadline;
+}
+
+
+static VERIFY_SPAN* GetVerifySpan(const VERIFY_CONTEXT* pCtx) {
+    /**
+     * @brief Part of object verified in this slice. NULL if object is verified whole
+     */
+    return pCtx->pRun->rgSpans ? &pCtx->pRun->rgSpans[pCtx->iObject] : NULL;
+}
+
+
+static BOOL IsSpanOver(LPVOID pSpan) {
+    /**
+     * @brief Stop function of object's meta walk (see WalkDirMeta): a walk never outlasts its slice
+     */
+    return IsSliceOver(((VERIFY_SPAN*) pSpan)->pSlice);
+}
+
+
+static BOOL IsAboveResume(const VERIFY_CONTEXT* pCtx, LPCTSTR szPath) {
+    /**
+     * @brief Whether folder holds the item its object resumes at: it is walked down to it, not checked whole
+     */
+    VERIFY_SPAN* pSpan = GetVerifySpan(pCtx);
+    LPCTSTR szRel = GetSubPath(pCtx, szPath);
+    return pSpan && pSpan->szResume && _tcscmp(szRel, pSpan->szResume) && IsAtOrUnder(pSpan->szResume, szRel);
+}
+
+
+static BOOL TakeItem(VERIFY_SPAN* pSpan, LPCTSTR szRelPath) {
+    /**
+     * @brief Whether item at szRelPath (relative to object) is verified in this slice (always, if pSpan is NULL)
+     *
+     * @details Items before szResume in tree order were verified by earlier slices, but folders holding it are
+     *  walked down to it. Once slice is over, items after the first one verified are left to next slice,
+     *  which resumes at first of them: pool takes folders in any order, yet each slice moves object on.
+     *  Folders are taken when listed and again when their task starts (see RunVerifyTask), so a slice
+     *  overruns by about one batch of files or listing per thread
+     */
+    BOOL isTaken = TRUE;
+    if (!pSpan) return TRUE;
+
+    if (pSpan->szResume && CompareSubPaths(szRelPath, pSpan->szResume) < 0)
+        return IsAtOrUnder(pSpan->szResume, szRelPath);
+
+    EnterCriticalSection(&pSpan->csSpan);
+    if (pSpan->szCut && CompareSubPaths(szRelPath, pSpan->szCut) >= 0) isTaken = FALSE;
+    else if (pSpan->szTaken && CompareSubPaths(szRelPath, pSpan->szTaken) > 0 && IsSliceOver(pSpan->pSlice)) {
+        // Over: next slice resumes here. If out of memory, there is nowhere to resume at: go on
+        LPTSTR szCut = _tcsdup(szRelPath);
+        if (szCut) {
+            free(pSpan->szCut);
+            pSpan->szCut = szCut;
+            isTaken = FALSE;
+        }
+    }
+    if (isTaken && (!pSpan->szTaken || CompareSubPaths(szRelPath, pSpan->szTaken) < 0)) {
+        LPTSTR szTaken = _tcsdup(szRelPath);
+        if (szTaken) {
+            free(pSpan->szTaken);
+            pSpan->szTaken = szTaken;
+        }
+    }
+    LeaveCriticalSection(&pSpan->csSpan);
+
+    if (isTaken) pSpan->pSlice->hasTaken = TRUE;
+    return isTaken;
+}
+
+
+static BOOL TakeFolderItem(VERIFY_FOLDER* pFolder, LPCTSTR szName) {
+    /**
+     * @brief Whether item of folder is verified in this slice (see TakeItem)
+     */
+    VERIFY_SPAN* pSpan = GetVerifySpan(pFolder->pCtx);
+    size_t cchMark = pFolder->pPath->cchPath;
+    if (!pSpan) return TRUE;
+
+    // Out of memory: item is verified, and reported as such
+    if (!Hash_PathPush(pFolder->pPath, szName)) return TRUE;
+    BOOL isTaken = TakeItem(pSpan, GetSubPath(pFolder->pCtx, pFolder->pPath->szPath));
+    Hash_PathPop(pFolder->pPath, cchMark);
+    return isTaken;
+}
+
+
+static void CompleteVerifyObject(VERIFY_RUN* pRun, int iObject) {
+    /**
+     * @brief Mark object verified. Write reports of every verified object with none unverified before it
+     */
+    EnterCriticalSection(&pRun->csFlush);
+    pRun->rgIsDone[iObject] = TRUE;
+    while (pRun->iNextFlush < pRun->nObjects && pRun->rgIsDone[pRun->iNextFlush]) {
+        ReportLogFlush(pRun->rgpLogs[pRun->iNextFlush]);
+        pRun->rgpLogs[pRun->iNextFlush++] = NULL;
+    }
+    LeaveCriticalSection(&pRun->csFlush);
+}
+
+
+static void ReleaseVerifyContext(VERIFY_CONTEXT* pCtx) {
+    /**
+     * @brief Drop one reference to object's context. Last one (object and all its sub-folders verified) frees it
+     */
+    if (InterlockedDecrement(&pCtx->nRefs)) return;
+
+    // Object walked: its folders may have been cut on any thread until now
+    if (pCtx->szName) {
+        TCHAR buf[BUF_LEN];
+        VERIFY_SPAN* pSpan = GetVerifySpan(pCtx);
+        if (pSpan && pSpan->szCut)
+            snprintf(buf, BUF_LEN-1, "Object '%s': Verification paused before '%s'", pCtx->szName, pSpan->szCut);
+        else snprintf(buf, BUF_LEN-1, "Object '%s': Verification complete", pCtx->szName);
+        ReportLogAdd(pCtx->pLog, EVENTLOG_INFORMATION_TYPE, buf);
+    }
+
+    // Actual state: only of objects whose tree was reached, others keep what they had
+    if (pCtx->cchRoot) pCtx->pRun->rgjsonActual[pCtx->iObject] = pCtx->jsonActual;
+    else cJSON_Delete(pCtx->jsonActual);
+    DeleteCriticalSection(&pCtx->csActual);
+
+    CompleteVerifyObject(pCtx->pRun, pCtx->iObject);
+    FreeDirMetaCache(&pCtx->dirMeta);
+    DeleteCriticalSection(&pCtx->csDirMeta);
+    free(pCtx);
+}
+
+
+static BOOL PushVerifyFolder(HASH_WORKER* pWorker, cJSON* jsonNode, HANDLE hBase, LPCTSTR szPath,
+                             VERIFY_CONTEXT* pCtx, REPORT_LOG* pLog) {
+    /**
+     * @brief Queue sub-folder for any thread of pool. Its reports take their place in pLog now
+     *
+     * @details FALSE if it cannot be queued: caller verifies it then
+     */
+    VERIFY_TASK* pTask = malloc(sizeof(VERIFY_TASK));
+    if (!pTask) return FALSE;
+
+    pTask->szPath = _tcsdup(szPath);
+    if (!pTask->szPath) {
+        free(pTask);
+        return FALSE;
+    }
+
+    // Parent closes its handle when its own items are done: sub-folder gets its own
+    if (!DuplicateHandle(GetCurrentProcess(), hBase, GetCurrentProcess(), &pTask->hBase, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+        free(pTask->szPath);
+        free(pTask);
+        return FALSE;
+    }
+    pTask->jsonNode = jsonNode;
+    pTask->iObject = pCtx->iObject;
+    pTask->pCtx = pCtx;
+    pTask->pLog = ReportLogNest(pLog);
+
+    InterlockedIncrement(&pCtx->nRefs);
+    Hash_PoolPush(pWorker, pTask);
+    return TRUE;
+}
+
+
+static void RunVerifyTask(HASH_WORKER* pWorker, void* pTask, void* pArg) {
+    /**
+     * @brief Verify object (with new context), or sub-folder of one
+     */
+    VERIFY_TASK* pVerifyTask = pTask;
+    VERIFY_RUN* pRun = pArg;
+    VERIFY_CONTEXT* pCtx = pVerifyTask->pCtx;
+
+    // Sub-folder: left to next slice if this one is over by now
+    if (pCtx) {
+        VERIFY_SPAN* pSpan = GetVerifySpan(pCtx);
+        if (!pSpan || TakeItem(pSpan, GetSubPath(pCtx, pVerifyTask->szPath)))
+            VerifyNodeFileBatched(pVerifyTask->jsonNode, pVerifyTask->hBase, pVerifyTask->szPath, NULL, pCtx,
+                                  pVerifyTask->pLog, NULL, pWorker);
+        CloseHandle(pVerifyTask->hBase);
+        free(pVerifyTask->szPath);
+        ReleaseVerifyContext(pCtx);
+        free(pVerifyTask);
+        return;
+    }
+
+    // Slice is over before object is reached: it is left to next one whole
+    VERIFY_SPAN* pSpan = pRun->rgSpans ? &pRun->rgSpans[pVerifyTask->iObject] : NULL;
+    if (pSpan && pSpan->pSlice->hasTaken && IsSliceOver(pSpan->pSlice)) {
+        CompleteVerifyObject(pRun, pVerifyTask->iObject);
+        free(pVerifyTask);
+        return;
+    }
+
+    pCtx = calloc(1, sizeof(VERIFY_CONTEXT));
+    if (pCtx && !(pCtx->jsonActual = cJSON_CreateArray())) {
+        free(pCtx);
+        pCtx = NULL;
+    }
+    if (!pCtx) {
+        SvcReportEvent(EVENTLOG_ERROR_TYPE, "Verification: Out of memory");
+        CompleteVerifyObject(pRun, pVerifyTask->iObject);
+        free(pVerifyTask);
+        return;
+    }
+    pCtx->pLog = pRun->rgpLogs[pVerifyTask->iObject];
+    pCtx->pRun = pRun;
+    pCtx->iObject = pVerifyTask->iObject;
+    pCtx->nRefs = 1;
+    InitializeCriticalSection(&pCtx->csDirMeta);
+    InitializeCriticalSection(&pCtx->csActual);
+    if (pSpan) pSpan->isStarted = TRUE;
+
+    VerifyObjectContext(pVerifyTask->jsonNode, pCtx, pWorker);
+    ReleaseVerifyContext(pCtx);
+    free(pVerifyTask);
+}
+
+
+static void RunVerification(cJSON** rgjsonObjects, int nObjects, BOOL isFullCheck, VERIFY_SPAN* rgSpans) {
+    /**
+     * @brief Verify objects on a pool of Parameters/VerifyThreads threads (default: one per processor)
+     *
+     * @details Objects are verified at once, and folders within each of them (see taskpool.h),
+     *  so a check takes about as long as its slowest object. Reports are written in list order,
+     *  and in HashTree order within object, whatever order they were made in. rgSpans bounds
+     *  verification of each object to its part of a slice (see VerifyObjectListSlice), or is NULL.
+     *
+     *  Actual state of mismatched items is kept next to Object List for accept (see StoreActualState)
+     */
+    VERIFY_RUN run;
+    int nTasks = 0;
+
+    run.isFullCheck = isFullCheck;
+    run.rgSpans = rgSpans;
+    run.nObjects = nObjects;
+    run.iNextFlush = 0;
+    run.rgpLogs = calloc(nObjects, sizeof(REPORT_LOG*));
+    run.rgjsonActual = calloc(nObjects, sizeof(cJSON*));
+    run.rgIsDone = calloc(nObjects, sizeof(BOOL));
+    VERIFY_TASK** rgpTasks = calloc(nObjects, sizeof(VERIFY_TASK*));
+    LPCTSTR* rgszBounds = rgSpans ? calloc(2 * nObjects, sizeof(LPCTSTR)) : NULL;
+    if (!run.rgpLogs || !run.rgjsonActual || !run.rgIsDone || !rgpTasks || (rgSpans && !rgszBounds)) {
+        SvcReportEvent(EVENTLOG_ERROR_TYPE, "Verification: Out of memory");
+        free(run.rgpLogs);
+        free(run.rgjsonActual);
+        free(run.rgIsDone);
+        free(rgpTasks);
+        free(rgszBounds);
+        return;
+    }
+    InitializeCriticalSection(&run.csFlush);
+
+    for (int i = 0; i < nObjects; i++) {
+        run.rgpLogs[i] = ReportLogCreate();
+        rgpTasks[nTasks] = calloc(1, sizeof(VERIFY_TASK));
+        if (!rgpTasks[nTasks]) {
+            SvcReportEvent(EVENTLOG_ERROR_TYPE, "Verification: Out of memory");
+            run.rgIsDone[i] = TRUE;
+            continue;
+        }
+        rgpTasks[nTasks]->jsonNode = rgjsonObjects[i];
+        rgpTasks[nTasks]->iObject = i;
+        nTasks++;
+    }
+
+    // Pool fails before any task is run: tasks are still ours, no object is verified
+    BOOL isRun = Hash_PoolRun(GetVerifyThreads(), RunVerifyTask, &run, (void**) rgpTasks, nTasks) == HASH_STATUS_OK;
+    if (!isRun) {
+        SvcReportEvent(EVENTLOG_ERROR_TYPE, "Verification: Out of memory");
+        for (int i = 0; i < nTasks; i++) free(rgpTasks[i]);
+    }
+
+    // Objects that could not be queued, with none verified after them
+    for (int i = run.iNextFlush; i < nObjects; i++)
+        ReportLogFlush(run.rgpLogs[i]);
+
+    // Slice verified root entries of each object from where it resumed to where it was cut: others keep what other slices found
+    for (int i = 0; rgSpans && i < nObjects; i++) {
+        rgszBounds[i] = rgSpans[i].szResume;
+        rgszBounds[nObjects + i] = rgSpans[i].szCut;
+    }
+    if (isRun) StoreActualState(rgjsonObjects, run.rgjsonActual, nObjects, rgszBounds, rgszBounds ? rgszBounds + nObjects : NULL);
+
+    DeleteCriticalSection(&run.csFlush);
+    free(rgszBounds);
+    free(rgpTasks);
+    free(run.rgjsonActual);
+    free(run.rgIsDone);
+    free(run.rgpLogs);
+}
+
+
+void VerifyObjectList(cJSON* jsonObjectList, BOOL isFullCheck) {
+    /**
+     * @brief Verify every object in Object List (see RunVerification)
+     */
+    int nObjects = cJSON_GetArraySize(jsonObjectList);
+    cJSON** rgjsonObjects = malloc((nObjects + 1) * sizeof(cJSON*));
+    cJSON* jsonObject;
+    int i = 0;
+
+    if (!rgjsonObjects) {
+        SvcReportEvent(EVENTLOG_ERROR_TYPE, "Verification: Out of memory");
+        return;
+    }
+    cJSON_ArrayForEach(jsonObject, jsonObjectList)
+        rgjsonObjects[i++] = jsonObject;
+
+    RunVerification(rgjsonObjects, i, isFullCheck, NULL);
+    free(rgjsonObjects);
+}
+
+
+void VerifyObject(cJSON* jsonObject, BOOL isFullCheck) {
+    /**
+     * @brief Verify Hash Tree of object against actual object, its folders on pool (see RunVerification)
+     */
+    RunVerification(&jsonObject, 1, isFullCheck, NULL);
+}
+
+
+WINBOOL VerifyObjectListSlice(cJSON* jsonObjectList, VERIFY_CURSOR* pCursor, HANDLE hStop, ULONGLONG ullDeadline) {
+    /**
+     * @brief Verify objects not done at cursor, all at once (see RunVerification), until they are done,
+     *  hStop is signaled or deadline passes
+     *
+     * @details Each object resumes at the item it was left at, and is cut before any file or folder at any depth
+     *  of its tree (see TakeItem), so a slice overruns by about one batch of files or listing per thread.
+     *  Objects not reached by then are left to next slice. Something is verified in every slice, however short.
+     *  Position of each object is moved past what was verified and saved in Parameters (see SaveCheckCursor),
+     *  so a check stopped by service stop or restart resumes there. ullDeadline of 0 means none. TRUE once all
+     *  are done
+     */
+    DWORD nObjects = cJSON_GetArraySize(jsonObjectList);
+    VERIFY_SLICE slice;
+    cJSON* jsonObject;
+    int nSpans = 0;
+    BOOL isDone = TRUE;
+
+    if (!nObjects) return TRUE;
+    slice.hStop = hStop;
+    slice.ullDeadline = ullDeadline;
+    slice.hasTaken = FALSE;
+
+    // List may have changed since cursor was saved: objects keep their own positions, new ones start over
+    if (!MatchCheckCursor(pCursor, jsonObjectList)) {
+        SvcReportEvent(EVENTLOG_ERROR_TYPE, "Verification: Out of memory");
+        return FALSE;
+    }
+
+    cJSON** rgjsonObjects = malloc(nObjects * sizeof(cJSON*));
+    VERIFY_SPAN* rgSpans = calloc(nObjects, sizeof(VERIFY_SPAN));
+    if (!rgjsonObjects || !rgSpans) {
+        SvcReportEvent(EVENTLOG_ERROR_TYPE, "Verification: Out of memory");
+        free(rgjsonObjects);
+        free(rgSpans);
+        return FALSE;
+    }
+
+    DWORD i = 0;
+    cJSON_ArrayForEach(jsonObject, jsonObjectList) {
+        if (!pCursor->rgPositions[i].isDone) {
+            rgjsonObjects[nSpans] = jsonObject;
+            rgSpans[nSpans].pSlice = &slice;
+            rgSpans[nSpans].szResume = pCursor->rgPositions[i].szEntry;
+            InitializeCriticalSection(&rgSpans[nSpans].csSpan);
+            nSpans++;
+        }
+        i++;
+    }
+    if (nSpans) RunVerification(rgjsonObjects, nSpans, pCursor->isFullCheck, rgSpans);
+
+    // Objects resume where they were cut. Ones not reached stay where they were
+    VERIFY_SPAN* pSpan = rgSpans;
+    for (i = 0; i < nObjects; i++) {
+        VERIFY_POSITION* pPosition = &pCursor->rgPositions[i];
+        if (pPosition->isDone) continue;
+        if (pSpan->isStarted) {
+            free(pPosition->szEntry);
+            pPosition->szEntry = pSpan->szCut;
+            pPosition->isDone = !pSpan->szCut;
+        }
+        if (!pPosition->isDone) isDone = FALSE;
+        free(pSpan->szTaken);
+        DeleteCriticalSection(&pSpan->csSpan);
+        pSpan++;
+    }
+    SaveCheckCursor(pCursor);
+
+    free(rgjsonObjects);
+    free(rgSpans);
+    return isDone;
+}
+
+
+static void VerifyObjectContext(cJSON* jsonObject, VERIFY_CONTEXT* pCtx, HASH_WORKER* pWorker) {
     /**
      * @brief Verify Hash Tree of object against actual object
      *
      * @details Given object as cJSON:
      *      string  object_name
      *      WORD    type
+     *      string  algorithm   -(optional, md5 if missing)
+     *      string  scan        -(optional, cached if missing)
+     *      string  check       -(optional, full if missing)
+     *      string  entries     -(optional, allow-new if missing)
      *      string  path
      *      cJSON   root
      *
      *  Where root is the root HashNode of HashTree, given as cJSON:
      *      string  name    -(for root)
      *      string  hash    -(skip hash check?)
+     *      string  meta    -(folders only)
      *      [cJSON] slaves
+     *
+     *  Full check hashes every file, whatever object's check mode is. Reports go to pCtx->pLog.
+     *  Sub-folders are pushed to pWorker's pool, if set (see VerifyNodeFileBatched)
      */
 
     TCHAR buf[BUF_LEN];
+    REPORT_LOG* pLog = pCtx->pLog;
+    BOOL isFullCheck = pCtx->pRun->isFullCheck;
     LPTSTR szObjectName = NULL;
     HANDLE hBaseHnd;
     DWORD dwBackslashIndex;
@@ -220,8 +1117,11 @@ void VerifyObject(cJSON* jsonObject) {
 
     if (!szObjectName) szObjectName = "Unnamed";
 
-    snprintf(buf, BUF_LEN-1, "Object '%s': Started verification", szObjectName);
-    SvcReportEvent(EVENTLOG_INFORMATION_TYPE, buf);
+    VERIFY_SPAN* pSpan = GetVerifySpan(pCtx);
+    if (pSpan && pSpan->szResume)
+        snprintf(buf, BUF_LEN-1, "Object '%s': Resumed verification at '%s'", szObjectName, pSpan->szResume);
+    else snprintf(buf, BUF_LEN-1, "Object '%s': Started verification", szObjectName);
+    ReportLogAdd(pLog, EVENTLOG_INFORMATION_TYPE, buf);
 
     cJSON* jsonPath = cJSON_GetObjectItem(jsonObject, "path");
     if (!jsonPath || !cJSON_IsString(jsonPath)) ReportObjErrorAndRet();
@@ -234,6 +1134,36 @@ void VerifyObject(cJSON* jsonObject) {
     cJSON* jsonRootNode = cJSON_GetObjectItem(jsonObject, "root");
     if (!jsonRootNode) ReportObjErrorAndRet();
 
+    if (!GetObjectHashAlg(jsonObject, &pCtx->options.alg)) {
+        snprintf(buf, BUF_LEN-1, "Object '%s': Unknown hash algorithm", szObjectName);
+        ReportLogAdd(pLog, EVENTLOG_ERROR_TYPE, buf);
+        return;
+    }
+
+    if (!GetObjectScanMode(jsonObject, &pCtx->options.scan)) {
+        snprintf(buf, BUF_LEN-1, "Object '%s': Unknown scan mode", szObjectName);
+        ReportLogAdd(pLog, EVENTLOG_ERROR_TYPE, buf);
+        return;
+    }
+
+    if (!GetObjectCheckMode(jsonObject, &pCtx->options.check)) {
+        snprintf(buf, BUF_LEN-1, "Object '%s': Unknown check mode", szObjectName);
+        ReportLogAdd(pLog, EVENTLOG_ERROR_TYPE, buf);
+        return;
+    }
+    if (isFullCheck) pCtx->options.check = CHECK_FULL;
+
+    if (!GetObjectEntriesMode(jsonObject, &pCtx->options.entries)) {
+        snprintf(buf, BUF_LEN-1, "Object '%s': Unknown entries mode", szObjectName);
+        ReportLogAdd(pLog, EVENTLOG_ERROR_TYPE, buf);
+        return;
+    }
+    // Read from nodes instead: each large file is verified the way it was recorded
+    pCtx->options.chunking = DEFAULT_CHUNKING;
+
+    // Stored digests are read in either encoding. Actual ones are kept in object's (see NoteActualState)
+    if (!GetObjectEncoding(jsonObject, &pCtx->options.enc)) pCtx->options.enc = HASH_DEFAULT_ENCODING;
+
     // Check presence and obtain base handle, proceed to Hash Tree verification
     switch (dwType) {
 
@@ -252,10 +1182,15 @@ void VerifyObject(cJSON* jsonObject) {
                     snprintf(buf, BUF_LEN-1, "Object '%s': Missing", szObjectName);
                 else snprintf(buf, BUF_LEN-1, "Object '%s': Failed to open (%d)", szObjectName, res);
 
-                SvcReportEvent(EVENTLOG_ERROR_TYPE, buf);
+                ReportLogAdd(pLog, EVENTLOG_ERROR_TYPE, buf);
                 return;
             }
-            VerifyNodeFile(jsonRootNode, hBaseHnd);
+            InitDirMetaCache(&pCtx->dirMeta, pCtx->options.alg);
+            if (GetVerifySpan(pCtx)) {
+                pCtx->dirMeta.pfnStop = IsSpanOver;
+                pCtx->dirMeta.pStopArg = GetVerifySpan(pCtx);
+            }
+            VerifyNodeFile(jsonRootNode, hBaseHnd, pCtx, pLog, pWorker);
             CloseHandle(hBaseHnd);
             break;
 
@@ -264,7 +1199,7 @@ void VerifyObject(cJSON* jsonObject) {
             hkRoot = ParseRootHKEY(szPath);
             if (hkRoot == INVALID_HANDLE_VALUE) {
                 snprintf(buf, BUF_LEN-1, "Object '%s': Invalid root HKEY");
-                SvcReportEvent(EVENTLOG_ERROR_TYPE, buf);
+                ReportLogAdd(pLog, EVENTLOG_ERROR_TYPE, buf);
                 return;
             }
             // Safe, since hkRoot found '\\'
@@ -276,51 +1211,173 @@ void VerifyObject(cJSON* jsonObject) {
                     snprintf(buf, BUF_LEN-1, "Object '%s': Missing", szObjectName);
                 else snprintf(buf, BUF_LEN-1, "Object '%s': Failed to open (%d)", szObjectName, res);
 
-                SvcReportEvent(EVENTLOG_ERROR_TYPE, buf);
+                ReportLogAdd(pLog, EVENTLOG_ERROR_TYPE, buf);
                 return;
             }
 
             // Proceed to node verification
-            VerifyNodeReg(jsonRootNode, hkBaseKey);
+            VerifyNodeReg(jsonRootNode, hkBaseKey, pCtx->options.alg, pLog);
             RegCloseKey(hkBaseKey);
             break;
 
         default:
             // wat? (x2)
             snprintf(buf, BUF_LEN-1, "Object '%s': Unknown object type", szObjectName);
-            SvcReportEvent(EVENTLOG_ERROR_TYPE, buf);
+            ReportLogAdd(pLog, EVENTLOG_ERROR_TYPE, buf);
+            return;
+    }
+    // Closing report once its sub-folders are done too (see ReleaseVerifyContext)
+    pCtx->szName = szObjectName;
+}
+
+
+static void VerifySlave(VERIFY_FOLDER* pFolder, cJSON* jsonSlave, BOOL isDirectory, const HASH_NODE_INFO* pInfo) {
+    /**
+     * @brief Verify item of folder: sub-folder by pool if possible, file into folder's batch
+     *
+     * @details pInfo is item's type and metadata from folder's listing, or NULL
+     */
+    TCHAR buf[BUF_LEN];
+    size_t cchMark = pFolder->pPath->cchPath;
+    LPCTSTR szName = cJSON_GetStringValue(cJSON_GetObjectItem(jsonSlave, "name"));
+
+    // Path of item: folder's own, its name appended and cut off again
+    if (szName && !Hash_PathPush(pFolder->pPath, szName)) {
+        snprintf(buf, BUF_LEN-1, "File '%s\\%s': Out of memory", pFolder->szPath, szName);
+        ReportLogAdd(pFolder->pLog, EVENTLOG_WARNING_TYPE, buf);
+        return;
+    }
+
+    if (!(isDirectory && pFolder->pWorker &&
+          PushVerifyFolder(pFolder->pWorker, jsonSlave, pFolder->hDir, pFolder->pPath->szPath, pFolder->pCtx, pFolder->pLog)))
+        VerifyNodeFileBatched(jsonSlave, pFolder->hDir, pFolder->pPath->szPath, pInfo, pFolder->pCtx, pFolder->pLog,
+                              pFolder->pBatch, pFolder->pWorker);
+    Hash_PathPop(pFolder->pPath, cchMark);
+
+    if (pFolder->pBatch && pFolder->pBatch->nFiles == HASH_BATCH_SIZE)
+        FlushVerifyBatch(pFolder->pBatch);
+}
+
+
+static void VerifyDiffEntry(const DIR_DIFF* pDiff, LPVOID pArg) {
+    /**
+     * @brief Report entry of folder diff, or verify it further (see DiffDirectory)
+     */
+    TCHAR buf[BUF_LEN];
+    VERIFY_FOLDER* pFolder = pArg;
+    LPCTSTR szKind = pDiff->isDirectory ? "Folder" : "File";
+    LPCTSTR szState;
+
+    // Entries before where a slice resumes were reported by earlier slices: only folders down to it pass.
+    // Such a folder is reported here only if it is gone or retyped since, so it could not be walked down
+    if (!TakeFolderItem(pFolder, pDiff->szName)) return;
+
+    switch (pDiff->kind) {
+        case DIR_DIFF_ADDED:
+            if (pFolder->pCtx->options.entries != ENTRIES_EXACT) return;
+            snprintf(buf, BUF_LEN-1, "%s '%s\\%s': Unexpected (not in snapshot)", szKind, pFolder->szPath, pDiff->szName);
+            szState = _T("unexpected");
+            break;
+
+        case DIR_DIFF_REMOVED:
+            snprintf(buf, BUF_LEN-1, "%s '%s\\%s': Missing", szKind, pFolder->szPath, pDiff->szName);
+            szState = _T("missing");
+            break;
+
+        case DIR_DIFF_TYPE_CHANGED:
+            // Node type mismatch. Only directories have slaves list
+            if (!pDiff->isDirectory) snprintf(buf, BUF_LEN-1, "Folder '%s\\%s': Expected directory, got file", pFolder->szPath, pDiff->szName);
+            else                     snprintf(buf, BUF_LEN-1, "File '%s\\%s': Expected file, got directory", pFolder->szPath, pDiff->szName);
+            szState = _T("retyped");
+            break;
+
+        case DIR_DIFF_MODIFIED:
+            // Size differs: contents do too, no need to read them
+            snprintf(buf, BUF_LEN-1, "File '%s\\%s': Modified (size mismatch)", pFolder->szPath, pDiff->szName);
+            szState = _T("modified");
+            break;
+
+        case DIR_DIFF_SAME_META:
+            // Same file, untouched since snapshot: trusted until next full check
+            if (pFolder->pCtx->options.check == CHECK_METADATA) {
+#ifdef REPORT_SUCCESSFUL_CHECKS
+                snprintf(buf, BUF_LEN-1, "Path '%s\\%s': OK (metadata)", pFolder->szPath, pDiff->szName);
+                ReportLogAdd(pFolder->pLog, EVENTLOG_INFORMATION_TYPE, buf);
+#endif
+                return;
+            }
+            VerifySlave(pFolder, pDiff->jsonNode, FALSE, pDiff->pInfo);
+            return;
+
+        default:
+            VerifySlave(pFolder, pDiff->jsonNode, pDiff->isDirectory, pDiff->pInfo);
             return;
     }
-    snprintf(buf, BUF_LEN-1, "Object '%s': Verification complete", szObjectName);
-    SvcReportEvent(EVENTLOG_INFORMATION_TYPE, buf);
+    ReportLogAdd(pFolder->pLog, EVENTLOG_WARNING_TYPE, buf);
+    NoteActualState(pFolder->pCtx, pFolder->szPath, pDiff->szName, szState, NULL);
 }
 
 
-void VerifyNodeFile(cJSON* jsonNode, HANDLE hBase) {
+void VerifyNodeFile(cJSON* jsonNode, HANDLE hBase, VERIFY_CONTEXT* pCtx, REPORT_LOG* pLog, HASH_WORKER* pWorker) {
+    /**
+     * @brief Verify HashNode against actual sub-folder or file (see VerifyNodeFileBatched)
+     *
+     * @details Only path resolved by handle: items below are opened relative to their folder (see fswalk.h)
+     */
+    HASH_PATH_BUF path;
+    LPCTSTR szName = cJSON_GetStringValue(cJSON_GetObjectItem(jsonNode, "name"));
+
+    if (!InitHandlePath(&path, hBase) || (szName && !Hash_PathPush(&path, szName))) {
+        ReportLogAdd(pLog, EVENTLOG_ERROR_TYPE, "Verification: Out of memory");
+        Hash_PathFree(&path);
+        return;
+    }
+    // Object's root: paths of actual state are relative to it
+    if (!szName) pCtx->cchRoot = path.cchPath;
+    VerifyNodeFileBatched(jsonNode, hBase, path.szPath, NULL, pCtx, pLog, NULL, pWorker);
+    Hash_PathFree(&path);
+}
+
+
+static void VerifyNodeFileBatched(cJSON* jsonNode, HANDLE hBase, LPCTSTR szPath, const HASH_NODE_INFO* pInfo,
+                                  VERIFY_CONTEXT* pCtx, REPORT_LOG* pLog, VERIFY_BATCH* pBatch, HASH_WORKER* pWorker) {
     /**
      * @brief Verify HashNode against actual sub-folder or file
      *
      * @details go DFS
      *  for leaves:
-     *      - check presence
-     *      - check hash
-     *      - report on mismatch
+     *      - check presence (opened relative to hBase, type and metadata read from handle)
+     *      - check size (and other metadata, in metadata check mode)
+     *      - check sample digest (huge files)
+     *      - check hash, unless metadata is unchanged or sample is trusted (sampled check mode)
+     *      - report on mismatch, naming the check that found it (and changed byte ranges, for CDC files)
      *  for nodes:
      *      - check presence
-     *      - for each subnode:
+     *      - skip whole subtree if its meta is unchanged (metadata check mode, see dirhash.h)
+     *      - diff listing against subnodes (see DiffDirectory): report missing, retyped,
+     *        resized and, in exact entries mode, new items without opening them
+     *      - for each other subnode:
      *          recursive call
-     *      - for each item in actual object:
-     *          add name and type to hash
      *      - report on mismatch
+     *
+     *  If pBatch is set, file hash is not checked here: file is left open in pBatch
+     *  and checked by FlushVerifyBatch() along with its neighbours. If pWorker is set,
+     *  sub-folders are verified by pool (see PushVerifyFolder), reports go to pLog.
+     *  szPath is item's own path, of any length, only used to name it in reports. pInfo is item's type
+     *  and metadata from listing of hBase (see DiffDirectory); if NULL, they are queried from its handle
      */
 
     TCHAR buf[BUF_LEN];
-    TCHAR szPath[MAX_PATH];
 
     HANDLE hCurrent;
     DWORD res;
     BOOL isDirectory;
     BOOL hasSlaves;
+    HASH_NODE_INFO info;
+
+    HASH_ALG alg = pCtx->options.alg;
+    HASH_SCAN scan = pCtx->options.scan;
+    CHECK_MODE check = pCtx->options.check;
 
     // Get name
     LPTSTR szName = NULL;
@@ -328,91 +1385,288 @@ void VerifyNodeFile(cJSON* jsonNode, HANDLE hBase) {
     if (jsonName && cJSON_IsString(jsonName))
         szName = cJSON_GetStringValue(jsonName);
 
-    // Get path
-    res = GetFinalPathNameByHandle(hBase, szPath, MAX_PATH-1, VOLUME_NAME_DOS);
-    if (res <= 0) _tcscpy(szPath, _T("<unknown>"));
-
     // Get slaves of node
     cJSON* jsonSlaves = cJSON_GetObjectItem(jsonNode, "slaves");
     hasSlaves = (jsonSlaves && cJSON_IsArray(jsonSlaves));
 
     // If name is set, check presence and actual type, obtain handle:  hCurrent
     if (szName) {
-        snprintf(szPath + _tcslen(szPath), MAX_PATH - _tcslen(szPath), "\\%s", szName);
-
         // Check presence, assuming hBase is valid
-        hCurrent = CreateFile(szPath,
-                               GENERIC_READ,
-                               FILE_SHARE_READ,
-                               0,
-                               OPEN_EXISTING,
-                               FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_SEQUENTIAL_SCAN,
-                               NULL);
-
-        if (hCurrent == INVALID_HANDLE_VALUE) {
-            res = GetLastError();
-            if (res == ERROR_FILE_NOT_FOUND)
+        res = Hash_OpenAt(hBase, szName, scan, &hCurrent);
+        if (res != ERROR_SUCCESS) {
+            if (res == ERROR_FILE_NOT_FOUND || res == ERROR_PATH_NOT_FOUND) {
                 snprintf(buf, BUF_LEN - 1, "File '%s': Missing", szPath);
+                NoteActualState(pCtx, szPath, NULL, _T("missing"), NULL);
+            }
             else snprintf(buf, BUF_LEN - 1, "File '%s': Failed to open (%lu)", szPath, res);
-            SvcReportEvent(EVENTLOG_WARNING_TYPE, buf);
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
             return;
         }
+    }
+    else hCurrent = hBase;  // szName not set -> it is root, use hBase instead
+
+    // Type, size and metadata: from listing, or else in one query of open handle
+    if (pInfo) {
+        info = *pInfo;
+        res = ERROR_SUCCESS;
+    }
+    else res = Hash_QueryNode(hCurrent, &info);
+    if (res != ERROR_SUCCESS) {
+        snprintf(buf, BUF_LEN - 1, "File '%s': Failed to query (%lu)", szPath, res);
+        ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+        if (hCurrent != hBase) CloseHandle(hCurrent);
+        return;
+    }
+    isDirectory = info.isDirectory;
 
-        isDirectory = (GetFileAttributes(szPath) & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY;
+    if (isDirectory != hasSlaves) {
+        // Node type mismatch. Only directories have slaves list
+        if (!isDirectory) snprintf(buf, BUF_LEN-1, "Folder '%s': Expected directory, got file", szPath);
+        else              snprintf(buf, BUF_LEN-1, "File '%s': Expected file, got directory", szPath);
 
-        if (isDirectory != hasSlaves) {
-            // Node type mismatch. Only directories have slaves list
-            if (!isDirectory) snprintf(buf, BUF_LEN-1, "Folder '%s': Expected directory, got file", szPath);
-            else              snprintf(buf, BUF_LEN-1, "File '%s': Expected file, got directory", szPath);
+        ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+        NoteActualState(pCtx, szPath, NULL, _T("retyped"), NULL);
+        if (hCurrent != hBase) CloseHandle(hCurrent);
+        return;
+    }
 
-            SvcReportEvent(EVENTLOG_WARNING_TYPE, buf);
+    // Directory: listings first, they may spare a walk over the whole subtree
+    if (hasSlaves) {
+        const DIR_META* pActualMeta = NULL;
+        DIR_META actualMeta;
+        HASH_DIGEST expectedMeta;
+        cJSON* jsonMeta = cJSON_GetObjectItem(jsonNode, "meta");
+        BOOL hasMeta = jsonMeta && cJSON_IsString(jsonMeta) &&
+                       Hash_Decode(cJSON_GetStringValue(jsonMeta), Hash_DigestLen(alg), &expectedMeta);
+
+        // Cache is shared by all threads of object: copy digests out while it cannot grow.
+        // Folders above where a slice resumes are not summed up: their subtree is mostly done already
+        if (check == CHECK_METADATA && hasMeta && !IsAboveResume(pCtx, szPath)) {
+            EnterCriticalSection(&pCtx->csDirMeta);
+            const DIR_META* pMeta = GetDirMeta(&pCtx->dirMeta, hCurrent, szPath);
+            if (pMeta) {
+                actualMeta = *pMeta;
+                pActualMeta = &actualMeta;
+            }
+            LeaveCriticalSection(&pCtx->csDirMeta);
+        }
+
+        // Nothing under folder touched since snapshot: trusted until next full check
+        if (check == CHECK_METADATA && hasMeta && pActualMeta &&
+            Hash_Equal(&expectedMeta, &pActualMeta->meta, Hash_DigestLen(alg))) {
+            if (hCurrent != hBase) CloseHandle(hCurrent);
+#ifdef REPORT_SUCCESSFUL_CHECKS
+            snprintf(buf, BUF_LEN-1, "Path '%s': OK (metadata)", szPath);
+            ReportLogAdd(pLog, EVENTLOG_INFORMATION_TYPE, buf);
+#endif
             return;
         }
     }
-    else hCurrent = hBase;  // szName not set -> it is root, use hBase instead
 
-    // Check slaves (recursive)
-    if (hasSlaves)
-        for (int i = 0; i < cJSON_GetArraySize(jsonSlaves); i++)
-            VerifyNodeFile(cJSON_GetArrayItem(jsonSlaves, i), hCurrent);
+    // Check slaves (recursive). Files of this directory are hashed in batches, sub-folders by pool
+    if (hasSlaves) {
+        cJSON* jsonSlave;
+        VERIFY_FOLDER folder;
+        HASH_PATH_BUF path;
+        VERIFY_BATCH* pDirBatch = malloc(sizeof(VERIFY_BATCH));
+        if (pDirBatch) {
+            pDirBatch->pCtx = pCtx;
+            pDirBatch->pOptions = &pCtx->options;
+            pDirBatch->pLog = pLog;
+            pDirBatch->szDirPath = szPath;
+            pDirBatch->nFiles = 0;
+        }
+
+        if (!Hash_PathInit(&path, szPath)) {
+            snprintf(buf, BUF_LEN-1, "Folder '%s': Out of memory", szPath);
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+            free(pDirBatch);
+            if (hCurrent != hBase) CloseHandle(hCurrent);
+            return;
+        }
+
+        folder.pCtx = pCtx;
+        folder.pLog = pLog;
+        folder.pWorker = pWorker;
+        folder.pBatch = pDirBatch;
+        folder.hDir = hCurrent;
+        folder.pPath = &path;
+        folder.szPath = szPath;
+
+        // One listing tells what is gone, added or retyped. If it cannot be read, each slave is opened.
+        // Folders above where a slice resumes were reported on by the slice that first listed them
+        if (!DiffDirectory(hCurrent, jsonSlaves, VerifyDiffEntry, &folder)) {
+            if (pCtx->options.entries == ENTRIES_EXACT && !IsAboveResume(pCtx, szPath)) {
+                snprintf(buf, BUF_LEN-1, "Folder '%s': Could not list entries", szPath);
+                ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+            }
+            cJSON_ArrayForEach(jsonSlave, jsonSlaves) {
+                LPCTSTR szSlaveName = cJSON_GetStringValue(cJSON_GetObjectItem(jsonSlave, "name"));
+                if (szSlaveName && !TakeFolderItem(&folder, szSlaveName)) continue;
+                VerifySlave(&folder, jsonSlave, cJSON_IsArray(cJSON_GetObjectItem(jsonSlave, "slaves")), NULL);
+            }
+        }
+
+        if (pDirBatch) {
+            FlushVerifyBatch(pDirBatch);
+            free(pDirBatch);
+        }
+        Hash_PathFree(&path);
+    }
+
+    // File: metadata first. Nodes from older lists have none and are always hashed
+    FILE_META expectedMeta, actualMeta;
+    if (!isDirectory && GetNodeFileMeta(jsonNode, &expectedMeta)) {
+        CopyFileMeta(&info, &actualMeta);
+
+        // Size differs: contents do too, no need to read them
+        if (expectedMeta.cbSize != actualMeta.cbSize) {
+            snprintf(buf, BUF_LEN-1, "File '%s': Modified (size mismatch)", szPath);
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+            NoteActualState(pCtx, szPath, NULL, _T("modified"), NULL);
+            if (hCurrent != hBase) CloseHandle(hCurrent);
+            return;
+        }
+        // Same file, untouched since snapshot: trusted until next full check
+        if (check == CHECK_METADATA && IsSameFileMeta(&expectedMeta, &actualMeta)) {
+            if (hCurrent != hBase) CloseHandle(hCurrent);
+#ifdef REPORT_SUCCESSFUL_CHECKS
+            snprintf(buf, BUF_LEN-1, "Path '%s': OK (metadata)", szPath);
+            ReportLogAdd(pLog, EVENTLOG_INFORMATION_TYPE, buf);
+#endif
+            return;
+        }
+    }
+
+    // Huge file: sample digest next, a few MB read instead of the whole file
+    cJSON* jsonSample = cJSON_GetObjectItem(jsonNode, "sample");
+    if (!isDirectory && jsonSample && cJSON_IsString(jsonSample)) {
+        HASH_DIGEST expected, actual;
+
+        if (!Hash_Decode(cJSON_GetStringValue(jsonSample), Hash_DigestLen(alg), &expected)) {
+            snprintf(buf, BUF_LEN-1, "File '%s': Malformed sample hash in Object List", szPath);
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+            if (hCurrent != hBase) CloseHandle(hCurrent);
+            return;
+        }
+        if (ERROR_SUCCESS != Hash_FileDigestSample(alg, scan, hCurrent, &actual)) {
+            snprintf(buf, BUF_LEN-1, "File '%s': Could not compute sample hash", szPath);
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+            if (hCurrent != hBase) CloseHandle(hCurrent);
+            return;
+        }
+        if (!Hash_Equal(&expected, &actual, Hash_DigestLen(alg))) {
+            snprintf(buf, BUF_LEN-1, "File '%s': Modified (sample mismatch)", szPath);
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+            NoteActualState(pCtx, szPath, NULL, _T("modified"), NULL);
+            if (hCurrent != hBase) CloseHandle(hCurrent);
+            return;
+        }
+        // Samples match: trusted until next full check
+        if (check == CHECK_SAMPLED) {
+            if (hCurrent != hBase) CloseHandle(hCurrent);
+#ifdef REPORT_SUCCESSFUL_CHECKS
+            snprintf(buf, BUF_LEN-1, "Path '%s': OK (sample)", szPath);
+            ReportLogAdd(pLog, EVENTLOG_INFORMATION_TYPE, buf);
+#endif
+            return;
+        }
+    }
 
     // Verify hash (if set)
     cJSON* jsonHash = cJSON_GetObjectItem(jsonNode, "hash");
     if (jsonHash && cJSON_IsString(jsonHash)) {
-        LPTSTR szExpectedHash = cJSON_GetStringValue(jsonHash);
-        TCHAR szActualHash[MD5LEN*2 + 1] = {0};
+        HASH_DIGEST expected, actual;
+
+        // Nodes keep text only: stored hash is decoded at each comparison, digests are compared raw
+        if (!Hash_Decode(cJSON_GetStringValue(jsonHash), Hash_DigestLen(alg), &expected)) {
+            snprintf(buf, BUF_LEN-1, "File '%s': Malformed hash in Object List", szPath);
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+            if (hCurrent != hBase) CloseHandle(hCurrent);
+            return;
+        }
+
+        // Large file recorded with tree digest: chunk size is kept in node
+        ULONGLONG cbTreeChunk = 0;
+        cJSON* jsonTreeChunk = cJSON_GetObjectItem(jsonNode, "tree_chunk");
+        if (jsonTreeChunk && cJSON_IsNumber(jsonTreeChunk) && cJSON_GetNumberValue(jsonTreeChunk) > 0)
+            cbTreeChunk = (ULONGLONG) cJSON_GetNumberValue(jsonTreeChunk);
+
+        // Large file recorded with CDC digest: every chunk is hashed, fingerprints are not trusted
+        BOOL isCdc = cJSON_GetObjectItem(jsonNode, "chunks") != NULL;
+
+        // File: check later with neighbours. Tree and CDC digests are computed on their own instead
+        if (!isDirectory && !cbTreeChunk && !isCdc && pBatch && hCurrent != hBase) {
+            pBatch->rghFiles[pBatch->nFiles] = hCurrent;
+            pBatch->rgExpected[pBatch->nFiles] = expected;
+            pBatch->rgszNames[pBatch->nFiles] = szName;
+            pBatch->rgJsonNodes[pBatch->nFiles] = jsonNode;
+            pBatch->rgInfo[pBatch->nFiles] = info;
+            pBatch->nFiles++;
+            return;
+        }
 
         // File: compute and compare file hash
         if (!isDirectory) {
-            res = MD5_FileHashDigest(hCurrent, szActualHash);
+            HASH_CDC_CHUNK *pExpectedChunks, *pActualChunks;
+            size_t nExpectedChunks, nActualChunks;
+
+            if (isCdc)            res = Hash_FileDigestCdc(alg, scan, hCurrent, NULL, 0, &pActualChunks, &nActualChunks, NULL, &actual);
+            else if (cbTreeChunk) res = Hash_FileDigestTree(alg, scan, hCurrent, cbTreeChunk, &actual);
+            else                  res = Hash_FileDigest(alg, scan, hCurrent, &actual);
             if (res != ERROR_SUCCESS) {
                 snprintf(buf, BUF_LEN-1, "File '%s': Could not compute hash", szPath);
-                SvcReportEvent(EVENTLOG_WARNING_TYPE, buf);
+                ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
                 if (hCurrent != hBase) CloseHandle(hCurrent);
                 return;
             }
-            if (0 != strncmp(szExpectedHash, szActualHash, MD5LEN * 2)) {
+            if (isCdc) {
+                BOOL isEqual = Hash_Equal(&expected, &actual, Hash_DigestLen(alg));
+
+                // Mismatch: recorded chunks tell which parts of file changed
+                if (!isEqual && GetNodeChunks(jsonNode, alg, &pExpectedChunks, &nExpectedChunks)) {
+                    ReportChangedRanges(pLog, szPath, pExpectedChunks, nExpectedChunks, pActualChunks, nActualChunks);
+                    free(pExpectedChunks);
+                }
+                else if (!isEqual) {
+                    snprintf(buf, BUF_LEN-1, "File '%s': Modified (hash mismatch)", szPath);
+                    ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+                }
+
+                // Actual chunks, so accept keeps them as snapshot would
+                if (!isEqual) {
+                    cJSON* jsonActual = MakeActualNode(jsonNode, &info, &actual, &pCtx->options);
+                    if (jsonActual) AddChunksToNode(jsonActual, pActualChunks, nActualChunks, alg, pCtx->options.enc);
+                    NoteActualState(pCtx, szPath, NULL, _T("modified"), jsonActual);
+                }
+                free(pActualChunks);
+                if (!isEqual) {
+                    if (hCurrent != hBase) CloseHandle(hCurrent);
+                    return;
+                }
+            }
+            else if (!Hash_Equal(&expected, &actual, Hash_DigestLen(alg))) {
                 snprintf(buf, BUF_LEN-1, "File '%s': Modified (hash mismatch)", szPath);
-                SvcReportEvent(EVENTLOG_WARNING_TYPE, buf);
+                ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+                NoteActualState(pCtx, szPath, NULL, _T("modified"), MakeActualNode(jsonNode, &info, &actual, &pCtx->options));
                 if (hCurrent != hBase) CloseHandle(hCurrent);
                 return;
             }
         }
-        // Can also perform hash checks for directories
-        // But we ignore it for now (allow for new files by default)
-        // In future it might be implemented
+        // Directory hash is not recomputed: its items were checked one by one above,
+        // and new ones found by diff in exact entries mode. New items are allowed by default
     }
     if (hCurrent != hBase) CloseHandle(hCurrent);
 
     // Warning: massive spam to event log if checking many files
 #ifdef REPORT_SUCCESSFUL_CHECKS
     snprintf(buf, BUF_LEN-1, "Path '%s': OK", szPath);
-    SvcReportEvent(EVENTLOG_INFORMATION_TYPE, buf);
+    ReportLogAdd(pLog, EVENTLOG_INFORMATION_TYPE, buf);
 #endif
 }
 
 
-void VerifyNodeReg(cJSON* jsonNode, HKEY hBase) {
+void VerifyNodeReg(cJSON* jsonNode, HKEY hBase, HASH_ALG alg, REPORT_LOG* pLog) {
     /**
      * @brief Verify HashNode against actual sub-key or value
      *
@@ -433,16 +1687,17 @@ void VerifyNodeReg(cJSON* jsonNode, HKEY hBase) {
      * -------------------------------------------------------------------------------------- *
      *    Hash for value is computed as:
      *
-     *      MD5( dwType | rbValue )
+     *      H( dwType | rbValue )
      *
-     *    where  dwType   -  4-byte DWORD (usually little-endian),
+     *    where  H        -  object's hash algorithm,
+     *           dwType   -  4-byte DWORD (usually little-endian),
      *           rbValue  -  byte buffer for value,
      *            |       -  concat operation
      *
      * -------------------------------------------------------------------------------------- *
      *    Hash for key is computed as:
      *
-     *      MD5( MD5(valueName1)^...^MD5(valueNameN) ^ MD5[MD5(keyName1)^...^MD5(keyNameM)] )
+     *      H( H(valueName1)^...^H(valueNameN) ^ H[H(keyName1)^...^H(keyNameM)] )
      *
      *    where  valueName1...valueNameN  -  values in key
      *           keyName1...keyNameM      -  sub-keys contained in key
@@ -480,37 +1735,45 @@ void VerifyNodeReg(cJSON* jsonNode, HKEY hBase) {
                 snprintf(buf, BUF_LEN-1, "Key '%s': Missing", szName);
             else snprintf(buf, BUF_LEN-1, "Key '%s': Failed to open (%lu)", szName, res);
 
-            SvcReportEvent(EVENTLOG_WARNING_TYPE, buf);
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
             return;
         }
     }  // name not set -> it is root, use hBase instead
 
     // Check slaves (recursive)
-    if (hasSlaves)
-        for (int i = 0; i < cJSON_GetArraySize(jsonSlaves); i++)
-            VerifyNodeReg(cJSON_GetArrayItem(jsonSlaves, i), hCurrent);
+    if (hasSlaves) {
+        cJSON* jsonSlave;
+        cJSON_ArrayForEach(jsonSlave, jsonSlaves)
+            VerifyNodeReg(jsonSlave, hCurrent, alg, pLog);
+    }
 
     // Verify hash (if set)
     cJSON* jsonHash = cJSON_GetObjectItem(jsonNode, "hash");
     if (jsonHash && cJSON_IsString(jsonHash)) {
-        LPTSTR szExpectedHash = cJSON_GetStringValue(jsonHash);
-        TCHAR szActualHash[MD5LEN*2 + 1] = {0};
+        HASH_DIGEST expected, actual;
+
+        if (!Hash_Decode(cJSON_GetStringValue(jsonHash), Hash_DigestLen(alg), &expected)) {
+            snprintf(buf, BUF_LEN-1, "Key '%s': Malformed hash in Object List", szName ? szName : "\\");
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
+            if (hCurrent != hBase) RegCloseKey(hCurrent);
+            return;
+        }
 
         if (hasSlaves)
-            res = MD5_RegKeyHashDigest(hCurrent, szActualHash);
+            res = Hash_RegKeyDigest(alg, hCurrent, &actual);
         else
-            res = MD5_RegValueHashDigest(hBase, szName, szActualHash);
+            res = Hash_RegValueDigest(alg, hBase, szName, &actual);
 
         if (res != ERROR_SUCCESS) {
             snprintf(buf, BUF_LEN-1, "Key '%s': Could not compute hash", szName ? szName : "\\");
-            SvcReportEvent(EVENTLOG_WARNING_TYPE, buf);
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
             if (hCurrent != hBase) RegCloseKey(hCurrent);
             return;
         }
 
-        else if (0 != strncmp(szExpectedHash, szActualHash, MD5LEN * 2)) {
+        else if (!Hash_Equal(&expected, &actual, Hash_DigestLen(alg))) {
             snprintf(buf, BUF_LEN-1, "Key '%s': Modified (hash mismatch)", szName ? szName : "\\");
-            SvcReportEvent(EVENTLOG_WARNING_TYPE, buf);
+            ReportLogAdd(pLog, EVENTLOG_WARNING_TYPE, buf);
             if (hCurrent != hBase) RegCloseKey(hCurrent);
             return;
         }
@@ -522,7 +1785,7 @@ void VerifyNodeReg(cJSON* jsonNode, HKEY hBase) {
     // Shouldn't really spam event log, but who knows...
     if (szName) {
         snprintf(buf, BUF_LEN-1, "Key '%s': OK", szName);
-        SvcReportEvent(EVENTLOG_INFORMATION_TYPE, buf);
+        ReportLogAdd(pLog, EVENTLOG_INFORMATION_TYPE, buf);
     }
 #endif
 }
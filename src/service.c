@@ -165,7 +165,7 @@ void SvcInit(DWORD argc, LPTSTR *argv) {
     ReportSvcStatus(SERVICE_RUNNING, NO_ERROR, 0);
 
     // Run worker routine
-    ServiceLoop(ghSvcStopEvent);
+    ServiceLoop(ghSvcStopEvent, TRUE);
 
     ReportSvcStatus(SERVICE_STOPPED, NO_ERROR, 0);
 }
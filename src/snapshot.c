@@ -1,37 +1,340 @@
 #include <stdio.h>
 #include <tchar.h>
-#include "md5.h"
+#include "digest.h"
+#include "taskpool.h"
 #include "utils.h"
+#include "cfg.h"
+#include "dirhash.h"
 #include "snapshot.h"
 
 
 #define BUF_LEN 256
 
+// Folders deeper than this below object's root are not listed: each one nests two levels of JSON
+// (node and its slaves), and Object List or actual state nested past CJSON_NESTING_LIMIT is not parsed back
+#ifndef SNAPSHOT_MAX_DEPTH
+#define SNAPSHOT_MAX_DEPTH  ((CJSON_NESTING_LIMIT - 8) / 2)
+#endif
+
+
+/*
+ *  Files of one directory waiting to be hashed together (see Hash_FileDigestBatch)
+ */
+typedef struct {
+    const OBJECT_OPTIONS* pOptions;
+    DWORD nFiles;
+    LPCTSTR szDirPath;              // files are named by it and their node's name, in reports
+    HANDLE rghFiles[HASH_BATCH_SIZE];
+    cJSON* rgJsonNodes[HASH_BATCH_SIZE];
+} SNAPSHOT_BATCH;
+
+
+/*
+ *  Slave of previous HashTree node, found by name (see FindPrevSlave)
+ */
+typedef struct {
+    LPCTSTR szName;
+    cJSON* jsonNode;
+} NODE_REF;
+
+
+/*
+ *  State shared by all threads of one snapshot
+ */
+typedef struct {
+    const OBJECT_OPTIONS* pOptions;
+    DIR_META_CACHE dirMeta;
+    CRITICAL_SECTION csDirMeta;
+    volatile LONG64 nFilesReused, cbReused;     // on update: files kept from last snapshot (see ReusePrevFile)
+    volatile LONG64 nFilesHashed, cbHashed;     //  and files read
+} SNAPSHOT_CONTEXT;
+
+
+/*
+ *  Directory whose items are not all hashed yet: task of snapshot pool (see SnapshotDirTask)
+ */
+typedef struct SNAPSHOT_DIR {
+    struct SNAPSHOT_DIR* pParent;   // NULL for root
+    cJSON* jsonNode;                // has no hash until complete
+    cJSON* jsonPrev;
+    HANDLE hDir;                    // closed once listed, unless it is base handle (root)
+    volatile LONG nPending;         // own listing and unfinished sub-folders
+    volatile LONG isFailed;         // listing is incomplete: no hash, no meta
+    int nDepth;                     // folders above it, up to object's root
+    LPTSTR szPath;                  // for reports, any length: items are listed and opened by hDir
+} SNAPSHOT_DIR;
+
+
+static cJSON* SnapshotNodeFileBatched(HANDLE hBase, LPCTSTR szPath, LPCTSTR szName, const HASH_NODE_INFO* pInfo,
+                                     SNAPSHOT_CONTEXT* pCtx, cJSON* jsonPrev, SNAPSHOT_BATCH* pBatch, SNAPSHOT_DIR** ppDir);
+
+
+static void AddDigestToNode(cJSON* jsonNode, LPCTSTR szKey, const HASH_DIGEST* pDigest, HASH_ALG alg, HASH_ENCODING enc) {
+    /**
+     * @brief Set "hash" (or "sample") of node: digest in object's text encoding
+     */
+    TCHAR szHash[HASH_TEXT_BUF_LEN];
+    Hash_Encode(pDigest, Hash_DigestLen(alg), enc, szHash);
+    cJSON_AddStringToObject(jsonNode, szKey, szHash);
+}
+
+
+static int CompareNodeRefs(const void* a, const void* b) {
+    return _tcscmp(((const NODE_REF*) a)->szName, ((const NODE_REF*) b)->szName);
+}
+
+
+static NODE_REF* IndexPrevSlaves(cJSON* jsonPrev, int* pnRefs) {
+    /**
+     * @brief Sort slaves of previous directory node by name, so each new slave finds its old node in log time
+     *
+     * @details Returns NULL (nothing to reuse) if node has no named slaves or out of memory
+     */
+    cJSON* jsonSlaves = jsonPrev ? cJSON_GetObjectItem(jsonPrev, "slaves") : NULL;
+    cJSON* jsonSlave;
+    int nRefs = 0;
+
+    *pnRefs = 0;
+    if (!jsonSlaves || !cJSON_IsArray(jsonSlaves) || !cJSON_GetArraySize(jsonSlaves)) return NULL;
+
+    NODE_REF* pRefs = malloc(cJSON_GetArraySize(jsonSlaves) * sizeof(NODE_REF));
+    if (!pRefs) return NULL;
+
+    cJSON_ArrayForEach(jsonSlave, jsonSlaves) {
+        cJSON* jsonName = cJSON_GetObjectItem(jsonSlave, "name");
+        if (!jsonName || !cJSON_IsString(jsonName)) continue;
+        pRefs[nRefs].szName = cJSON_GetStringValue(jsonName);
+        pRefs[nRefs].jsonNode = jsonSlave;
+        nRefs++;
+    }
+
+    qsort(pRefs, nRefs, sizeof(NODE_REF), CompareNodeRefs);
+    *pnRefs = nRefs;
+    return pRefs;
+}
+
+
+static cJSON* FindPrevSlave(const NODE_REF* pRefs, int nRefs, LPCTSTR szName) {
+    NODE_REF key = {szName, NULL};
+    if (!pRefs) return NULL;
+    NODE_REF* pFound = bsearch(&key, pRefs, nRefs, sizeof(NODE_REF), CompareNodeRefs);
+    return pFound ? pFound->jsonNode : NULL;
+}
 
-cJSON* SnapshotObject(DWORD dwType, LPCTSTR szObjectName, LPCTSTR szPath) {
+
+static void SortSlaves(cJSON* jsonSlaves) {
+    /**
+     * @brief Put slaves of directory node in name order, so HashTree does not depend on scheduling
+     *
+     * @details Left in listing order if out of memory: directory hash does not depend on it
+     */
+    int nRefs = cJSON_GetArraySize(jsonSlaves);
+    if (nRefs < 2) return;
+
+    NODE_REF* pRefs = malloc(nRefs * sizeof(NODE_REF));
+    if (!pRefs) return;
+
+    for (int i = 0; i < nRefs; i++) {
+        pRefs[i].jsonNode = cJSON_DetachItemFromArray(jsonSlaves, 0);
+        pRefs[i].szName = cJSON_GetStringValue(cJSON_GetObjectItem(pRefs[i].jsonNode, "name"));
+        if (!pRefs[i].szName) pRefs[i].szName = _T("");
+    }
+    qsort(pRefs, nRefs, sizeof(NODE_REF), CompareNodeRefs);
+    for (int i = 0; i < nRefs; i++)
+        cJSON_AddItemToArray(jsonSlaves, pRefs[i].jsonNode);
+    free(pRefs);
+}
+
+
+static void CountNodeFiles(cJSON* jsonNode, LONG64* pnFiles, LONG64* pcbFiles) {
+    /**
+     * @brief Count files of HashNode's subtree, and their recorded size
+     *
+     * @details Recursion is as deep as tree, which cJSON bounds when it parses Object List
+     */
+    cJSON* jsonSlaves = cJSON_GetObjectItem(jsonNode, "slaves");
+    cJSON* jsonSlave;
+
+    if (!jsonSlaves) {
+        cJSON* jsonSize = cJSON_GetObjectItem(jsonNode, "size");
+        (*pnFiles)++;
+        if (jsonSize && cJSON_IsNumber(jsonSize)) *pcbFiles += (LONG64) cJSON_GetNumberValue(jsonSize);
+        return;
+    }
+    cJSON_ArrayForEach(jsonSlave, jsonSlaves)
+        CountNodeFiles(jsonSlave, pnFiles, pcbFiles);
+}
+
+
+static BOOL CopyPrevItems(cJSON* jsonNode, cJSON* jsonPrev, const LPCTSTR* rgszKeys, int nKeys) {
+    /**
+     * @brief Copy items of previous node to new one, those it has. FALSE if out of memory: none are copied
+     */
+    for (int i = 0; i < nKeys; i++) {
+        cJSON* jsonItem = cJSON_GetObjectItem(jsonPrev, rgszKeys[i]);
+        if (!jsonItem) continue;
+        cJSON* jsonCopy = cJSON_Duplicate(jsonItem, TRUE);
+        if (!jsonCopy) {
+            while (i--) cJSON_DeleteItemFromObject(jsonNode, rgszKeys[i]);
+            return FALSE;
+        }
+        cJSON_AddItemToObject(jsonNode, rgszKeys[i], jsonCopy);
+    }
+    return TRUE;
+}
+
+
+static BOOL IsDigestOf(cJSON* jsonNode, LPCTSTR szKey, HASH_ALG alg) {
+    /**
+     * @brief Whether digest of node decodes to object's digest length: not made by an algorithm of other width
+     */
+    HASH_DIGEST digest;
+    cJSON* jsonDigest = cJSON_GetObjectItem(jsonNode, szKey);
+    return jsonDigest && cJSON_IsString(jsonDigest) &&
+           Hash_Decode(cJSON_GetStringValue(jsonDigest), Hash_DigestLen(alg), &digest);
+}
+
+
+static BOOL ReusePrevFile(cJSON* jsonNode, cJSON* jsonPrev, const HASH_NODE_INFO* pInfo, SNAPSHOT_CONTEXT* pCtx) {
+    /**
+     * @brief On update: if file has same size, times and id as in last snapshot, give it old node's
+     *  digests (hash, sample, tree chunk, CDC chunks) and metadata, and do not read it
+     *
+     * @details Same trust as metadata check mode (see CHECK_METADATA). Digests must be of object's length,
+     *  CDC chunks readable. FALSE if file is to be hashed: node is left as it was
+     */
+    static const LPCTSTR rgszKeys[] = {_T("hash"), _T("sample"), _T("tree_chunk"), _T("chunks")};
+    HASH_ALG alg = pCtx->pOptions->alg;
+    FILE_META expected, actual;
+    HASH_CDC_CHUNK* pChunks;
+    size_t nChunks;
+
+    if (!jsonPrev || cJSON_GetObjectItem(jsonPrev, "slaves") || !GetNodeFileMeta(jsonPrev, &expected)) return FALSE;
+    if (!IsDigestOf(jsonPrev, "hash", alg)) return FALSE;
+    if (cJSON_GetObjectItem(jsonPrev, "sample") && !IsDigestOf(jsonPrev, "sample", alg)) return FALSE;
+    if (cJSON_GetObjectItem(jsonPrev, "chunks")) {
+        if (!GetNodeChunks(jsonPrev, alg, &pChunks, &nChunks)) return FALSE;
+        free(pChunks);
+    }
+
+    CopyFileMeta(pInfo, &actual);
+    if (!IsSameFileMeta(&expected, &actual)) return FALSE;
+
+    if (!CopyPrevItems(jsonNode, jsonPrev, rgszKeys, sizeof(rgszKeys) / sizeof(rgszKeys[0]))) return FALSE;
+    AddFileMetaToNode(jsonNode, &actual);
+
+    InterlockedIncrement64(&pCtx->nFilesReused);
+    InterlockedExchangeAdd64(&pCtx->cbReused, (LONG64) actual.cbSize);
+    return TRUE;
+}
+
+
+static BOOL ReusePrevDir(cJSON* jsonNode, cJSON* jsonPrev, const HASH_DIGEST* pMeta, SNAPSHOT_CONTEXT* pCtx) {
+    /**
+     * @brief On update: if nothing under folder changed since last snapshot (same meta, see dirhash.h),
+     *  give it old node's hash and whole subtree, and do not walk it
+     *
+     * @details Hash and meta must be of object's digest length. FALSE if folder is to be walked:
+     *  node is left as it was
+     */
+    static const LPCTSTR rgszKeys[] = {_T("hash"), _T("slaves")};
+    HASH_ALG alg = pCtx->pOptions->alg;
+    HASH_DIGEST expected;
+    LONG64 nFiles = 0, cbFiles = 0;
+
+    if (!jsonPrev || !cJSON_IsArray(cJSON_GetObjectItem(jsonPrev, "slaves"))) return FALSE;
+    if (!IsDigestOf(jsonPrev, "hash", alg)) return FALSE;
+
+    cJSON* jsonMeta = cJSON_GetObjectItem(jsonPrev, "meta");
+    if (!jsonMeta || !cJSON_IsString(jsonMeta) ||
+        !Hash_Decode(cJSON_GetStringValue(jsonMeta), Hash_DigestLen(alg), &expected) ||
+        !Hash_Equal(&expected, pMeta, Hash_DigestLen(alg)))
+        return FALSE;
+
+    if (!CopyPrevItems(jsonNode, jsonPrev, rgszKeys, sizeof(rgszKeys) / sizeof(rgszKeys[0]))) return FALSE;
+
+    CountNodeFiles(jsonPrev, &nFiles, &cbFiles);
+    InterlockedExchangeAdd64(&pCtx->nFilesReused, nFiles);
+    InterlockedExchangeAdd64(&pCtx->cbReused, cbFiles);
+    return TRUE;
+}
+
+
+static LPCTSTR BatchFileName(SNAPSHOT_BATCH* pBatch, DWORD i) {
+    return cJSON_GetStringValue(cJSON_GetObjectItem(pBatch->rgJsonNodes[i], "name"));
+}
+
+
+static void FlushSnapshotBatch(SNAPSHOT_BATCH* pBatch) {
+    /**
+     * @brief Hash pending files, set their "hash" and close handles
+     */
+    HASH_DIGEST rgDigests[HASH_BATCH_SIZE];
+    DWORD rgdwStatus[HASH_BATCH_SIZE];
+
+    if (!pBatch->nFiles) return;
+
+    const OBJECT_OPTIONS* pOptions = pBatch->pOptions;
+
+    Hash_FileDigestBatch(pOptions->alg, pOptions->scan, pBatch->rghFiles, pBatch->nFiles, rgDigests, rgdwStatus);
+
+    for (DWORD i = 0; i < pBatch->nFiles; i++) {
+        // If failed, store NULL hash: we mark presence of file but don't snapshot its contents
+        if (rgdwStatus[i] != ERROR_SUCCESS) {
+            printf("File '%s\\%s': Could not compute hash\n", pBatch->szDirPath, BatchFileName(pBatch, i));
+            cJSON_AddNullToObject(pBatch->rgJsonNodes[i], "hash");
+        }
+        else AddDigestToNode(pBatch->rgJsonNodes[i], "hash", &rgDigests[i], pOptions->alg, pOptions->enc);
+
+        CloseHandle(pBatch->rghFiles[i]);
+#ifdef REPORT_SUCCESSFUL_CHECKS
+        printf("Snapshot of path '%s\\%s': Done\n", pBatch->szDirPath, BatchFileName(pBatch, i));
+#endif
+    }
+    pBatch->nFiles = 0;
+}
+
+
+cJSON* SnapshotObject(DWORD dwType, LPCTSTR szObjectName, LPCTSTR szPath, const OBJECT_OPTIONS* pOptions, cJSON* jsonPrevRoot) {
     /**
      * @brief Create HashTree of object
      *
      * @details Given object as Folder or Key, make a JSON:
      *      string  object_name
      *      DWORD   type
+     *      string  algorithm
+     *      string  scan    -(files only)
+     *      string  check   -(files only)
+     *      string  chunking -(files only)
+     *      string  entries -(files only)
+     *      string  encoding
      *      string  path
      *      cJSON   root
      *
      *  Where root is the root HashNode of HashTree, given as cJSON:
      *      string  name    -(for root)
-     *      string  hash    -(skip hash check?)
+     *      string  hash    -(files, folders (see dirhash.h), registry keys and values)
+     *      string  meta    -(folders only, see dirhash.h)
+     *      number  size    -(files only: size, mtime, ctime, file_id, see AddFileMetaToNode)
+     *      string  sample  -(huge files only, see Hash_FileRawSample)
+     *      [array] chunks  -(large files, cdc chunking only: [size, fingerprint, hash] of each chunk)
      *      [cJSON] slaves
+     *
+     *  Every hash in tree is computed with object's algorithm and written in its encoding.
+     *  Files are read in its scan mode. jsonPrevRoot is root of last snapshot of object (on update),
+     *  or NULL: files and folders not changed since (same metadata) keep their nodes without being read,
+     *  and chunks of changed CDC files found there are not hashed again
      */
 
-    TCHAR szFinalPath[MAX_PATH];
+    HASH_PATH_BUF finalPath;
     HANDLE hBaseHnd;
     HKEY hkBaseKey, hkRoot;
     DWORD dwBackslashIndex;
     cJSON* jsonRootNode;
     int res;
 
-    printf("Making snapshot of object '%s'...\n", szObjectName);
+    printf("Making snapshot of object '%s' (%s, %s)...\n", szObjectName,
+           Hash_GetProvider(pOptions->alg)->szName, Hash_KernelName(pOptions->alg));
 
     cJSON* jsonObject = cJSON_CreateObject();
     if (!jsonObject) return NULL;
@@ -39,6 +342,8 @@ cJSON* SnapshotObject(DWORD dwType, LPCTSTR szObjectName, LPCTSTR szPath) {
     // Set basic properties
     cJSON_AddStringToObject(jsonObject, "object_name", szObjectName);
     cJSON_AddNumberToObject(jsonObject, "type", dwType);
+    cJSON_AddStringToObject(jsonObject, "algorithm", Hash_GetProvider(pOptions->alg)->szName);
+    cJSON_AddStringToObject(jsonObject, "encoding", Hash_EncodingName(pOptions->enc));
 
     // Check presence and get base handle, proceed to node snapshot
     switch (dwType) {
@@ -62,12 +367,20 @@ cJSON* SnapshotObject(DWORD dwType, LPCTSTR szObjectName, LPCTSTR szPath) {
                 return NULL;
             }
 
+            cJSON_AddStringToObject(jsonObject, "scan", Hash_ScanName(pOptions->scan));
+            cJSON_AddStringToObject(jsonObject, "check", CheckModeName(pOptions->check));
+            cJSON_AddStringToObject(jsonObject, "chunking", ChunkingName(pOptions->chunking));
+            cJSON_AddStringToObject(jsonObject, "entries", EntriesModeName(pOptions->entries));
+
             // Set actual absolute path
-            GetFinalPathNameByHandle(hBaseHnd, szFinalPath, MAX_PATH, VOLUME_NAME_DOS);
-            cJSON_AddStringToObject(jsonObject, "path", szFinalPath);
+            if (InitHandlePath(&finalPath, hBaseHnd)) {
+                cJSON_AddStringToObject(jsonObject, "path", finalPath.szPath);
+                Hash_PathFree(&finalPath);
+            }
+            else cJSON_AddStringToObject(jsonObject, "path", szPath);
 
             // Proceed to node backup
-            jsonRootNode = SnapshotNodeFile(hBaseHnd, NULL);
+            jsonRootNode = SnapshotNodeFile(hBaseHnd, NULL, 0, pOptions, jsonPrevRoot);
             CloseHandle(hBaseHnd);
             if (!jsonRootNode) { cJSON_Delete(jsonObject); return NULL; }
 
@@ -100,7 +413,7 @@ cJSON* SnapshotObject(DWORD dwType, LPCTSTR szObjectName, LPCTSTR szPath) {
             cJSON_AddStringToObject(jsonObject, "path", szPath);
 
             // Proceed to node snapshot
-            jsonRootNode = SnapshotNodeReg(hkBaseKey, NULL, TRUE);
+            jsonRootNode = SnapshotNodeReg(hkBaseKey, NULL, TRUE, pOptions);
             RegCloseKey(hkBaseKey);
             if (!jsonRootNode) { cJSON_Delete(jsonObject); return NULL; }
 
@@ -116,65 +429,439 @@ cJSON* SnapshotObject(DWORD dwType, LPCTSTR szObjectName, LPCTSTR szPath) {
 }
 
 
-cJSON* SnapshotNodeFile(HANDLE hBase, LPCTSTR szName) {
+static cJSON* FindSlave(cJSON* jsonNode, LPCTSTR szName) {
+    cJSON* jsonSlave;
+    cJSON_ArrayForEach(jsonSlave, cJSON_GetObjectItem(jsonNode, "slaves")) {
+        LPCTSTR szSlaveName = cJSON_GetStringValue(cJSON_GetObjectItem(jsonSlave, "name"));
+        if (szSlaveName && !_tcscmp(szSlaveName, szName)) return jsonSlave;
+    }
+    return NULL;
+}
+
+
+static void SetNodeDigest(cJSON* jsonNode, LPCTSTR szKey, const HASH_DIGEST* pDigest, const OBJECT_OPTIONS* pOptions) {
+    /**
+     * @brief Replace digest of node (or remove it, if pDigest is NULL)
+     */
+    cJSON_DeleteItemFromObject(jsonNode, szKey);
+    if (pDigest) AddDigestToNode(jsonNode, szKey, pDigest, pOptions->alg, pOptions->enc);
+}
+
+
+static void SumUpDirNode(cJSON* jsonNode, const OBJECT_OPTIONS* pOptions) {
+    /**
+     * @brief Set hash and meta of directory node again, from its slaves as they are in HashTree
+     */
+    cJSON* jsonSlaves = cJSON_GetObjectItem(jsonNode, "slaves");
+    HASH_DIGEST digest;
+
+    if (GetSlavesDigest(jsonSlaves, pOptions->alg, &digest)) SetNodeDigest(jsonNode, "hash", &digest, pOptions);
+    else {
+        cJSON_DeleteItemFromObject(jsonNode, "hash");
+        cJSON_AddNullToObject(jsonNode, "hash");
+    }
+    SetNodeDigest(jsonNode, "meta", GetSlavesMeta(jsonSlaves, pOptions->alg, &digest) ? &digest : NULL, pOptions);
+
+    // Lists of older versions: names digest is no longer kept, drop it rather than leave it stale
+    cJSON_DeleteItemFromObject(jsonNode, "names");
+}
+
+
+static BOOL SpliceSubPath(cJSON* jsonRoot, HANDLE* rghDirs, int* pnOpen, LPCTSTR* rgszNames, int nNames,
+                          LPCTSTR szSubPath, const OBJECT_OPTIONS* pOptions, cJSON* jsonPrev) {
+    /**
+     * @brief Go down to item's folder, from object's folder open in rghDirs[0], and replace item's node
+     *
+     * @details Folders are opened into rghDirs, *pnOpen counts them, caller closes them.
+     *  HashTree is only changed once item is snapshot (or found gone)
+     */
+    cJSON** rgjsonDirs = malloc(nNames * sizeof(cJSON*));
+    TREE_CHANGES changes = {0};
+    HANDLE hItem;
+    DWORD res;
+
+    if (!rgjsonDirs) {
+        printf("Failed: Out of memory\n");
+        return FALSE;
+    }
+    rgjsonDirs[0] = jsonRoot;
+
+    // Folders above item: in HashTree and on disk
+    for (int i = 0; i < nNames - 1; i++) {
+        cJSON* jsonDir = FindSlave(rgjsonDirs[i], rgszNames[i]);
+        if (!jsonDir || !cJSON_IsArray(cJSON_GetObjectItem(jsonDir, "slaves"))) {
+            printf("Failed: folder '%s' is not in object. Update its parent folder instead\n", rgszNames[i]);
+            free(rgjsonDirs);
+            return FALSE;
+        }
+        res = Hash_OpenAt(rghDirs[i], rgszNames[i], HASH_SCAN_CACHED, &rghDirs[i + 1]);
+        if (res != ERROR_SUCCESS) {
+            printf("Folder '%s': Failed to open (%lu)\n", rgszNames[i], res);
+            free(rgjsonDirs);
+            return FALSE;
+        }
+        rgjsonDirs[i + 1] = jsonDir;
+        (*pnOpen)++;
+    }
+
+    HANDLE hParent = rghDirs[nNames - 1];
+    cJSON* jsonParent = rgjsonDirs[nNames - 1];
+    cJSON* jsonSlaves = cJSON_GetObjectItem(jsonParent, "slaves");
+    LPCTSTR szName = rgszNames[nNames - 1];
+    cJSON* jsonOld = FindSlave(jsonParent, szName);
+
+    // Item itself: removed, or snapshot again
+    res = Hash_OpenAt(hParent, szName, HASH_SCAN_CACHED, &hItem);
+    if (res == ERROR_FILE_NOT_FOUND || res == ERROR_PATH_NOT_FOUND) {
+        if (!jsonOld) {
+            printf("File '%s': Missing, and not in object\n", szSubPath);
+            free(rgjsonDirs);
+            return FALSE;
+        }
+        printf("File '%s': Missing, removed from object\n", szSubPath);
+        cJSON_Delete(cJSON_DetachItemViaPointer(jsonSlaves, jsonOld));
+        changes.nRemoved++;
+    }
+    else if (res != ERROR_SUCCESS) {
+        printf("File '%s': Failed to open (%lu)\n", szSubPath, res);
+        free(rgjsonDirs);
+        return FALSE;
+    }
+    else {
+        CloseHandle(hItem);
+        cJSON* jsonNew = SnapshotNodeFile(hParent, szName, nNames, pOptions, jsonPrev ? jsonPrev : jsonOld);
+        if (!jsonNew) {
+            free(rgjsonDirs);
+            return FALSE;
+        }
+
+        if (jsonOld) {
+            CountTreeChanges(jsonOld, jsonNew, &changes);
+            cJSON_ReplaceItemViaPointer(jsonSlaves, jsonOld, jsonNew);
+        }
+        else {
+            changes.nAdded++;
+            cJSON_AddItemToArray(jsonSlaves, jsonNew);
+            SortSlaves(jsonSlaves);
+        }
+    }
+    printf("Since last snapshot: %lu modified, %lu added, %lu removed\n", changes.nModified, changes.nAdded, changes.nRemoved);
+
+    // Folders above it, bottom up
+    for (int i = nNames - 1; i >= 0; i--)
+        SumUpDirNode(rgjsonDirs[i], pOptions);
+
+    free(rgjsonDirs);
+    return TRUE;
+}
+
+
+WINBOOL SnapshotSubPath(cJSON* jsonObject, LPCTSTR szSubPath, const OBJECT_OPTIONS* pOptions, cJSON* jsonPrev) {
+    /**
+     * @brief Re-snapshot one file or folder of file object and splice it into object's HashTree
+     *
+     * @details szSubPath is relative to object's path ('\' or '/' separated). Folders above it must be
+     *  in HashTree already; they are opened one by one relative to their parent (see Hash_OpenAt), and
+     *  once item is replaced, summed up again from their slaves (see SumUpDirNode), bottom to root.
+     *  Rest of tree is not touched. Item gone from disk is removed from its folder.
+     *
+     *  Item is snapshot with its old node (see SnapshotNodeFile), or jsonPrev if set (ex. actual node found
+     *  by verification): what did not change under it is not read. On failure, HashTree is left as it was
+     */
+    cJSON* jsonRoot = cJSON_GetObjectItem(jsonObject, "root");
+    LPCTSTR szPath = cJSON_GetStringValue(cJSON_GetObjectItem(jsonObject, "path"));
+    int nNames = 0, nOpen = 0;
+    BOOL isOk = FALSE;
+
+    if (!jsonRoot || !szPath || !cJSON_IsArray(cJSON_GetObjectItem(jsonRoot, "slaves"))) {
+        printf("Failed: object is not a folder. Update it whole\n");
+        return FALSE;
+    }
+
+    // Names along path, down from object's folder: separators cut to terminators
+    LPTSTR szNames = _tcsdup(szSubPath);
+    size_t cchNames = szNames ? _tcslen(szNames) : 0;
+    LPCTSTR* rgszNames = malloc((cchNames / 2 + 1) * sizeof(LPCTSTR));
+    HANDLE* rghDirs = malloc((cchNames / 2 + 1) * sizeof(HANDLE));
+    if (!szNames || !rgszNames || !rghDirs) {
+        printf("Failed: Out of memory\n");
+        free(szNames);
+        free(rgszNames);
+        free(rghDirs);
+        return FALSE;
+    }
+
+    for (size_t i = 0; i < cchNames; i++) {
+        if (szNames[i] == '\\' || szNames[i] == '/') szNames[i] = '\0';
+        else if (i == 0 || szNames[i - 1] == '\0') rgszNames[nNames++] = szNames + i;
+    }
+    for (int i = 0; i < nNames; i++)
+        if (!_tcscmp(rgszNames[i], _T(".")) || !_tcscmp(rgszNames[i], _T(".."))) nNames = 0;
+
+    if (!nNames) printf("Failed: '%s' is not a path inside object\n", szSubPath);
+    else {
+        rghDirs[0] = CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+        if (rghDirs[0] == INVALID_HANDLE_VALUE) printf("Object '%s': Failed to open (%lu)\n", szPath, GetLastError());
+        else {
+            nOpen = 1;
+            isOk = SpliceSubPath(jsonRoot, rghDirs, &nOpen, rgszNames, nNames, szSubPath, pOptions, jsonPrev);
+        }
+    }
+
+    while (nOpen) CloseHandle(rghDirs[--nOpen]);
+    free(szNames);
+    free(rgszNames);
+    free(rghDirs);
+    return isOk;
+}
+
+
+static void CompleteSnapshotDir(SNAPSHOT_DIR* pDir, const OBJECT_OPTIONS* pOptions) {
     /**
-     * @brief Verify HashNode against actual sub-folder or file
+     * @brief Count off one pending part of directory. Last one sets its hash (and meta), and so on up the tree
+     */
+    while (pDir && InterlockedDecrement(&pDir->nPending) == 0) {
+        SNAPSHOT_DIR* pParent = pDir->pParent;
+        cJSON* jsonSlavesArr = cJSON_GetObjectItem(pDir->jsonNode, "slaves");
+
+        SortSlaves(jsonSlavesArr);
+
+        // All items hashed: hash of directory. Null if any item could not be hashed, or not all were listed
+        HASH_DIGEST dirHash;
+        if (!pDir->isFailed && GetSlavesDigest(jsonSlavesArr, pOptions->alg, &dirHash))
+            AddDigestToNode(pDir->jsonNode, "hash", &dirHash, pOptions->alg, pOptions->enc);
+        else cJSON_AddNullToObject(pDir->jsonNode, "hash");
+
+        // Meta of subtree, unless taken from listings already (on update): from recorded metadata of items
+        HASH_DIGEST meta;
+        if (!pDir->isFailed && !cJSON_GetObjectItem(pDir->jsonNode, "meta") && GetSlavesMeta(jsonSlavesArr, pOptions->alg, &meta))
+            AddDigestToNode(pDir->jsonNode, "meta", &meta, pOptions->alg, pOptions->enc);
+
+        free(pDir->szPath);
+        free(pDir);
+        pDir = pParent;
+    }
+}
+
+
+static void SnapshotDirTask(HASH_WORKER* pWorker, void* pTask, void* pArg) {
+    /**
+     * @brief List directory: hash its files, push its sub-folders as new tasks
+     *
+     * @details Files of directory are hashed in batches, on this thread. Directory is complete
+     *  (see CompleteSnapshotDir) once it is listed and all its sub-folders are complete
+     */
+    SNAPSHOT_DIR* pDir = pTask;
+    SNAPSHOT_CONTEXT* pCtx = pArg;
+    const HASH_DIR_ENTRY* pEntries;
+    size_t nEntries;
+    HASH_PATH_BUF path;
+
+    cJSON* jsonSlavesArr = cJSON_GetObjectItem(pDir->jsonNode, "slaves");
+
+    // Files of this directory are hashed in batches
+    SNAPSHOT_BATCH* pDirBatch = malloc(sizeof(SNAPSHOT_BATCH));
+    if (pDirBatch) {
+        pDirBatch->pOptions = pCtx->pOptions;
+        pDirBatch->szDirPath = pDir->szPath;
+        pDirBatch->nFiles = 0;
+    }
+
+    // Old nodes of this directory's slaves, by name
+    int nPrevRefs;
+    NODE_REF* pPrevRefs = IndexPrevSlaves(pDir->jsonPrev, &nPrevRefs);
+
+    // Files and sub-folders, in bulk: type (and on Windows, metadata) of each comes with listing
+    // Path of each item: folder's own, its name appended and cut off again
+    BOOL isTooDeep = pDir->nDepth > SNAPSHOT_MAX_DEPTH;
+    BOOL hasPath = !isTooDeep && Hash_PathInit(&path, pDir->szPath);
+    HASH_DIR_READER* pReader = hasPath ? Hash_DirOpen(pDir->hDir) : NULL;
+    HASH_STATUS res = ERROR_SUCCESS;
+    while (pReader && ERROR_SUCCESS == (res = Hash_DirRead(pReader, &pEntries, &nEntries)) && nEntries) {
+        for (size_t i = 0; i < nEntries; i++) {
+            const HASH_DIR_ENTRY* pEntry = &pEntries[i];
+            SNAPSHOT_DIR* pSubDir = NULL;
+            size_t cchMark = path.cchPath;
+            if (!Hash_PathPush(&path, pEntry->szName)) {
+                printf("File '%s\\%s': Out of memory\n", pDir->szPath, pEntry->szName);
+                pDir->isFailed = TRUE;
+                continue;
+            }
+            cJSON* jsonPrevSlave = FindPrevSlave(pPrevRefs, nPrevRefs, pEntry->szName);
+            cJSON* jsonSlave = SnapshotNodeFileBatched(pDir->hDir, path.szPath, pEntry->szName,
+                                                       pEntry->hasInfo ? &pEntry->info : NULL,
+                                                       pCtx, jsonPrevSlave, pDirBatch, &pSubDir);
+            Hash_PathPop(&path, cchMark);
+
+            // Add to slaves list for current node
+            if (jsonSlave) cJSON_AddItemToArray(jsonSlavesArr, jsonSlave);
+
+            // Sub-folder: listed by any thread, this one goes on
+            if (pSubDir) {
+                pSubDir->pParent = pDir;
+                pSubDir->nDepth = pDir->nDepth + 1;
+                InterlockedIncrement(&pDir->nPending);
+                Hash_PoolPush(pWorker, pSubDir);
+            }
+
+            if (pDirBatch && pDirBatch->nFiles == HASH_BATCH_SIZE)
+                FlushSnapshotBatch(pDirBatch);
+        }
+    }
+    // Listing cut short: folder is failed, not hashed by the items it got to
+    if (isTooDeep) {
+        printf("Folder '%s': Deeper than %d folders, not listed\n", pDir->szPath, SNAPSHOT_MAX_DEPTH);
+        pDir->isFailed = TRUE;
+    }
+    else if (!pReader) {
+        printf("Folder '%s': Out of memory\n", pDir->szPath);
+        pDir->isFailed = TRUE;
+    }
+    else if (res != ERROR_SUCCESS) {
+        printf("Folder '%s': Failed to list (%lu)\n", pDir->szPath, res);
+        pDir->isFailed = TRUE;
+    }
+    Hash_DirClose(pReader);
+    if (hasPath) Hash_PathFree(&path);
+
+    if (pDirBatch) {
+        FlushSnapshotBatch(pDirBatch);
+        free(pDirBatch);
+    }
+    free(pPrevRefs);
+
+    if (pDir->pParent) CloseHandle(pDir->hDir);
+    CompleteSnapshotDir(pDir, pCtx->pOptions);
+}
+
+
+cJSON* SnapshotNodeFile(HANDLE hBase, LPCTSTR szName, int nDepth, const OBJECT_OPTIONS* pOptions, cJSON* jsonPrev) {
+    /**
+     * @brief Make HashNode of sub-folder or file (see SnapshotNodeFileBatched)
+     *
+     * @details Folders are listed by a work-stealing pool (see taskpool.h), each one a task,
+     *  on Parameters/SnapshotThreads threads (default: one per processor). Slaves are sorted
+     *  by name once hashed, so HashTree is the same for any number of threads. nDepth is
+     *  number of folders above item, up to object's root: ones below SNAPSHOT_MAX_DEPTH are not listed
+     */
+    SNAPSHOT_CONTEXT ctx;
+    SNAPSHOT_DIR* pDir = NULL;
+    HASH_PATH_BUF basePath;
+
+    ctx.pOptions = pOptions;
+    ctx.nFilesReused = ctx.cbReused = 0;
+    ctx.nFilesHashed = ctx.cbHashed = 0;
+    InitDirMetaCache(&ctx.dirMeta, pOptions->alg);
+    InitializeCriticalSection(&ctx.csDirMeta);
+
+    // Only path resolved by handle: items below are opened relative to their folder (see fswalk.h)
+    if (!InitHandlePath(&basePath, hBase)) {
+        printf("Snapshot: Out of memory\n");
+        DeleteCriticalSection(&ctx.csDirMeta);
+        FreeDirMetaCache(&ctx.dirMeta);
+        return NULL;
+    }
+
+    cJSON* jsonNode = NULL;
+    if (!szName || Hash_PathPush(&basePath, szName))
+        jsonNode = SnapshotNodeFileBatched(hBase, basePath.szPath, szName, NULL, &ctx, jsonPrev, NULL, &pDir);
+    Hash_PathFree(&basePath);
+    if (pDir) pDir->nDepth = nDepth;
+
+    // Folder: listed by pool. Its handle was opened here if it is not hBase, task only closes sub-folders'
+    HANDLE hDir = pDir ? pDir->hDir : NULL;
+    if (pDir && Hash_PoolRun(GetSnapshotThreads(), SnapshotDirTask, &ctx, (void**) &pDir, 1) != HASH_STATUS_OK) {
+        printf("Snapshot: Out of memory\n");
+        free(pDir->szPath);
+        free(pDir);
+        cJSON_Delete(jsonNode);
+        jsonNode = NULL;
+    }
+    if (hDir && hDir != hBase) CloseHandle(hDir);
+
+    if (jsonPrev && jsonNode)
+        printf("Reused %lld of %lld files (%lld of %lld MB) from last snapshot, %lld rehashed\n",
+               ctx.nFilesReused, ctx.nFilesReused + ctx.nFilesHashed, ctx.cbReused / (1024*1024),
+               (ctx.cbReused + ctx.cbHashed) / (1024*1024), ctx.nFilesHashed);
+
+    DeleteCriticalSection(&ctx.csDirMeta);
+    FreeDirMetaCache(&ctx.dirMeta);
+    return jsonNode;
+}
+
+
+static cJSON* SnapshotNodeFileBatched(HANDLE hBase, LPCTSTR szPath, LPCTSTR szName, const HASH_NODE_INFO* pInfo,
+                                     SNAPSHOT_CONTEXT* pCtx, cJSON* jsonPrev, SNAPSHOT_BATCH* pBatch, SNAPSHOT_DIR** ppDir) {
+    /**
+     * @brief Make HashNode of sub-folder or file
      *
      * @details go DFS
      *  for files:
-     *      - check presence
+     *      - check presence (opened relative to hBase, type and metadata read from handle)
+     *      - record metadata
+     *      - compute sample digest (huge files only)
      *      - compute hash
      *
      *  for directories:
      *      - check presence
-     *      - for each item:
-     *          recursive call
+     *      - on update: compare meta of subtree, from directory listings, and keep old node if same
+     *      - return task to list it in *ppDir (see SnapshotDirTask):
+     *          for each item:
+     *              recursive call
+     *      - once all items are hashed, compute hash from hashes of items, and meta
+     *        (unless taken from listings) from their metadata
+     *
+     *  Directory node is returned without hash and slaves, they are set by its task.
+     *  If pBatch is set, file is left open in pBatch and hashed later along with
+     *  its neighbours. Node is returned without hash; it is set by FlushSnapshotBatch()
+     *
+     *  jsonPrev is node of same path in last snapshot, or NULL. If item's metadata is the same as there,
+     *  its old node is reused and nothing is read (see ReusePrevFile, ReusePrevDir). szPath is full path of item, of any
+     *  length, only used to name it in reports (see HASH_PATH_BUF). pInfo is item's type and metadata from listing of
+     *  hBase (see Hash_DirRead); if NULL, they are queried from its handle
      *
      * -------------------------------------------------------------------------------------- *
-     *    Hash for key is computed as:
-     *        MD5( file contents )
+     *    Hash for file is computed as:
+     *        H( file contents )
+     *
+     *    using Hash_FileDigestBatch(), where H is object's hash algorithm
      *
-     *    using MD5_FileHashDigest()
+     *    Files of HASH_TREE_THRESHOLD and more get a tree digest instead (see treehash.h):
+     *    chunks are hashed on several threads, chunk size is stored as "tree_chunk".
+     *    With cdc chunking they get a CDC digest (see cdc.h) and their chunk list instead:
+     *    chunks found in jsonPrev (same size and fingerprint) keep their old digest
      *
      * -------------------------------------------------------------------------------------- *
-     *    Hash for directory is NOT computed (out-of-scope and new files are ignored)
+     *    Hash for directory is computed from names, types and hashes of its items (see dirhash.h).
+     *    Meta of directory sums up metadata of its subtree (see GetSlavesMeta): on update, from listings,
+     *    taken before any file in it is read, else from file nodes, each recorded before file is read
      *
      * -------------------------------------------------------------------------------------- *
      */
 
-    TCHAR szPath[MAX_PATH];
-
     HANDLE hCurrent;
     DWORD res;
     BOOL isDirectory;
+    HASH_NODE_INFO info;
+
+    const OBJECT_OPTIONS* pOptions = pCtx->pOptions;
 
     cJSON* jsonNode = cJSON_CreateObject();
     if (!jsonNode) return NULL;
 
-    // Get path by base handle:  szPath
-    res = GetFinalPathNameByHandle(hBase, szPath, MAX_PATH-1, VOLUME_NAME_DOS);
-    if (res <= 0) _tcscpy(szPath, _T("<unknown>"));
-
     // Set name (if present)
     if (szName) cJSON_AddStringToObject(jsonNode, "name", szName);
     else cJSON_AddNullToObject(jsonNode, "name");
 
+    // Unchanged file, as listed: not even opened
+    if (pInfo && !pInfo->isDirectory && ReusePrevFile(jsonNode, jsonPrev, pInfo, pCtx)) return jsonNode;
+
     // If name is set, check presence and obtain handle:  hCurrent
     if (szName) {
-        snprintf(szPath + _tcslen(szPath), MAX_PATH - _tcslen(szPath), "\\%s", szName);
-
         // Check presence, assuming hBase is valid
-        hCurrent = CreateFile(szPath,
-                               GENERIC_READ,
-                               FILE_SHARE_READ,
-                               0,
-                               OPEN_EXISTING,
-                               FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_SEQUENTIAL_SCAN,
-                               NULL);
-
-        if (hCurrent == INVALID_HANDLE_VALUE) {
-            res = GetLastError();
-            if (res == ERROR_FILE_NOT_FOUND)
+        res = Hash_OpenAt(hBase, szName, pOptions->scan, &hCurrent);
+        if (res != ERROR_SUCCESS) {
+            if (res == ERROR_FILE_NOT_FOUND || res == ERROR_PATH_NOT_FOUND)
                 printf("File '%s': Missing\n", szPath);
             else printf("File '%s': Failed to open (%lu)\n", szPath, res);
             cJSON_Delete(jsonNode);
@@ -183,46 +870,138 @@ cJSON* SnapshotNodeFile(HANDLE hBase, LPCTSTR szName) {
     }
     else hCurrent = hBase;  // szName not set -> it is root, use hBase instead
 
-    isDirectory = (GetFileAttributes(szPath) & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY;
+    // Type, size and metadata: from listing, or else in one query of open handle
+    if (pInfo) {
+        info = *pInfo;
+        res = ERROR_SUCCESS;
+    }
+    else res = Hash_QueryNode(hCurrent, &info);
+    if (res != ERROR_SUCCESS) {
+        printf("File '%s': Failed to query (%lu)\n", szPath, res);
+        if (hCurrent != hBase) CloseHandle(hCurrent);
+        cJSON_Delete(jsonNode);
+        return NULL;
+    }
+    isDirectory = info.isDirectory;
+
+    // Unchanged file, as queried from its handle
+    if (!pInfo && !isDirectory && ReusePrevFile(jsonNode, jsonPrev, &info, pCtx)) {
+        if (hCurrent != hBase) CloseHandle(hCurrent);
+        return jsonNode;
+    }
+
+    // File: record metadata, taken before contents are read (see VerifyNodeFileBatched)
+    FILE_META meta;
+    if (!isDirectory) {
+        CopyFileMeta(&info, &meta);
+        AddFileMetaToNode(jsonNode, &meta);
+        InterlockedIncrement64(&pCtx->nFilesHashed);
+        InterlockedExchangeAdd64(&pCtx->cbHashed, (LONG64) info.cbSize);
+    }
+
+    // Huge file: sample digest, for cheap checks between full ones (see CHECK_SAMPLED)
+    if (!isDirectory && info.cbSize >= HASH_SAMPLE_THRESHOLD) {
+        HASH_DIGEST sample;
+        if (ERROR_SUCCESS == Hash_FileDigestSample(pOptions->alg, pOptions->scan, hCurrent, &sample))
+            AddDigestToNode(jsonNode, "sample", &sample, pOptions->alg, pOptions->enc);
+    }
 
-    // Directory: add slaves (recursive)
+    // Directory: add slaves (recursive), by its own task
     if (isDirectory) {
 
-        cJSON* jsonSlavesArr = cJSON_AddArrayToObject(jsonNode, "slaves");
+        // On update: actual meta tells whether old subtree can be kept. Whole subtree is listed once,
+        // sub-folders take theirs from cache. Otherwise meta is summed up from slaves (see CompleteSnapshotDir)
+        if (jsonPrev && cJSON_IsArray(cJSON_GetObjectItem(jsonPrev, "slaves"))) {
+            // Cache is shared by all threads: copy digest out while it cannot grow
+            HASH_DIGEST dirMeta;
+            EnterCriticalSection(&pCtx->csDirMeta);
+            const DIR_META* pMeta = GetDirMeta(&pCtx->dirMeta, hCurrent, szPath);
+            BOOL hasMeta = (pMeta != NULL);
+            if (hasMeta) dirMeta = pMeta->meta;
+            LeaveCriticalSection(&pCtx->csDirMeta);
+            if (hasMeta) AddDigestToNode(jsonNode, "meta", &dirMeta, pOptions->alg, pOptions->enc);
+
+            // Nothing under it changed: old subtree as it was
+            if (hasMeta && ReusePrevDir(jsonNode, jsonPrev, &dirMeta, pCtx)) {
+                if (hCurrent != hBase) CloseHandle(hCurrent);
+                return jsonNode;
+            }
+        }
+
+        cJSON_AddArrayToObject(jsonNode, "slaves");
+
+        SNAPSHOT_DIR* pDir = malloc(sizeof(SNAPSHOT_DIR));
+        LPTSTR szDirPath = _tcsdup(szPath);
+        if (!pDir || !szDirPath) {
+            printf("Folder '%s': Out of memory\n", szPath);
+            cJSON_AddNullToObject(jsonNode, "hash");
+            free(pDir);
+            free(szDirPath);
+        }
+        else {
+            pDir->pParent = NULL;
+            pDir->jsonNode = jsonNode;
+            pDir->jsonPrev = jsonPrev;
+            pDir->hDir = hCurrent;
+            pDir->nPending = 1;
+            pDir->isFailed = FALSE;
+            pDir->nDepth = 0;
+            pDir->szPath = szDirPath;
+            *ppDir = pDir;
+            return jsonNode;
+        }
+    }
+    else if (info.cbSize >= HASH_TREE_THRESHOLD && pOptions->chunking == CHUNKING_CDC) {  // Large file: content-defined chunks
+        HASH_DIGEST actual;
+        HASH_CDC_CHUNK *pKnown = NULL, *pChunks;
+        size_t nKnown = 0, nChunks, nReused;
 
-        // Search for files and sub-folders. To do this, append '\*' to path:  C:\path\*
-        snprintf(szPath + _tcslen(szPath), MAX_PATH - _tcslen(szPath), "\\*");
-
-        WIN32_FIND_DATA wfd;
-        HANDLE hFind = FindFirstFile(szPath, &wfd);
-        if (hFind != INVALID_HANDLE_VALUE) {
-            do {
-                if (!(wfd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) &&
-                                      0 != _tcscmp(_T("."), wfd.cFileName) &&
-                                      0 != _tcscmp(_T(".."), wfd.cFileName)) {
-                    // Recursive call
-                    cJSON *jsonSlave = SnapshotNodeFile(hCurrent, wfd.cFileName);
-
-                    // Add to slaves list for current node
-                    if (jsonSlave) cJSON_AddItemToArray(jsonSlavesArr, jsonSlave);
-                }
-            } while (FindNextFile(hFind, &wfd));
-            FindClose(hFind);
+        // Chunks of last snapshot keep their digests
+        if (jsonPrev) GetNodeChunks(jsonPrev, pOptions->alg, &pKnown, &nKnown);
+
+        res = Hash_FileDigestCdc(pOptions->alg, pOptions->scan, hCurrent, pKnown, nKnown, &pChunks, &nChunks, &nReused, &actual);
+        if (res != ERROR_SUCCESS) {
+            printf("File '%s': Could not compute hash\n", szPath);
+            cJSON_AddNullToObject(jsonNode, "hash");
+        }
+        else {
+            AddDigestToNode(jsonNode, "hash", &actual, pOptions->alg, pOptions->enc);
+            AddChunksToNode(jsonNode, pChunks, nChunks, pOptions->alg, pOptions->enc);
+            if (nKnown) printf("File '%s': %zu of %zu chunks unchanged\n", szPath, nReused, nChunks);
+            free(pChunks);
         }
+        free(pKnown);
+    }
+    else if (info.cbSize >= HASH_TREE_THRESHOLD) {  // Large file: tree digest, chunks hashed in parallel
+        HASH_DIGEST actual;
+        res = Hash_FileDigestTree(pOptions->alg, pOptions->scan, hCurrent, HASH_TREE_CHUNK_LEN, &actual);
+        if (res != ERROR_SUCCESS) {
+            printf("File '%s': Could not compute hash\n", szPath);
+            cJSON_AddNullToObject(jsonNode, "hash");
+        }
+        else {
+            AddDigestToNode(jsonNode, "hash", &actual, pOptions->alg, pOptions->enc);
+            cJSON_AddNumberToObject(jsonNode, "tree_chunk", HASH_TREE_CHUNK_LEN);
+        }
+    }
+    else if (pBatch && hCurrent != hBase) {  // File: hash later with neighbours
+        pBatch->rghFiles[pBatch->nFiles] = hCurrent;
+        pBatch->rgJsonNodes[pBatch->nFiles] = jsonNode;
+        pBatch->nFiles++;
+        return jsonNode;
     }
     else {  // File: compute hash
         /*
-         *  Hash for file is computed with  MD5_FileHashDigest()
+         *  Hash for file is computed with  Hash_FileDigest()
          *  If failed, store NULL hash: we mark presence of file but don't snapshot its contents
          */
-        TCHAR szActualHash[MD5LEN*2 + 1] = {0};
-        res = MD5_FileHashDigest(hCurrent, szActualHash);
+        HASH_DIGEST actual;
+        res = Hash_FileDigest(pOptions->alg, pOptions->scan, hCurrent, &actual);
         if (res != ERROR_SUCCESS) {
             printf("File '%s': Could not compute hash\n", szPath);
-            if (hCurrent != hBase) CloseHandle(hCurrent);
             cJSON_AddNullToObject(jsonNode, "hash");
         }
-        else cJSON_AddStringToObject(jsonNode, "hash", szActualHash);
+        else AddDigestToNode(jsonNode, "hash", &actual, pOptions->alg, pOptions->enc);
     }
 
     if (hCurrent != hBase) CloseHandle(hCurrent);
@@ -233,7 +1012,7 @@ cJSON* SnapshotNodeFile(HANDLE hBase, LPCTSTR szName) {
 }
 
 
-cJSON* SnapshotNodeReg(HKEY hBase, LPCTSTR szName, BOOL isKey) {
+cJSON* SnapshotNodeReg(HKEY hBase, LPCTSTR szName, BOOL isKey, const OBJECT_OPTIONS* pOptions) {
     /**
      * @brief Make HashNode of sub-key or value
      *
@@ -253,16 +1032,17 @@ cJSON* SnapshotNodeReg(HKEY hBase, LPCTSTR szName, BOOL isKey) {
      * -------------------------------------------------------------------------------------- *
      *    Hash for value is computed as:
      *
-     *      MD5( dwType | rbValue )
+     *      H( dwType | rbValue )
      *
-     *    where  dwType   -  4-byte DWORD (usually little-endian),
+     *    where  H        -  object's hash algorithm,
+     *           dwType   -  4-byte DWORD (usually little-endian),
      *           rbValue  -  byte buffer for value,
      *            |       -  concat operation
      *
      * -------------------------------------------------------------------------------------- *
      *    Hash for key is computed as:
      *
-     *      MD5( MD5(valueName1)^...^MD5(valueNameN) ^ MD5[MD5(keyName1)^...^MD5(keyNameM)] )
+     *      H( H(valueName1)^...^H(valueNameN) ^ H[H(keyName1)^...^H(keyNameM)] )
      *
      *    where  valueName1...valueNameN  -  values in key
      *           keyName1...keyNameM      -  sub-keys contained in key
@@ -296,12 +1076,12 @@ cJSON* SnapshotNodeReg(HKEY hBase, LPCTSTR szName, BOOL isKey) {
         }
     }  // if szName not set -> it is root node, use hBase instead
 
-    TCHAR szActualHash[MD5LEN*2 + 1] = {0};
+    HASH_DIGEST actual;
 
     if (isKey) {
         // compute hash for key (see implementation)
-        MD5_RegKeyHashDigest(hCurrent, szActualHash);
-        cJSON_AddStringToObject(jsonNode, "hash", szActualHash);
+        Hash_RegKeyDigest(pOptions->alg, hCurrent, &actual);
+        AddDigestToNode(jsonNode, "hash", &actual, pOptions->alg, pOptions->enc);
 
         cJSON* jsonSlavesArr = cJSON_AddArrayToObject(jsonNode, "slaves");
 
@@ -310,7 +1090,7 @@ cJSON* SnapshotNodeReg(HKEY hBase, LPCTSTR szName, BOOL isKey) {
         DWORD dwIndex = 0;
         while (ERROR_SUCCESS == RegEnumKey(hCurrent, dwIndex, szSlaveName, MAX_PATH)) {
             // Recursive call. Add to slaves list of current node
-            cJSON* jsonSlave = SnapshotNodeReg(hCurrent, szSlaveName, TRUE);
+            cJSON* jsonSlave = SnapshotNodeReg(hCurrent, szSlaveName, TRUE, pOptions);
             if (jsonSlave) cJSON_AddItemToArray(jsonSlavesArr, jsonSlave);
             dwIndex++;
         }
@@ -320,7 +1100,7 @@ cJSON* SnapshotNodeReg(HKEY hBase, LPCTSTR szName, BOOL isKey) {
         dwIndex = 0;
         while (ERROR_SUCCESS == RegEnumValue(hCurrent, dwIndex, szSlaveName, &dwSize, NULL, NULL, NULL, NULL)) {
             // Recursion, again. Add to slaves list, again
-            cJSON* jsonSlave = SnapshotNodeReg(hCurrent, szSlaveName, FALSE);
+            cJSON* jsonSlave = SnapshotNodeReg(hCurrent, szSlaveName, FALSE, pOptions);
             if (jsonSlave) cJSON_AddItemToArray(jsonSlavesArr, jsonSlave);
             dwIndex++;
         }
@@ -328,9 +1108,9 @@ cJSON* SnapshotNodeReg(HKEY hBase, LPCTSTR szName, BOOL isKey) {
         if (hCurrent != hBase) RegCloseKey(hCurrent);
     }
     else {  // !isKey
-        // Value: compute MD5( dwType | rbValue)  (see implementation)
-        if (ERROR_SUCCESS == MD5_RegValueHashDigest(hCurrent, szName, szActualHash))
-            cJSON_AddStringToObject(jsonNode, "hash", szActualHash);
+        // Value: compute H( dwType | rbValue)  (see implementation)
+        if (ERROR_SUCCESS == Hash_RegValueDigest(pOptions->alg, hCurrent, szName, &actual))
+            AddDigestToNode(jsonNode, "hash", &actual, pOptions->alg, pOptions->enc);
         else {
             printf("Value '%s': failed to compute hash\n", szName);
             cJSON_AddNullToObject(jsonNode, "hash");
@@ -4,6 +4,7 @@
 #include "utils.h"
 #include "cfg.h"
 #include "snapshot.h"
+#include "dirhash.h"
 
 // default: 100 MB
 #ifndef MAX_JSON_SIZE
@@ -28,6 +29,358 @@ HKEY ParseRootHKEY(LPCTSTR szPath) {
 }
 
 
+WINBOOL GetObjectHashAlg(cJSON* jsonObject, HASH_ALG* pAlg) {
+    /**
+     * @brief Get hash algorithm of HashTree. Missing tag means MD5 (lists made before it existed)
+     *
+     * @details Returns FALSE if tag is present but malformed or names unknown algorithm
+     */
+    cJSON* jsonAlg = cJSON_GetObjectItem(jsonObject, "algorithm");
+    if (!jsonAlg) {
+        *pAlg = HASH_MD5;
+        return TRUE;
+    }
+    if (!cJSON_IsString(jsonAlg)) return FALSE;
+
+    const HASH_PROVIDER* pProvider = Hash_FindProvider(cJSON_GetStringValue(jsonAlg));
+    if (!pProvider) return FALSE;
+
+    *pAlg = pProvider->alg;
+    return TRUE;
+}
+
+
+WINBOOL GetObjectScanMode(cJSON* jsonObject, HASH_SCAN* pScan) {
+    /**
+     * @brief Get scan mode of HashTree. Missing tag means cached (registry objects, older lists)
+     *
+     * @details Returns FALSE if tag is present but malformed or names unknown mode
+     */
+    cJSON* jsonScan = cJSON_GetObjectItem(jsonObject, "scan");
+    if (!jsonScan) {
+        *pScan = HASH_DEFAULT_SCAN;
+        return TRUE;
+    }
+    if (!cJSON_IsString(jsonScan)) return FALSE;
+
+    return Hash_FindScan(cJSON_GetStringValue(jsonScan), pScan);
+}
+
+
+WINBOOL GetObjectEncoding(cJSON* jsonObject, HASH_ENCODING* pEnc) {
+    /**
+     * @brief Get digest encoding of HashTree. Missing tag means hex (older lists)
+     *
+     * @details Only needed to write hashes: stored ones are read in either encoding
+     */
+    cJSON* jsonEnc = cJSON_GetObjectItem(jsonObject, "encoding");
+    if (!jsonEnc) {
+        *pEnc = HASH_DEFAULT_ENCODING;
+        return TRUE;
+    }
+    if (!cJSON_IsString(jsonEnc)) return FALSE;
+
+    return Hash_FindEncoding(cJSON_GetStringValue(jsonEnc), pEnc);
+}
+
+
+// Object List names, by CHECK_MODE
+static LPCTSTR const rgszCheckModes[CHECK_MODE_COUNT] = {_T("full"), _T("metadata"), _T("sampled")};
+
+
+LPCTSTR CheckModeName(CHECK_MODE check) {
+    return ((unsigned) check < CHECK_MODE_COUNT) ? rgszCheckModes[check] : NULL;
+}
+
+
+WINBOOL FindCheckMode(LPCTSTR szName, CHECK_MODE* pCheck) {
+    /**
+     * @brief Look up check mode by its Object List name (case-insensitive)
+     */
+    for (int i = 0; i < CHECK_MODE_COUNT; i++) {
+        if (!_tcsicmp(rgszCheckModes[i], szName)) {
+            *pCheck = (CHECK_MODE) i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+WINBOOL GetObjectCheckMode(cJSON* jsonObject, CHECK_MODE* pCheck) {
+    /**
+     * @brief Get check mode of HashTree. Missing tag means full (registry objects, older lists)
+     *
+     * @details Returns FALSE if tag is present but malformed or names unknown mode
+     */
+    cJSON* jsonCheck = cJSON_GetObjectItem(jsonObject, "check");
+    if (!jsonCheck) {
+        *pCheck = DEFAULT_CHECK_MODE;
+        return TRUE;
+    }
+    if (!cJSON_IsString(jsonCheck)) return FALSE;
+
+    return FindCheckMode(cJSON_GetStringValue(jsonCheck), pCheck);
+}
+
+
+// Object List names, by CHUNKING_MODE
+static LPCTSTR const rgszChunkings[CHUNKING_MODE_COUNT] = {_T("fixed"), _T("cdc")};
+
+
+LPCTSTR ChunkingName(CHUNKING_MODE chunking) {
+    return ((unsigned) chunking < CHUNKING_MODE_COUNT) ? rgszChunkings[chunking] : NULL;
+}
+
+
+WINBOOL FindChunking(LPCTSTR szName, CHUNKING_MODE* pChunking) {
+    /**
+     * @brief Look up chunking mode by its Object List name (case-insensitive)
+     */
+    for (int i = 0; i < CHUNKING_MODE_COUNT; i++) {
+        if (!_tcsicmp(rgszChunkings[i], szName)) {
+            *pChunking = (CHUNKING_MODE) i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+WINBOOL GetObjectChunking(cJSON* jsonObject, CHUNKING_MODE* pChunking) {
+    /**
+     * @brief Get chunking mode of HashTree. Missing tag means fixed (registry objects, older lists)
+     *
+     * @details Returns FALSE if tag is present but malformed or names unknown mode
+     */
+    cJSON* jsonChunking = cJSON_GetObjectItem(jsonObject, "chunking");
+    if (!jsonChunking) {
+        *pChunking = DEFAULT_CHUNKING;
+        return TRUE;
+    }
+    if (!cJSON_IsString(jsonChunking)) return FALSE;
+
+    return FindChunking(cJSON_GetStringValue(jsonChunking), pChunking);
+}
+
+
+// Object List names, by ENTRIES_MODE
+static LPCTSTR const rgszEntriesModes[ENTRIES_MODE_COUNT] = {_T("allow-new"), _T("exact")};
+
+
+LPCTSTR EntriesModeName(ENTRIES_MODE entries) {
+    return ((unsigned) entries < ENTRIES_MODE_COUNT) ? rgszEntriesModes[entries] : NULL;
+}
+
+
+WINBOOL FindEntriesMode(LPCTSTR szName, ENTRIES_MODE* pEntries) {
+    /**
+     * @brief Look up entries mode by its Object List name (case-insensitive)
+     */
+    for (int i = 0; i < ENTRIES_MODE_COUNT; i++) {
+        if (!_tcsicmp(rgszEntriesModes[i], szName)) {
+            *pEntries = (ENTRIES_MODE) i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+WINBOOL GetObjectEntriesMode(cJSON* jsonObject, ENTRIES_MODE* pEntries) {
+    /**
+     * @brief Get entries mode of HashTree. Missing tag means allow-new (registry objects, older lists)
+     *
+     * @details Returns FALSE if tag is present but malformed or names unknown mode
+     */
+    cJSON* jsonEntries = cJSON_GetObjectItem(jsonObject, "entries");
+    if (!jsonEntries) {
+        *pEntries = DEFAULT_ENTRIES_MODE;
+        return TRUE;
+    }
+    if (!cJSON_IsString(jsonEntries)) return FALSE;
+
+    return FindEntriesMode(cJSON_GetStringValue(jsonEntries), pEntries);
+}
+
+
+void SetDefaultOptions(OBJECT_OPTIONS* pOptions) {
+    pOptions->alg = HASH_DEFAULT_ALG;
+    pOptions->scan = HASH_DEFAULT_SCAN;
+    pOptions->enc = HASH_DEFAULT_ENCODING;
+    pOptions->check = DEFAULT_CHECK_MODE;
+    pOptions->chunking = DEFAULT_CHUNKING;
+    pOptions->entries = DEFAULT_ENTRIES_MODE;
+}
+
+
+WINBOOL GetFileMeta(HANDLE hFile, FILE_META* pMeta) {
+    /**
+     * @brief Read size, times and identity of open file
+     */
+    HASH_NODE_INFO info;
+    if (ERROR_SUCCESS != Hash_QueryNode(hFile, &info)) return FALSE;
+    CopyFileMeta(&info, pMeta);
+    return TRUE;
+}
+
+
+WINBOOL InitHandlePath(HASH_PATH_BUF* pPath, HANDLE hFile) {
+    /**
+     * @brief Start path builder at full path of open file or folder, of any length (see Hash_PathPush)
+     *
+     * @details "<unknown>" if it cannot be resolved. FALSE if out of memory
+     */
+    DWORD cchPath = GetFinalPathNameByHandle(hFile, NULL, 0, VOLUME_NAME_DOS);
+    LPTSTR szPath = cchPath ? malloc(cchPath * sizeof(TCHAR)) : NULL;
+    WINBOOL isOk;
+
+    if (szPath && GetFinalPathNameByHandle(hFile, szPath, cchPath, VOLUME_NAME_DOS) < cchPath)
+        isOk = Hash_PathInit(pPath, szPath);
+    else isOk = Hash_PathInit(pPath, _T("<unknown>"));
+
+    free(szPath);
+    return isOk;
+}
+
+
+void CopyFileMeta(const HASH_NODE_INFO* pInfo, FILE_META* pMeta) {
+    /**
+     * @brief Size, times and identity of item already queried (see Hash_QueryNode)
+     */
+    pMeta->cbSize = pInfo->cbSize;
+    pMeta->ftWrite = pInfo->ftWrite;
+    pMeta->ftChange = pInfo->ftChange;
+    pMeta->dwVolume = pInfo->dwVolume;
+    pMeta->qwIndex = pInfo->qwIndex;
+}
+
+
+void AddFileMetaToNode(cJSON* jsonNode, const FILE_META* pMeta) {
+    /**
+     * @brief Set "size", "mtime", "ctime" and "file_id" of file node
+     *
+     * @details Times (FILETIME) and file index do not fit a JSON number exactly, so they are hex strings
+     */
+    TCHAR buf[40];
+
+    cJSON_AddNumberToObject(jsonNode, "size", (double) pMeta->cbSize);
+    snprintf(buf, sizeof(buf), "%016llx", pMeta->ftWrite);
+    cJSON_AddStringToObject(jsonNode, "mtime", buf);
+    snprintf(buf, sizeof(buf), "%016llx", pMeta->ftChange);
+    cJSON_AddStringToObject(jsonNode, "ctime", buf);
+    snprintf(buf, sizeof(buf), "%08lx:%016llx", pMeta->dwVolume, pMeta->qwIndex);
+    cJSON_AddStringToObject(jsonNode, "file_id", buf);
+}
+
+
+static WINBOOL GetNodeHex(cJSON* jsonNode, LPCTSTR szKey, ULONGLONG* pValue) {
+    cJSON* jsonValue = cJSON_GetObjectItem(jsonNode, szKey);
+    LPTSTR szEnd;
+
+    if (!jsonValue || !cJSON_IsString(jsonValue)) return FALSE;
+    *pValue = _tcstoull(cJSON_GetStringValue(jsonValue), &szEnd, 16);
+    return *szEnd == '\0';
+}
+
+
+WINBOOL GetNodeFileMeta(cJSON* jsonNode, FILE_META* pMeta) {
+    /**
+     * @brief Read metadata recorded in file node. FALSE if node has none (older lists) or it is malformed
+     */
+    unsigned long dwVolume;
+    unsigned long long qwIndex;
+    int cchRead = 0;
+
+    cJSON* jsonSize = cJSON_GetObjectItem(jsonNode, "size");
+    if (!jsonSize || !cJSON_IsNumber(jsonSize)) return FALSE;
+    pMeta->cbSize = (ULONGLONG) cJSON_GetNumberValue(jsonSize);
+
+    if (!GetNodeHex(jsonNode, "mtime", &pMeta->ftWrite)) return FALSE;
+    if (!GetNodeHex(jsonNode, "ctime", &pMeta->ftChange)) return FALSE;
+
+    cJSON* jsonId = cJSON_GetObjectItem(jsonNode, "file_id");
+    if (!jsonId || !cJSON_IsString(jsonId)) return FALSE;
+    if (2 != sscanf(cJSON_GetStringValue(jsonId), "%8lx:%16llx%n", &dwVolume, &qwIndex, &cchRead) ||
+        cJSON_GetStringValue(jsonId)[cchRead] != '\0')
+        return FALSE;
+    pMeta->dwVolume = dwVolume;
+    pMeta->qwIndex = qwIndex;
+    return TRUE;
+}
+
+
+WINBOOL IsSameFileMeta(const FILE_META* a, const FILE_META* b) {
+    return a->cbSize == b->cbSize && a->ftWrite == b->ftWrite && a->ftChange == b->ftChange &&
+           a->dwVolume == b->dwVolume && a->qwIndex == b->qwIndex;
+}
+
+
+void AddChunksToNode(cJSON* jsonNode, const HASH_CDC_CHUNK* pChunks, size_t nChunks, HASH_ALG alg, HASH_ENCODING enc) {
+    /**
+     * @brief Set "chunks" of file node: [size, fingerprint, hash] of each content-defined chunk, in file order
+     */
+    TCHAR buf[HASH_TEXT_BUF_LEN];
+    cJSON* jsonChunks = cJSON_AddArrayToObject(jsonNode, "chunks");
+    if (!jsonChunks) return;
+
+    for (size_t i = 0; i < nChunks; i++) {
+        cJSON* jsonChunk = cJSON_CreateArray();
+        if (!jsonChunk) return;
+        cJSON_AddItemToArray(jsonChunk, cJSON_CreateNumber((double) pChunks[i].cbSize));
+        snprintf(buf, sizeof(buf), "%016llx", pChunks[i].qwFingerprint);
+        cJSON_AddItemToArray(jsonChunk, cJSON_CreateString(buf));
+        Hash_Encode(&pChunks[i].digest, Hash_DigestLen(alg), enc, buf);
+        cJSON_AddItemToArray(jsonChunk, cJSON_CreateString(buf));
+        cJSON_AddItemToArray(jsonChunks, jsonChunk);
+    }
+}
+
+
+WINBOOL GetNodeChunks(cJSON* jsonNode, HASH_ALG alg, HASH_CDC_CHUNK** ppChunks, size_t* pnChunks) {
+    /**
+     * @brief Read "chunks" of file node, offsets included. FALSE if node has none or they are malformed
+     *
+     * @details Chunk list is allocated, caller frees it
+     */
+    cJSON* jsonChunks = cJSON_GetObjectItem(jsonNode, "chunks");
+    ULONGLONG cbOffset = 0;
+    LPTSTR szEnd;
+
+    if (!jsonChunks || !cJSON_IsArray(jsonChunks)) return FALSE;
+    int nChunks = cJSON_GetArraySize(jsonChunks);
+    if (!nChunks) return FALSE;
+
+    HASH_CDC_CHUNK* pChunks = calloc(nChunks, sizeof(HASH_CDC_CHUNK));
+    if (!pChunks) return FALSE;
+
+    for (int i = 0; i < nChunks; i++) {
+        cJSON* jsonChunk = cJSON_GetArrayItem(jsonChunks, i);
+        cJSON* jsonSize = cJSON_GetArrayItem(jsonChunk, 0);
+        cJSON* jsonFp = cJSON_GetArrayItem(jsonChunk, 1);
+        cJSON* jsonHash = cJSON_GetArrayItem(jsonChunk, 2);
+
+        if (!cJSON_IsArray(jsonChunk) || !cJSON_IsNumber(jsonSize) || !cJSON_IsString(jsonFp) || !cJSON_IsString(jsonHash) ||
+            !Hash_Decode(cJSON_GetStringValue(jsonHash), Hash_DigestLen(alg), &pChunks[i].digest)) {
+            free(pChunks);
+            return FALSE;
+        }
+        pChunks[i].qwFingerprint = _tcstoull(cJSON_GetStringValue(jsonFp), &szEnd, 16);
+        if (*szEnd != '\0') {
+            free(pChunks);
+            return FALSE;
+        }
+        pChunks[i].cbOffset = cbOffset;
+        pChunks[i].cbSize = (ULONGLONG) cJSON_GetNumberValue(jsonSize);
+        cbOffset += pChunks[i].cbSize;
+    }
+
+    *ppChunks = pChunks;
+    *pnChunks = nChunks;
+    return TRUE;
+}
+
+
 cJSON* ReadJSON(LPCTSTR path) {
     /**
      * @brief Open file and read JSON. Report any errors
@@ -95,7 +448,7 @@ cJSON* ReadJSON(LPCTSTR path) {
     cJSON_Delete(jsonObjectList)
 
 
-int AddObjectToOL(LPCTSTR szName, DWORD dwType, LPCTSTR szPath) {
+int AddObjectToOL(LPCTSTR szName, DWORD dwType, LPCTSTR szPath, const OBJECT_OPTIONS* pOptions) {
     /**
      * @brief Snapshot and add object to OL array
      */
@@ -108,7 +461,7 @@ int AddObjectToOL(LPCTSTR szName, DWORD dwType, LPCTSTR szPath) {
         return EXIT_FAILURE;
     }
 
-    cJSON* jsonObject = SnapshotObject(dwType, szName, szPath);
+    cJSON* jsonObject = SnapshotObject(dwType, szName, szPath, pOptions, NULL);
     if (!jsonObject) {
         CloseOL();
         return EXIT_FAILURE;
@@ -122,6 +475,150 @@ int AddObjectToOL(LPCTSTR szName, DWORD dwType, LPCTSTR szPath) {
 }
 
 
+static LPTSTR GetActualStatePath() {
+    /**
+     * @brief Allocate path of actual state file: Object List's, with ACTUAL_STATE_SUFFIX. NULL if list path is not set
+     */
+    LPTSTR szOlPath = GetOLFilePath();
+    if (!szOlPath) return NULL;
+
+    size_t cchPath = _tcslen(szOlPath) + _tcslen(ACTUAL_STATE_SUFFIX) + 1;
+    LPTSTR szPath = malloc(cchPath * sizeof(TCHAR));
+    if (szPath) snprintf(szPath, cchPath, "%s%s", szOlPath, ACTUAL_STATE_SUFFIX);
+    free(szOlPath);
+    return szPath;
+}
+
+
+static cJSON* ReadActualState(LPCTSTR szPath) {
+    /**
+     * @brief Read actual state file. Empty array if there is none yet (or it is unreadable), NULL if out of memory
+     */
+    cJSON* json = NULL;
+    HANDLE hFile = CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, NULL);
+    if (hFile != INVALID_HANDLE_VALUE) {
+        DWORD size = GetFileSize(hFile, NULL), cbRead = 0;
+        LPTSTR buf = size <= MAX_JSON_SIZE ? calloc(size + 1, sizeof(TCHAR)) : NULL;
+        if (buf && ReadFile(hFile, buf, size, &cbRead, NULL))
+            json = cJSON_ParseWithLength(buf, cbRead + 1);
+        free(buf);
+        CloseHandle(hFile);
+    }
+    if (json && !cJSON_IsArray(json)) {
+        cJSON_Delete(json);
+        json = NULL;
+    }
+    return json ? json : cJSON_CreateArray();
+}
+
+
+static BOOL WriteActualState(LPCTSTR szPath, cJSON* jsonState) {
+    /**
+     * @brief Write actual state file. Removed once nothing is left in it
+     */
+    if (!cJSON_GetArraySize(jsonState))
+        return DeleteFile(szPath) || GetLastError() == ERROR_FILE_NOT_FOUND;
+
+    LPTSTR buf = cJSON_Print(jsonState);
+    if (!buf) return FALSE;
+
+    HANDLE hFile = CreateFile(szPath, GENERIC_WRITE, FILE_SHARE_READ, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    BOOL isOk = hFile != INVALID_HANDLE_VALUE;
+    if (isOk) {
+        isOk = WriteFile(hFile, buf, _tcslen(buf), NULL, NULL);
+        CloseHandle(hFile);
+    }
+    free(buf);
+    return isOk;
+}
+
+
+static int FindStateByName(cJSON* jsonState, LPCTSTR szName) {
+    int i = 0;
+    cJSON* jsonRecord;
+    cJSON_ArrayForEach(jsonRecord, jsonState) {
+        LPCTSTR szRecordName = cJSON_GetStringValue(cJSON_GetObjectItem(jsonRecord, "object_name"));
+        if (szRecordName && !_tcscmp(szRecordName, szName)) return i;
+        i++;
+    }
+    return NOT_FOUND;
+}
+
+
+static LPTSTR CopySubPath(LPCTSTR szSubPath) {
+    /**
+     * @brief Copy of path relative to object, as actual state records it: '\' separated, no separators around.
+     *  NULL if out of memory
+     */
+    LPTSTR szSub = _tcsdup(szSubPath);
+    if (!szSub) return NULL;
+    for (LPTSTR p = szSub; *p; p++)
+        if (*p == '/') *p = '\\';
+    while (*szSub == '\\') memmove(szSub, szSub + 1, _tcslen(szSub) * sizeof(TCHAR));
+    size_t cchSub = _tcslen(szSub);
+    while (cchSub && szSub[cchSub - 1] == '\\') szSub[--cchSub] = '\0';
+    return szSub;
+}
+
+
+int CompareSubPaths(LPCTSTR szPathA, LPCTSTR szPathB) {
+    /**
+     * @brief Order of paths relative to object in a walk of its tree: folder, its items, then what follows it
+     *
+     * @details Names compare as in listings (see DiffDirectory). Separator ends a name, so it comes before
+     *  any character: items of a folder come before a sibling whose name goes on past the folder's
+     */
+    while (*szPathA && *szPathA == *szPathB) {
+        szPathA++;
+        szPathB++;
+    }
+    int a = *szPathA == '\\' ? 1 : *szPathA ? (_TUCHAR) *szPathA + 2 : 0;
+    int b = *szPathB == '\\' ? 1 : *szPathB ? (_TUCHAR) *szPathB + 2 : 0;
+    return a - b;
+}
+
+
+WINBOOL IsAtOrUnder(LPCTSTR szEntryPath, LPCTSTR szSub) {
+    /**
+     * @brief Whether path relative to object is item szSub or under it. Empty szSub: whole object
+     */
+    size_t cchSub = _tcslen(szSub);
+    if (!cchSub) return TRUE;
+    return !_tcsncmp(szEntryPath, szSub, cchSub) && (!szEntryPath[cchSub] || szEntryPath[cchSub] == '\\');
+}
+
+
+static void DropActualState(LPCTSTR szName, LPCTSTR szSubPath) {
+    /**
+     * @brief Forget what checks found in object, or at and under szSubPath of it: its baseline was
+     *  made again (or object removed), so accept must not replay them over it
+     */
+    LPTSTR szPath = GetActualStatePath();
+    cJSON* jsonState = szPath ? ReadActualState(szPath) : NULL;
+    int index = jsonState ? FindStateByName(jsonState, szName) : NOT_FOUND;
+    LPTSTR szSub = szSubPath ? CopySubPath(szSubPath) : NULL;
+
+    if (index != NOT_FOUND && (!szSubPath || szSub)) {
+        cJSON* jsonEntries = cJSON_GetObjectItem(cJSON_GetArrayItem(jsonState, index), "entries");
+        cJSON* jsonEntry = jsonEntries ? jsonEntries->child : NULL;
+        while (jsonEntry) {
+            cJSON* jsonNext = jsonEntry->next;
+            LPCTSTR szEntryPath = cJSON_GetStringValue(cJSON_GetObjectItem(jsonEntry, "path"));
+            if (!szSub || !szEntryPath || IsAtOrUnder(szEntryPath, szSub))
+                cJSON_Delete(cJSON_DetachItemViaPointer(jsonEntries, jsonEntry));
+            jsonEntry = jsonNext;
+        }
+        if (!cJSON_GetArraySize(jsonEntries)) cJSON_DeleteItemFromArray(jsonState, index);
+        if (!WriteActualState(szPath, jsonState))
+            printf("Could not save actual state to '%s'\n", szPath);
+    }
+
+    free(szSub);
+    cJSON_Delete(jsonState);
+    free(szPath);
+}
+
+
 int RemoveObjectFromOL(LPCTSTR szName) {
     /**
      * @brief Find object by name and remove it from array
@@ -139,14 +636,71 @@ int RemoveObjectFromOL(LPCTSTR szName) {
     cJSON_DeleteItemFromArray(jsonObjectList, index);
 
     SaveOL();
+    DropActualState(szName, NULL);
     CloseOL();
     return EXIT_SUCCESS;
 }
 
 
-int UpdateObjectInOL(LPCTSTR szName) {
+static BOOL ReadObjectOptions(cJSON* jsonObject, DWORD* pdwType, LPTSTR* pszPath, OBJECT_OPTIONS* pOptions) {
+    /**
+     * @brief Type, path and options of object, to snapshot it again with. Report what is missing or unknown
+     */
+    cJSON* jsonType = cJSON_GetObjectItem(jsonObject, "type");
+    if (!jsonType || !cJSON_IsNumber(jsonType)) {
+        printf("Failed: object type not specified\n");
+        return FALSE;
+    }
+    *pdwType = cJSON_GetNumberValue(jsonType);
+
+    cJSON* jsonPath = cJSON_GetObjectItem(jsonObject, "path");
+    if (!jsonPath || !cJSON_IsString(jsonPath)) {
+        printf("Failed: object has no path\n");
+        return FALSE;
+    }
+    *pszPath = cJSON_GetStringValue(jsonPath);
+
+    if (!GetObjectHashAlg(jsonObject, &pOptions->alg)) {
+        printf("Failed: unknown hash algorithm\n");
+        return FALSE;
+    }
+
+    if (!GetObjectScanMode(jsonObject, &pOptions->scan)) {
+        printf("Failed: unknown scan mode\n");
+        return FALSE;
+    }
+
+    if (!GetObjectEncoding(jsonObject, &pOptions->enc)) {
+        printf("Failed: unknown digest encoding\n");
+        return FALSE;
+    }
+
+    if (!GetObjectCheckMode(jsonObject, &pOptions->check)) {
+        printf("Failed: unknown check mode\n");
+        return FALSE;
+    }
+
+    if (!GetObjectChunking(jsonObject, &pOptions->chunking)) {
+        printf("Failed: unknown chunking mode\n");
+        return FALSE;
+    }
+
+    if (!GetObjectEntriesMode(jsonObject, &pOptions->entries)) {
+        printf("Failed: unknown entries mode\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+int UpdateObjectInOL(LPCTSTR szName, LPCTSTR szSubPath) {
     /**
-     * @brief Re-snapshot object and replace it in array
+     * @brief Re-snapshot object and replace it in array. All options (algorithm, modes, encoding) are kept
+     *
+     * @details Old HashTree is passed to snapshot: files and folders whose metadata has not changed keep
+     *  their old nodes unread, and large files chunked with CDC only rehash chunks it does not have.
+     *  If szSubPath is set, only that file or folder of object is snapshot again and spliced
+     *  into its HashTree (see SnapshotSubPath)
      */
 
     OpenOL();
@@ -160,45 +714,255 @@ int UpdateObjectInOL(LPCTSTR szName) {
 
     cJSON* jsonObject = cJSON_GetArrayItem(jsonObjectList, index);
 
-    cJSON* jsonType = cJSON_GetObjectItem(jsonObject, "type");
-    if (!jsonType || !cJSON_IsNumber(jsonType)) {
-        printf("Failed: object type not specified\n");
+    DWORD dwType;
+    LPTSTR szPath;
+    OBJECT_OPTIONS options;
+    if (!ReadObjectOptions(jsonObject, &dwType, &szPath, &options)) {
         CloseOL();
         return EXIT_FAILURE;
     }
-    DWORD dwType = cJSON_GetNumberValue(jsonType);
 
-    cJSON* jsonPath = cJSON_GetObjectItem(jsonObject, "path");
-    if (!jsonPath || !cJSON_IsString(jsonPath)) {
-        printf("Failed: object has no path\n");
+    // One item of object: HashTree changed in place
+    if (szSubPath) {
+        if (dwType != OBJECT_FILE) {
+            printf("Failed: only file objects can be updated by path\n");
+            CloseOL();
+            return EXIT_FAILURE;
+        }
+        printf("Making snapshot of '%s' in object '%s' (%s, %s)...\n", szSubPath, szName,
+               Hash_GetProvider(options.alg)->szName, Hash_KernelName(options.alg));
+        if (!SnapshotSubPath(jsonObject, szSubPath, &options, NULL)) {
+            CloseOL();
+            return EXIT_FAILURE;
+        }
+        SaveOL();
+        DropActualState(szName, szSubPath);
         CloseOL();
-        return EXIT_FAILURE;
+        return EXIT_SUCCESS;
     }
-    LPTSTR szPath = cJSON_GetStringValue(jsonPath);
 
-    cJSON* jsonUpdatedObject = SnapshotObject(dwType, szName, szPath);
+    cJSON* jsonUpdatedObject = SnapshotObject(dwType, szName, szPath, &options, cJSON_GetObjectItem(jsonObject, "root"));
     if (!jsonUpdatedObject) {
         CloseOL();
         return EXIT_FAILURE;
     }
 
+    // Folder hashes let unchanged subtrees be skipped (see dirhash.h)
+    if (dwType == OBJECT_FILE) {
+        TREE_CHANGES changes = {0};
+        CountTreeChanges(cJSON_GetObjectItem(jsonObject, "root"), cJSON_GetObjectItem(jsonUpdatedObject, "root"), &changes);
+        printf("Since last snapshot: %lu modified, %lu added, %lu removed\n", changes.nModified, changes.nAdded, changes.nRemoved);
+    }
+
     cJSON_DeleteItemFromArray(jsonObjectList, index);
     cJSON_AddItemToArray(jsonObjectList, jsonUpdatedObject);
 
     SaveOL();
+    DropActualState(szName, NULL);
     CloseOL();
     return EXIT_SUCCESS;
 }
 
 
+void StoreActualState(cJSON** rgjsonObjects, cJSON** rgjsonEntries, int nObjects, const LPCTSTR* rgszFrom, const LPCTSTR* rgszTo) {
+    /**
+     * @brief Keep actual state of verified objects next to Object List, for accept (see AcceptObjectInOL)
+     *
+     * @details File is an array of records, one per object with mismatches:
+     *      string  object_name
+     *      [cJSON] entries     -(path relative to object, state, and actual node if verification computed it)
+     *
+     *  Record of each object in rgjsonEntries is replaced by its new entries; NULL ones (tree not reached)
+     *  are left as they were. If object's bound in rgszFrom or rgszTo is set (slice of check), only items from
+     *  rgszFrom[i] and before rgszTo[i] in tree order (see CompareSubPaths), and folders holding rgszFrom[i],
+     *  were verified: old entries outside are kept, new ones outside dropped. Either array may be NULL:
+     *  no bounds. Takes entries over
+     */
+    LPTSTR szPath = GetActualStatePath();
+    cJSON* jsonState = szPath ? ReadActualState(szPath) : NULL;
+    BOOL isChanged = FALSE;
+
+    for (int i = 0; i < nObjects; i++) {
+        cJSON* jsonEntries = rgjsonEntries[i];
+        LPCTSTR szFrom = rgszFrom ? rgszFrom[i] : NULL;
+        LPCTSTR szTo = rgszTo ? rgszTo[i] : NULL;
+        LPCTSTR szName = cJSON_GetStringValue(cJSON_GetObjectItem(rgjsonObjects[i], "object_name"));
+        if (!jsonEntries) continue;
+        if (!jsonState || !szName) {
+            cJSON_Delete(jsonEntries);
+            continue;
+        }
+
+        // Items from cut on may have been verified before slice was cut: next slice verifies them again
+        cJSON* jsonEntry = jsonEntries->child;
+        while (szTo && jsonEntry) {
+            cJSON* jsonNext = jsonEntry->next;
+            LPCTSTR szEntryPath = cJSON_GetStringValue(cJSON_GetObjectItem(jsonEntry, "path"));
+            if (szEntryPath && CompareSubPaths(szEntryPath, szTo) >= 0)
+                cJSON_Delete(cJSON_DetachItemViaPointer(jsonEntries, jsonEntry));
+            jsonEntry = jsonNext;
+        }
+
+        // Other slices of check: items before the one it resumed at, and from the one it was cut at
+        int index = FindStateByName(jsonState, szName);
+        if (index != NOT_FOUND) {
+            cJSON* jsonOld = cJSON_GetObjectItem(cJSON_GetArrayItem(jsonState, index), "entries");
+            cJSON_ArrayForEach(jsonEntry, jsonOld) {
+                LPCTSTR szEntryPath = cJSON_GetStringValue(cJSON_GetObjectItem(jsonEntry, "path"));
+                if (szEntryPath && ((szFrom && CompareSubPaths(szEntryPath, szFrom) < 0 && !IsAtOrUnder(szFrom, szEntryPath)) ||
+                                    (szTo && CompareSubPaths(szEntryPath, szTo) >= 0)))
+                    cJSON_AddItemToArray(jsonEntries, cJSON_Duplicate(jsonEntry, TRUE));
+            }
+            cJSON_DeleteItemFromArray(jsonState, index);
+            isChanged = TRUE;
+        }
+
+        if (!cJSON_GetArraySize(jsonEntries)) {
+            cJSON_Delete(jsonEntries);
+            continue;
+        }
+        cJSON* jsonRecord = cJSON_CreateObject();
+        if (!jsonRecord) {
+            cJSON_Delete(jsonEntries);
+            continue;
+        }
+        cJSON_AddStringToObject(jsonRecord, "object_name", szName);
+        cJSON_AddItemToObject(jsonRecord, "entries", jsonEntries);
+        cJSON_AddItemToArray(jsonState, jsonRecord);
+        isChanged = TRUE;
+    }
+
+    if (isChanged && !WriteActualState(szPath, jsonState))
+        SvcReportEvent(EVENTLOG_WARNING_TYPE, "Could not save actual state next to Object List");
+
+    cJSON_Delete(jsonState);
+    free(szPath);
+}
+
+
+int AcceptObjectInOL(LPCTSTR szName, LPCTSTR szSubPath) {
+    /**
+     * @brief Take actual state found by last verification of object as its new snapshot: whole, or at and
+     *  under szSubPath (relative to object)
+     *
+     * @details Each recorded item is snapshot again with its actual node (see SnapshotSubPath): if it has
+     *  not changed since verification (same metadata), its digests are taken as they are, without reading it.
+     *  Items verification could not hash (size mismatch, new, retyped) or changed since are read, items
+     *  gone are removed. Accepted entries are dropped from actual state
+     */
+    DWORD dwType;
+    LPTSTR szPath;
+    OBJECT_OPTIONS options;
+    int nAccepted = 0, nFailed = 0;
+
+    OpenOL();
+
+    int index = FindIndexByNameInOL(jsonObjectList, szName);
+    if (NOT_FOUND == index) {
+        printf("Object '%s' is not in Object List\n", szName);
+        CloseOL();
+        return EXIT_FAILURE;
+    }
+    cJSON* jsonObject = cJSON_GetArrayItem(jsonObjectList, index);
+    if (!ReadObjectOptions(jsonObject, &dwType, &szPath, &options)) {
+        CloseOL();
+        return EXIT_FAILURE;
+    }
+
+    LPTSTR szStatePath = GetActualStatePath();
+    cJSON* jsonState = szStatePath ? ReadActualState(szStatePath) : NULL;
+    int iRecord = jsonState ? FindStateByName(jsonState, szName) : NOT_FOUND;
+    cJSON* jsonEntries = cJSON_GetObjectItem(cJSON_GetArrayItem(jsonState, iRecord), "entries");
+    if (NOT_FOUND == iRecord || !cJSON_GetArraySize(jsonEntries)) {
+        printf("Nothing to accept: last verification of object '%s' found no changes\n", szName);
+        cJSON_Delete(jsonState);
+        free(szStatePath);
+        CloseOL();
+        return EXIT_SUCCESS;
+    }
+
+    // Sub-path as recorded
+    LPTSTR szSub = szSubPath ? CopySubPath(szSubPath) : NULL;
+    if (szSubPath && !szSub) {
+        printf("Failed: Out of memory\n");
+        cJSON_Delete(jsonState);
+        free(szStatePath);
+        CloseOL();
+        return EXIT_FAILURE;
+    }
+
+    printf("Accepting actual state of object '%s' (%s, %s)...\n", szName,
+           Hash_GetProvider(options.alg)->szName, Hash_KernelName(options.alg));
+
+    cJSON* jsonEntry = jsonEntries->child;
+    while (jsonEntry) {
+        cJSON* jsonNext = jsonEntry->next;
+        LPCTSTR szEntryPath = cJSON_GetStringValue(cJSON_GetObjectItem(jsonEntry, "path"));
+        cJSON* jsonActual = cJSON_GetObjectItem(jsonEntry, "node");
+        BOOL isOk;
+
+        // At or under sub-path
+        if (!szEntryPath || (szSub && !IsAtOrUnder(szEntryPath, szSub))) {
+            jsonEntry = jsonNext;
+            continue;
+        }
+
+        // Object's root itself (file object): whole object, in its place in list
+        if (!*szEntryPath) {
+            cJSON* jsonRoot = cJSON_GetObjectItem(jsonObject, "root");
+            cJSON* jsonUpdated = SnapshotObject(dwType, szName, szPath, &options, jsonActual ? jsonActual : jsonRoot);
+            isOk = jsonUpdated != NULL;
+            if (isOk) {
+                cJSON_ReplaceItemInArray(jsonObjectList, index, jsonUpdated);
+                jsonObject = jsonUpdated;
+            }
+        }
+        else if (dwType != OBJECT_FILE) isOk = FALSE;
+        else {
+            printf("Path '%s' (%s):\n", szEntryPath, cJSON_GetStringValue(cJSON_GetObjectItem(jsonEntry, "state")));
+            isOk = SnapshotSubPath(jsonObject, szEntryPath, &options, jsonActual);
+        }
+
+        if (isOk) {
+            nAccepted++;
+            cJSON_Delete(cJSON_DetachItemViaPointer(jsonEntries, jsonEntry));
+        }
+        else nFailed++;
+        jsonEntry = jsonNext;
+    }
+
+    if (!cJSON_GetArraySize(jsonEntries)) cJSON_DeleteItemFromArray(jsonState, iRecord);
+    printf("Accepted %d entries, %d failed\n", nAccepted, nFailed);
+
+    if (nAccepted) {
+        SaveOL();
+        if (!WriteActualState(szStatePath, jsonState))
+            printf("Could not save actual state to '%s'\n", szStatePath);
+    }
+    else if (szSub && !nFailed) printf("Nothing to accept at '%s'\n", szSub);
+
+    free(szSub);
+    cJSON_Delete(jsonState);
+    free(szStatePath);
+    CloseOL();
+    return nFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
 int PrintObjectsInOL() {
     /**
-     * @brief Print brief info about all objects in OL (name, type, path)
+     * @brief Print brief info about all objects in OL (name, type, algorithm, scan, check, chunking and entries modes, encoding, path)
      */
 
     DWORD dwType = 0;
     LPTSTR szPath = "<unknown>";
     LPTSTR szName = "<unnamed>";
+    HASH_ALG alg;
+    HASH_SCAN scan;
+    HASH_ENCODING enc;
+    CHECK_MODE check;
+    CHUNKING_MODE chunking;
+    ENTRIES_MODE entries;
 
     OpenOL();
     int size = cJSON_GetArraySize(jsonObjectList);
@@ -219,7 +983,16 @@ int PrintObjectsInOL() {
         if (jsonPath && cJSON_IsString(jsonName))
             szName = cJSON_GetStringValue(jsonName);
 
-        printf("'%s'    \t%s     '%s'\n", szName, dwType == OBJECT_REGISTRY ? "REG " : "FILE", szPath);
+        LPCTSTR szAlg = GetObjectHashAlg(jsonObject, &alg) ? Hash_GetProvider(alg)->szName : "<unknown>";
+        LPCTSTR szScan = GetObjectScanMode(jsonObject, &scan) ? Hash_ScanName(scan) : "<unknown>";
+        LPCTSTR szEnc = GetObjectEncoding(jsonObject, &enc) ? Hash_EncodingName(enc) : "<unknown>";
+        LPCTSTR szCheck = GetObjectCheckMode(jsonObject, &check) ? CheckModeName(check) : "<unknown>";
+        LPCTSTR szChunking = GetObjectChunking(jsonObject, &chunking) ? ChunkingName(chunking) : "<unknown>";
+        LPCTSTR szEntries = GetObjectEntriesMode(jsonObject, &entries) ? EntriesModeName(entries) : "<unknown>";
+
+        printf("'%s'    \t%s  %-8s  %-7s  %-8s  %-5s  %-9s  %-6s  '%s'\n", szName, dwType == OBJECT_REGISTRY ? "REG " : "FILE", szAlg,
+               dwType == OBJECT_REGISTRY ? "" : szScan, dwType == OBJECT_REGISTRY ? "" : szCheck,
+               dwType == OBJECT_REGISTRY ? "" : szChunking, dwType == OBJECT_REGISTRY ? "" : szEntries, szEnc, szPath);
     }
 
     CloseOL();